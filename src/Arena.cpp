@@ -0,0 +1,39 @@
+//  Arena.cpp :: Monotonic block allocator
+//  Copyright 2014 Keigen Shu
+
+#include <algorithm>
+#include "Arena.hpp"
+
+void* Arena::grow(size_t size, size_t align)
+{
+    // Oversized requests get a block of their own, leaving the current
+    // block in use.
+    size_t const need = size + align;
+    if (need > mBlockSize / 4 && mHead != nullptr)
+    {
+        char* block = new char[need];
+        mBlocks.insert(mBlocks.end() - 1, block);
+
+        return reinterpret_cast<void*>(
+                (reinterpret_cast<uintptr_t>(block) + (align - 1)) & ~static_cast<uintptr_t>(align - 1)
+                );
+    }
+
+    size_t const length = std::max(mBlockSize, need);
+    char* block = new char[length];
+    mBlocks.push_back(block);
+
+    mHead = block;
+    mEnd  = block + length;
+
+    return allocate(size, align);
+}
+
+void Arena::release()
+{
+    for (char* block : mBlocks)
+        delete[] block;
+
+    mBlocks.clear();
+    mHead = mEnd = nullptr;
+}
@@ -0,0 +1,121 @@
+//  Arena.hpp :: Monotonic block allocator
+//  Copyright 2014 Keigen Shu
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Monotonic block allocator.
+ *
+ * Memory is handed out from large blocks and is only given back all at
+ * once by release(). Destructors of objects made in an arena are never
+ * called, so only objects that own nothing outside the arena may live in
+ * it. An arena must only be used by one thread at a time.
+ */
+class Arena
+{
+private:
+    std::vector< char* > mBlocks;
+    char               * mHead;      //!< Next free byte in current block
+    char               * mEnd;       //!< End of current block
+    size_t const         mBlockSize;
+
+    void* grow(size_t size, size_t align);
+
+public:
+    explicit Arena(size_t block_size = 64 << 10) :
+        mBlocks(), mHead(nullptr), mEnd(nullptr), mBlockSize(block_size)
+    {}
+
+    ~Arena() { release(); }
+
+    Arena(Arena const &) = delete;
+    Arena& operator= (Arena const &) = delete;
+
+    inline void* allocate(size_t size, size_t align = alignof(long double))
+    {
+        char* p = reinterpret_cast<char*>(
+                (reinterpret_cast<uintptr_t>(mHead) + (align - 1)) & ~static_cast<uintptr_t>(align - 1)
+                );
+
+        if (mHead == nullptr || p + size > mEnd)
+            return grow(size, align);
+
+        mHead = p + size;
+        return p;
+    }
+
+    /** Constructs an object in this arena. */
+    template< class T, class... Args >
+    inline T* make(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /** Frees every block, and with it every object made in this arena. */
+    void release();
+
+    inline size_t getBlocks() const { return mBlocks.size(); }
+};
+
+/**
+ * Standard allocator over an arena; falls back to the heap if there is
+ * no arena, so that containers of the same type can live anywhere.
+ */
+template< class T >
+class ArenaAllocator
+{
+public:
+    using value_type        = T;
+    using pointer           = T*;
+    using const_pointer     = T const *;
+    using reference         = T&;
+    using const_reference   = T const &;
+    using size_type         = size_t;
+    using difference_type   = ptrdiff_t;
+
+    template< class U > struct rebind { using other = ArenaAllocator<U>; };
+
+    Arena* arena;
+
+    ArenaAllocator(Arena* a = nullptr) noexcept : arena(a) {}
+
+    template< class U >
+    ArenaAllocator(ArenaAllocator<U> const &other) noexcept : arena(other.arena) {}
+
+    inline T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena
+                ? arena->allocate(n * sizeof(T), alignof(T))
+                : ::operator new(n * sizeof(T))
+                );
+    }
+
+    inline void deallocate(T* p, size_t) noexcept
+    {
+        if (arena == nullptr)
+            ::operator delete(p);
+    }
+
+    template< class U, class... Args >
+    inline void construct(U* p, Args&&... args) { new (p) U(std::forward<Args>(args)...); }
+
+    template< class U >
+    inline void destroy(U* p) { p->~U(); }
+
+    inline size_t max_size() const noexcept { return static_cast<size_t>(-1) / sizeof(T); }
+};
+
+template< class T, class U >
+inline bool operator== (ArenaAllocator<T> const &a, ArenaAllocator<U> const &b) { return a.arena == b.arena; }
+
+template< class T, class U >
+inline bool operator!= (ArenaAllocator<T> const &a, ArenaAllocator<U> const &b) { return a.arena != b.arena; }
+
+#endif
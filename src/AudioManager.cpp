@@ -1,15 +1,32 @@
 #include "AudioManager.hpp"
 #include <chrono>
-#include <list>
 
 #if !( defined(_WIN32) || defined(_WIN64) )
 #include <pthread.h> // POSIX Thread naming
 #endif
 
-AudioManager::AudioManager(size_t frame_count, size_t sample_rate)
+static size_t getMixThreadCount(size_t requested, size_t tracks)
+{
+    if (requested == 0) {
+        size_t const cores = std::thread::hardware_concurrency();
+        requested = (cores > 1) ? cores - 1 : 0;
+    }
+
+    // The mixing thread takes a track as well.
+    return std::min(requested, tracks - 1);
+}
+
+AudioManager::AudioManager(size_t frame_count, size_t sample_rate, size_t mix_threads)
     : awe::AEngine(sample_rate, frame_count, awe::APortAudio::HostAPIType::Default)
     , mUpdateCount(0)
+    , mEpoch(0)
     // , mRunning(ATOMIC_FLAG_INIT)
+    , mSampleMap(new SampleMap())
+    , mMapGeneration(0)
+    , mProbe(nullptr)
+    , mActiveGeneration(0)
+    , mWorkers(getMixThreadCount(mix_threads, 3), "Audio Mixer")
+    , mSnapshots(AudioSnapshot(frame_count, 3))
 {
     mTrackMap.insert({
             { 0, new Track(sample_rate, frame_count, "Autoplay") },
@@ -17,9 +34,28 @@ AudioManager::AudioManager(size_t frame_count, size_t sample_rate)
             { 2, new Track(sample_rate, frame_count, "Player 2") }
             });
 
-    mMasterTrack.attach_source(mTrackMap[0]);
-    mMasterTrack.attach_source(mTrackMap[1]);
-    mMasterTrack.attach_source(mTrackMap[2]);
+    // Route every track straight into the master track.
+    awe::Agraph::NodeID const master = mGraph.add_node(&mMasterTrack);
+    for(auto const & node : mTrackMap)
+        mGraph.connect(mGraph.add_node(node.second), master);
+
+    mGraph.set_output(master);
+    mGraph.compile();
+
+    mNodeVoices.resize(mGraph.getNodeCount());
+    for(auto & voices : mNodeVoices)
+        voices.reserve(256);
+    mDead.reserve(256);
+
+    mFeed = [this] (awe::Agraph::NodeID node) {
+        Track* track = mGraph.getNode(node);
+        for(Sample* s : mNodeVoices[node])
+            track->pull(s);
+    };
+
+    printf("[info] Mixing %lu tracks on %lu worker threads.\n",
+           static_cast<unsigned long>(mGraph.getNodeCount()),
+           static_cast<unsigned long>(mWorkers.size() + 1));
 
     mRunning.test_and_set();
 
@@ -28,12 +64,15 @@ AudioManager::AudioManager(size_t frame_count, size_t sample_rate)
 #if !( defined(_WIN32) || defined(_WIN64) )
             pthread_setname_np(pthread_self(), "Audio Engine");
 #endif
+            awe::set_flush_denormals();
             while(mRunning.test_and_set())
             {
                 if (this->update() == false)
                     std::this_thread::sleep_for(std::chrono::milliseconds(1));
                 else
                     mUpdateCount += 1;
+
+                mEpoch += 1;
             }
             mRunning.clear();
         })
@@ -50,44 +89,89 @@ AudioManager::~AudioManager()
         mThreads.erase(it);
     }
 
-    wipe_SampleMap(true);
+    // The audio thread is gone; nothing else references these.
+    drop_samples(mSampleMap.exchange(nullptr), true);
+    delete mProbe.exchange(nullptr);
 }
 
-void AudioManager::wipe_SampleMap(bool drop_data)
+void AudioManager::synchronize()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
+    ulong const epoch = mEpoch.load();
+    while(mEpoch.load() == epoch)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
 
-    // Swap maps
-    VoiceMap * pVoiceMap  = new VoiceMap ();
-    SampleMap* pSampleMap = new SampleMap();
+SampleMap* AudioManager::publish_SampleMap(SampleMap* map)
+{
+    // The generation is bumped after the swap, so an update that sees the
+    // new generation also sees the new map. Comparing map pointers instead
+    // would miss a new map allocated at the address of a freed one.
+    SampleMap* old = mSampleMap.exchange(map);
+    mMapGeneration += 1;
+    return old;
+}
 
-    pVoiceMap ->swap(mVoiceMap );
-    pSampleMap->swap(mSampleMap);
+void AudioManager::drop_samples(SampleMap* map, bool drop_data)
+{
+    if (map == nullptr)
+        return;
 
-    // Create garbage collector thread
-    std::thread gc(
-        [] (VoiceMap* vm, SampleMap* sm, bool drop)
+    if (drop_data) {
+        for(auto &node : *map)
         {
-            while (vm->empty() == false)
-                vm->erase(vm->begin());
+            node.second->drop();
+            delete node.second;
+        }
+    }
 
-            while (sm->empty() == false)
-            {
-                SampleMap::iterator it = sm->begin();
-                Sample* smp = it->second;
-                sm->erase(it);
-                if (drop) {
-                    smp->drop();
-                    delete smp;
-                }
-            }
+    delete map;
+}
 
-            delete vm;
-            delete sm;
-        },
-            pVoiceMap, pSampleMap, drop_data
-    );
-    gc.detach();
+void AudioManager::set_probe(Probe const & probe)
+{
+    Probe* old = mProbe.exchange(probe ? new Probe(probe) : nullptr);
+    if (old != nullptr) {
+        synchronize();
+        delete old;
+    }
+}
+
+void AudioManager::configure_racks(bool fused, bool profile)
+{
+    for(awe::Agraph::NodeID n = 0; n < mGraph.getNodeCount(); n += 1)
+    {
+        Track* track = mGraph.getNode(n);
+        awe::MutexLockGuard o_lock(track->getMutex());
+        track->getRack().setFused(fused);
+        track->getRack().setProfiling(profile);
+        track->getRack().reset_costs();
+    }
+}
+
+void AudioManager::print_rack_costs()
+{
+    for(awe::Agraph::NodeID n = 0; n < mGraph.getNodeCount(); n += 1)
+    {
+        Track* track = mGraph.getNode(n);
+        awe::MutexLockGuard o_lock(track->getMutex());
+
+        awe::Filter::AscRack const & rack = track->getRack();
+        if (rack.isProfiling() == false)
+            continue;
+
+        for(size_t f = 0; f < rack.getFilterCount(); f += 1)
+            printf("[info] %s: filter %lu took %.1f us per buffer over %lu buffers.\n",
+                   track->getName().c_str(), static_cast<unsigned long>(f),
+                   rack.getCost(f).average(), static_cast<unsigned long>(rack.getCost(f).blocks));
+    }
+}
+
+void AudioManager::wipe_SampleMap(bool drop_data)
+{
+    // The audio thread drops its voices once it sees the new map.
+    SampleMap* old = publish_SampleMap(new SampleMap());
+    synchronize();
+    drop_samples(old, drop_data);
 }
 
 void AudioManager::swap_SampleMap(SampleMap& new_map)
@@ -95,67 +179,133 @@ void AudioManager::swap_SampleMap(SampleMap& new_map)
     for (auto node : new_map)
         node.second->stop(); // Reset loop position to beginning
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    mSampleMap.swap(new_map);
+    SampleMap* map = new SampleMap();
+    map->swap(new_map);
+
+    SampleMap* old = publish_SampleMap(map);
+    synchronize();
+
+    // Hand the previous samples back to the caller.
+    new_map.swap(*old);
+    delete old;
 }
 
 bool AudioManager::play(ulong sample, uchar track, float vol, float pan, bool loop)
 {
-    TrackMap::iterator  T = mTrackMap .find(track );
-    if (T == mTrackMap .end()) return false;
-    SampleMap::iterator S = mSampleMap.find(sample);
-    if (S == mSampleMap.end()) return false;
+    return mCommands.push(Command { Command::Op::PLAY, track, loop, sample, vol, pan });
+}
+
+bool AudioManager::stop(ulong sample)
+{
+    return mCommands.push(Command { Command::Op::STOP, 0, false, sample, 0.0f, 0.0f });
+}
+
+void AudioManager::fexecute(SampleMap const & samples, Command const & cmd)
+{
+    SampleMap::const_iterator S = samples.find(cmd.sample);
+    if (S == samples.end()) return;
 
     Sample* s = S->second;
-    Track * t = T->second;
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    s->play(vol, pan, loop);
+    switch(cmd.op)
+    {
+        case Command::Op::PLAY:
+        {
+            TrackMap::iterator T = mTrackMap.find(cmd.track);
+            if (T == mTrackMap.end()) return;
 
-    VoiceMap::iterator  v = mVoiceMap.find(s);
-    if (v == mVoiceMap.end()) // New voice
-        mVoiceMap[s] = t;
-    else if (v->second != t) // Change destination track
-        v->second = t;
+            s->play(cmd.vol, cmd.pan, cmd.loop);
+            mVoiceMap[s] = T->second; // New voice or change destination track
+            break;
+        }
 
-    return true;
+        case Command::Op::STOP:
+            s->stop();
+            mVoiceMap.erase(s);
+            break;
+    }
 }
 
 
 bool AudioManager::update()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
+    // Acknowledge a new sample map before anything else; synchronize()
+    // counts every call, including ones that have nothing to mix.
+    ulong const generation = mMapGeneration.load();
+    if (generation != mActiveGeneration)
+    {   // Voices still point into the retired map.
+        mVoiceMap.clear();
+        mActiveGeneration = generation;
+    }
 
     if (mOutputDevice.getFIFOBuffer().size() > mMasterTrack.getOutput().getSampleCount())
         return false;
 
-    // Pull all tracks
-    std::list<Sample*> dead;
+    SampleMap const * samples = mSampleMap.load();
+
+    Command cmd;
+    while(mCommands.pop(cmd))
+        fexecute(*samples, cmd);
+
+    // Sort voices by destination node
+    for(auto & voices : mNodeVoices)
+        voices.clear();
+    mDead.clear();
 
     for(VoiceMapNode& v : mVoiceMap)
-        if (v.first->is_active())
-            v.second->pull(v.first);
-        else
-            dead.push_back(v.first);
+    {
+        if (v.first->is_active() == false) {
+            mDead.push_back(v.first);
+            continue;
+        }
+
+        for(awe::Agraph::NodeID n = 0; n < mGraph.getNodeCount(); n += 1)
+        {
+            if (mGraph.getNode(n) == v.second) {
+                mNodeVoices[n].push_back(v.first);
+                break;
+            }
+        }
+    }
 
     // Clean-up
-    for(Sample* s : dead)
-        mVoiceMap.erase(mVoiceMap.find(s));
+    for(Sample* s : mDead)
+        mVoiceMap.erase(s);
 
-    // Process stuff
-    mMasterTrack.pull();
-    mMasterTrack.flip();
+    // Mix every track, bus and the master track through the graph
+    mGraph.process(mWorkers, mFeed);
 
     // Push to output device buffer
     mOutputDevice.getFIFOBuffer_mutex().lock();
     mMasterTrack.push(mOutputDevice.getFIFOBuffer());
     mOutputDevice.getFIFOBuffer_mutex().unlock();
 
+    // Publish output snapshot
+    AudioSnapshot& snapshot = mSnapshots.back();
+    snapshot.count = mUpdateCount.load() + 1;
+
+    std::copy(mMasterTrack.getOutput().begin(), mMasterTrack.getOutput().end(), snapshot.master.begin());
+
+    for(auto const & node : mTrackMap)
+    {
+        if (node.first >= snapshot.tracks.size())
+            continue;
+
+        awe::AfBuffer const & output = node.second->getOutput();
+        std::copy(output.begin(), output.end(), snapshot.tracks[node.first].begin());
+    }
+
+    Probe const * probe = mProbe.load();
+    if (probe != nullptr)
+        (*probe)(snapshot.probe);
+
+    mSnapshots.publish();
+
     return true;
 }
 
 void AudioManager::attach_thread(std::thread* thread_ptr)
 {
-    std::lock_guard<std::mutex> lock(mMutex);
+    std::lock_guard<std::mutex> lock(mThreadMutex);
     mThreads.push_back(thread_ptr);
 }
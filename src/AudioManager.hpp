@@ -9,8 +9,12 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <functional>
 
 #include "libawe/aweEngine.h"
+#include "libawe/aweQueue.h"
+#include "libawe/aweWorkers.h"
+#include "libawe/aweGraph.h"
 #include "libawe/Sources/Sample.h"
 #include "libawe/Sources/Track.h"
 
@@ -25,58 +29,172 @@ using TrackMap      = std::map<uchar, Track*>;
 using VoiceMap      = std::map<Sample*, Track*>;
 using VoiceMapNode  = VoiceMap::value_type;
 
+/**
+ * Copy of the mixer output published after every update, for
+ * visualizers running on other threads.
+ */
+struct AudioSnapshot
+{
+    ulong                       count;  //!< Update count this snapshot was taken at
+    awe::AfBuffer               master; //!< Master track output
+    std::vector<awe::AfBuffer>  tracks; //!< Track outputs, indexed by track ID
+    std::vector<awe::Afloat>    probe;  //!< Values filled in by the probe function
+
+    AudioSnapshot(size_t frame_count, size_t track_count)
+        : count (0)
+        , master(2, frame_count)
+        , tracks(track_count, awe::AfBuffer(2, frame_count))
+        , probe ()
+    { }
+};
+
 /**
  * Class managing the sequencing of sound for the game.
  *
  * Each chart has a sample map which is loaded and then swapped onto
- * this class. When a play function is called, a sample-to-track map
- * node is created which would be used by the renderer when the
- * system buffer has been depleted.
+ * this class. When a play function is called, a command is queued
+ * which the audio thread resolves into a sample-to-track map node
+ * before mixing the next buffer.
+ *
+ * Tracks are routed into the master track through an audio graph
+ * (awe::Agraph), which can also hold buses and sends. Independent
+ * tracks are mixed in parallel on a fork-join worker pool; inputs are
+ * always summed in a fixed order, so the output does not depend on
+ * scheduling.
+ *
+ * None of the public methods wait on the mixer. Sample maps are
+ * replaced by swapping a pointer and bumping a generation counter; the
+ * old map is only freed after the audio thread has finished the update
+ * that may have been using it.
  */
 class AudioManager : public awe::AEngine
 {
+public:
+    using Probe     = std::function< void(std::vector<awe::Afloat> &) >;
+    using Snapshots = awe::AtripleBuffer< AudioSnapshot >;
+
 private:
-    std::mutex                  mMutex;         //!< Sample and thread map mutex
+    //! Voice command sent to the audio thread.
+    struct Command
+    {
+        enum class Op : uchar { PLAY, STOP };
+
+        Op      op;
+        uchar   track;
+        bool    loop;
+        ulong   sample;
+        float   vol;
+        float   pan;
+    };
+
+    std::mutex                  mThreadMutex;   //!< Thread list mutex
     std::vector< std::thread* > mThreads;       //!< Threads relying on this.
-    ulong                       mUpdateCount;   //!< Update sync counter
+    std::atomic<ulong>          mUpdateCount;   //!< Update sync counter
+    std::atomic<ulong>          mEpoch;         //!< Number of finished update calls
     std::atomic_flag            mRunning;       //!< Thread continuation flag
 
-    SampleMap       mSampleMap; //!< Maps a Chart specific sample ID to it's sample object.
-    TrackMap        mTrackMap;  //!< Maps an ID to a track.
-    VoiceMap        mVoiceMap;  //!< Maps a sample to it's render destination.
+    std::atomic<SampleMap*>     mSampleMap;     //!< Maps a Chart specific sample ID to it's sample object.
+    std::atomic<ulong>          mMapGeneration; //!< Incremented every time mSampleMap is replaced
+    std::atomic<Probe*>         mProbe;         //!< Called on the audio thread to fill snapshot probes.
+    TrackMap                    mTrackMap;      //!< Maps an ID to a track.
+
+    //!\name Audio thread state
+    //!\{
+    ulong                       mActiveGeneration; //!< Sample map generation seen by the last update
+    VoiceMap                    mVoiceMap;      //!< Maps a sample to it's render destination.
+
+    awe::Aworkers               mWorkers;       //!< Track mixing workers
+    awe::Agraph                 mGraph;         //!< Track routing
+    awe::Agraph::Feed           mFeed;          //!< Pulls the voices of one graph node
+    std::vector< std::vector<Sample*> > mNodeVoices;   //!< Active voices per graph node
+    std::vector<Sample*>        mDead;          //!< Finished voices to remove
+    awe::AqueueMPSC<Command, 1024> mCommands;   //!< Pending voice commands
+    Snapshots                   mSnapshots;     //!< Published mixer output
+    //!\}
+
+    //! Applies a voice command, on the audio thread.
+    void fexecute(SampleMap const & samples, Command const & cmd);
+
+    /**
+     * Waits until the audio thread finished the update call that was
+     * in progress, if any. Anything unpublished before this call is no
+     * longer referenced by the audio thread afterwards.
+     */
+    void synchronize();
+
+    //! Replaces the sample map. @return the previous map, still in use until synchronized.
+    SampleMap* publish_SampleMap(SampleMap* map);
+
+    static void drop_samples(SampleMap* map, bool drop_data);
 
 public:
     /**
      * Creates and initializes the game's audio system.
+     * @param mix_threads extra threads to mix tracks on; 0 picks one
+     *                    less than the number of tracks or cores.
      */
-    AudioManager(size_t frame_count = 4096, size_t sample_rate = 48000);
+    AudioManager(size_t frame_count = 4096, size_t sample_rate = 48000, size_t mix_threads = 0);
     virtual ~AudioManager();
     virtual bool update();
 
-    inline ulong getUpdateCount() const { return mUpdateCount; }
+    inline ulong getUpdateCount() const { return mUpdateCount.load(); }
 
-    inline std::mutex       & getMutex  () { return mMutex; }
     inline std::atomic_flag & getRunning() { return mRunning; }
 
-    inline SampleMap * getSampleMap() { return &mSampleMap; }
     inline TrackMap  * getTrackMap () { return &mTrackMap; }
-    inline VoiceMap  * getVoiceMap () { return &mVoiceMap; }
 
-    inline Sample* getSample(ulong index)
-    {
-        SampleMap::iterator i = mSampleMap.find(index);
-        return (i != mSampleMap.end()) ? i->second : nullptr;
-    }
     inline Track * getTrack (uchar index)
     {
         TrackMap ::iterator i = mTrackMap .find(index);
         return (i != mTrackMap .end()) ? i->second : nullptr;
     }
+
+    /**
+     * Track routing graph. The topology is set up by the constructor
+     * and the audio thread owns it afterwards; only edge gains may be
+     * changed from other threads.
+     */
+    inline awe::Agraph & getGraph() { return mGraph; }
+
+    /**
+     * Output snapshots published by the audio thread. Only one thread
+     * may read from this.
+     */
+    inline Snapshots & getSnapshots() { return mSnapshots; }
+
+    /**
+     * Sets a function called by the audio thread after every update to
+     * fill AudioSnapshot::probe, i.e. with filter statistics which are
+     * unsafe to read from other threads.
+     */
+    void set_probe(Probe const & probe);
+
+    /**
+     * Sets the execution mode of every filter rack in the graph.
+     * @param fused   run fusable filters tile by tile.
+     * @param profile measure the cost of every filter.
+     */
+    void configure_racks(bool fused, bool profile);
+
+    //! Prints the average cost of every filter in the graph, if profiled.
+    void print_rack_costs();
+
     void wipe_SampleMap(bool drop_data = true);
     void swap_SampleMap(SampleMap& new_map);
 
+    /**
+     * Queues a sample to be played on a track. Returns immediately.
+     * Unknown sample and track IDs are ignored by the audio thread.
+     * @return false if the command queue is full.
+     */
     bool play(ulong, uchar, float = 1.0f, float = 0.0f, bool = false);
 
+    /**
+     * Queues a sample to be stopped. Returns immediately.
+     * @return false if the command queue is full.
+     */
+    bool stop(ulong);
+
     void attach_thread(std::thread* thread_ptr);
 };
 
@@ -193,6 +193,12 @@ AudioTrack::~AudioTrack() {
     delete m3BEQ;
 }
 
+void AudioTrack::post(awe::AscFilter* filter, uint32_t id, double value)
+{
+    if (mTrack->post(filter, id, value) == false)
+        fprintf(stderr, "[warn] AudioTrack: parameter queue of track '%s' is full.\n", mTrack->getName().c_str());
+}
+
 ////    GUI Component Methods    //////////////////////////////////
 void AudioTrack::render(clan::Canvas &canvas, const recti &clip_rect)
 {
@@ -414,7 +420,9 @@ void AudioTrack::eq_gain_changed()
     float m = mGCsdvEQGainM.get_position(); m = m / 10.0f + 1.0f;
     float h = mGCsdvEQGainH.get_position(); h = h / 10.0f + 1.0f;
 
-    m3BEQ->set_gain(l,m,h);
+    post(m3BEQ, awe::Filter::TBEQ<2>::LO_GAIN, l);
+    post(m3BEQ, awe::Filter::TBEQ<2>::MI_GAIN, m);
+    post(m3BEQ, awe::Filter::TBEQ<2>::HI_GAIN, h);
 }
 
 void AudioTrack::eq_freq_changed()
@@ -423,7 +431,8 @@ void AudioTrack::eq_freq_changed()
     float h = mGCsdhEQFreqH.get_position(); h = 2.0f * pow(10.0f, 2.0 + h / 10.0f); // 0 ~ 20 -> 2000 ~ 20000Hz
 
     clan::Console::write_line("LPF = %1, HPF = %2, SR = %3", l, h, mTrack->getConfig().targetSampleRate);
-    m3BEQ->set_freq(l,h);
+    post(m3BEQ, awe::Filter::TBEQ<2>::LO_FREQ, l);
+    post(m3BEQ, awe::Filter::TBEQ<2>::HI_FREQ, h);
 }
 
 void AudioTrack::mixer_value_changed()
@@ -431,15 +440,13 @@ void AudioTrack::mixer_value_changed()
     float x = -mGCsdhPan.get_position(); x = x / 10.0f;
     float y = mGCsdvGain.get_position(); y = y / 20.0f / -log10(awe::Afloat_96dB);
 
-    mMixer->setPan(x);
-    mMixer->setVol(y);
+    post(mMixer, awe::Filter::AscMixer::PAN, x);
+    post(mMixer, awe::Filter::AscMixer::VOL, y);
 }
 
 void AudioTrack::mute_toggled(bool mute)
 {
-    awe::ArenderConfig config = mTrack->getConfig();
-    config.quality = mute ? awe::ArenderConfig::Quality::MUTE : awe::ArenderConfig::Quality::DEFAULT;
-    mTrack->setConfig(config);
+    post(nullptr, awe::Source::Atrack::MUTE, mute ? 1.0 : 0.0);
 }
 
 void AudioTrack::size_toggled(bool mini)
@@ -38,6 +38,9 @@ private:
     UI::SwitchButton            mGCbtnMute;
     UI::SwitchButton            mGCbtnToggleSize;
 
+    //! Queues a parameter change onto the mixing thread.
+    void post(awe::AscFilter* filter, uint32_t id, double value);
+
 public:
     AudioTrack(
         awe::Source::Atrack *source,
@@ -1,7 +1,11 @@
 //  Chart.hpp :: Chart class object declaration
 //  Copyright 2011 - 2013 Keigen Shu
 
+#include <cstring>
+#include <map>
+#include <stdexcept>
 #include "Chart.hpp"
+#include "ChartData.hpp"
 #include "Measure.hpp"
 
 long Chart::compare_ticks(const TTime &a, const TTime &b) const
@@ -82,11 +86,162 @@ double Chart::translate(const TTime &t) const
 // clears all lists and maps in the chart.
 void Chart::clear()
 {
-    while (!sequence.empty())
+    // Measures, notes and events all live in the arena.
+    sequence.clear();
+    arena.release();
+    sequence_loaded = false;
+}
+
+// deletes all samples loaded into this chart's sample map.
+void Chart::clear_samples()
+{
+    for (auto &node : sample_map)
     {
-        Measure* m = *(sequence.begin());
-        sequence.erase(sequence.begin());
-        delete m;
+        node.second->drop();
+        delete node.second;
     }
-    sequence.clear();
+
+    sample_map.clear();
+    samples_loaded = false;
+}
+
+// flattens the sequence into chart records.
+void Chart::compile(ChartData::Data &data) const
+{
+    auto const time = [] (TTime const &t) -> ChartData::Time {
+        return ChartData::Time { t.tick, t.beat, t.measure };
+    };
+
+    std::map<unsigned, uint32_t> uses;
+
+    data = ChartData::Data();
+    data.notes  = notes;
+    data.events = events;
+
+    for (uint32_t i = 0; i < sequence.size(); i++)
+    {
+        Measure const *m = sequence[i];
+        data.measures.push_back(ChartData::MeasureRecord { m->getA(), m->getB() });
+
+        for (Note const *note : m->cgetNotes())
+        {
+            ChartData::NoteRecord r;
+            std::memset(&r, 0, sizeof(r));
+
+            r.measure = i;
+            r.key     = static_cast<uint8_t>(note->getKey());
+
+            if (Note_Long const *ln = dynamic_cast<Note_Long const *>(note))
+            {
+                r.kind       = ln->hasEndPoint() ? ChartData::NoteRecord::LONG : ChartData::NoteRecord::LONG_OPEN;
+                r.begin      = time(ln->getTime().first );
+                r.end        = time(ln->getTime().second);
+                r.sample     = ln->getSampleID().first;
+                r.end_sample = ln->getSampleID().second;
+                r.vol        = ln->getVol();
+                r.pan        = ln->getPan();
+            }
+            else if (Note_Single const *sn = dynamic_cast<Note_Single const *>(note))
+            {
+                r.kind       = ChartData::NoteRecord::SINGLE;
+                r.begin      = r.end = time(sn->getTime());
+                r.sample     = r.end_sample = sn->getSampleID();
+                r.vol        = sn->getVol();
+                r.pan        = sn->getPan();
+            }
+            else
+            {
+                throw std::logic_error("Unknown note type.");
+            }
+
+            uses[r.sample] += 1;
+            if (r.end_sample != r.sample)
+                uses[r.end_sample] += 1;
+
+            data.note_records.push_back(r);
+        }
+
+        for (ParamEvent const *p : m->cgetParams())
+        {
+            ChartData::ParamRecord r;
+            std::memset(&r, 0, sizeof(r));
+
+            r.measure = i;
+            r.time    = time(p->time);
+            r.param   = static_cast<uint16_t>(p->param);
+            std::memcpy(&r.value, &p->value, sizeof(r.value));
+
+            data.param_records.push_back(r);
+
+            // Tempo segments are timed once here so loaders need not.
+            if (p->param == EParam::EP_C_TEMPO)
+            {
+                data.tempo_records.push_back(ChartData::TempoRecord {
+                        translate(p->time), r.time, 0, p->value.asFloat
+                        });
+            }
+        }
+    }
+
+    data.tempo_records.insert(data.tempo_records.begin(), ChartData::TempoRecord {
+            0.0, ChartData::Time { 0, 0, 0 }, 0, tempo
+            });
+
+    for (auto const &node : uses)
+        data.sample_records.push_back(ChartData::SampleRecord { node.first, node.second });
+}
+
+// replaces the sequence with one built from chart records.
+void Chart::load_compiled(ChartData::View const &view)
+{
+    auto const time = [] (ChartData::Time const &t) -> TTime {
+        return TTime(t.tick, t.beat, t.measure);
+    };
+
+    this->clear();
+    sequence.reserve(view.measures.size);
+
+    for (ChartData::MeasureRecord const &r : view.measures)
+        sequence.push_back(arena.make<Measure>(r.a, r.b, &arena));
+
+    for (ChartData::NoteRecord const &r : view.note_records)
+    {
+        if (r.measure >= sequence.size())
+            throw std::out_of_range("Note record refers to a missing measure.");
+
+        ENKey const key = static_cast<ENKey>(r.key);
+        Note* note;
+
+        switch (r.kind)
+        {
+            case ChartData::NoteRecord::SINGLE:
+                note = arena.make<Note_Single>(key, time(r.begin), r.sample, r.vol, r.pan);
+                break;
+            case ChartData::NoteRecord::LONG:
+                note = arena.make<Note_Long>(key, time(r.begin), time(r.end), r.sample, r.end_sample, r.vol, r.pan);
+                break;
+            case ChartData::NoteRecord::LONG_OPEN:
+                note = arena.make<Note_Long>(key, time(r.begin), r.sample, r.vol, r.pan);
+                break;
+            default:
+                throw std::out_of_range("Unknown note record kind.");
+        }
+
+        sequence[r.measure]->addNote(note);
+    }
+
+    for (ChartData::ParamRecord const &r : view.param_records)
+    {
+        if (r.measure >= sequence.size())
+            throw std::out_of_range("Parameter record refers to a missing measure.");
+
+        ParamEvent* p = arena.make<ParamEvent>(time(r.time), static_cast<EParam>(r.param), static_cast<int64_t>(0));
+        std::memcpy(&p->value, &r.value, sizeof(r.value));
+
+        sequence[r.measure]->addParamEvent(p);
+    }
+
+    notes  = view.notes;
+    events = view.events;
+    sequence_loaded = true;
 }
@@ -5,12 +5,25 @@
 #define CHART_H
 
 #include <string>
+#include <functional>
 #include "__zzCore.hpp"
 #include "Measure.hpp"
 #include "AudioManager.hpp"
 
+namespace ChartData { struct Data; struct View; }
+
 class Chart
 {
+public:
+    /**
+     * Sample loading progress callback.
+     *
+     * Called with the amount of work done and the total amount of work
+     * to be done, in format-specific units (samples, archive bytes).
+     * Returning false requests the loader to stop as soon as possible.
+     */
+    using ProgressCallback = std::function< bool(size_t, size_t) >;
+
 protected:
     std::string         name;       //! Name of this chart
     std::string         charter;    //! Name of the person who made this chart
@@ -23,11 +36,23 @@ protected:
     clan::PixelBuffer   cover;      //! The cover art pixel buffer for this chart
     Sequence            sequence;   //! The event sequence object
     SampleMap           sample_map; //! The ID to Sample map for this chart
+    Arena               arena;      //! Owns every measure, note and event in the sequence
 
     bool       cover_loaded;
     bool    sequence_loaded;
     bool     samples_loaded;
 
+    ProgressCallback    progress;   //! Sample loading progress callback
+
+    /**
+     * Reports sample loading progress to the progress callback.
+     * @return false if the load has been cancelled.
+     */
+    inline bool report_progress(size_t done, size_t total) const
+    {
+        return progress ? progress(done, total) : true;
+    }
+
 public:
     Chart() :
         cover           (),
@@ -36,34 +61,43 @@ public:
         samples_loaded  (false)
     {}
 
-    virtual ~Chart() { this->clear(); }
+    virtual ~Chart() { this->clear(); this->clear_samples(); }
+
+    /**
+     * Reads and decodes the cover art of this chart without storing it.
+     * Does not modify the chart; safe to call from any thread.
+     * @return the cover art or a null pixel buffer if there is none.
+     */
+    virtual clan::PixelBuffer read_art() const = 0;
 
-    virtual void load_art     () = 0;
     virtual void load_chart   () = 0;
     virtual void load_samples () = 0;
 
-    inline  void sort_sequence() { for (Measure* m : sequence) m->sort_lists(); }
-    inline  void load()
+    /** Gets the path to the file this chart is read from. */
+    virtual std::string  getSourcePath () const = 0;
+    /** Gets the index of this chart within its source file. */
+    virtual unsigned int getSourceIndex() const { return 0; }
+
+    /** Flattens the loaded sequence into chart records. */
+    void compile(ChartData::Data &data) const;
+    /** Replaces the sequence with one built from chart records. */
+    void load_compiled(ChartData::View const &view);
+
+    /** Reads the cover art and stores it into this chart. */
+    inline  void load_art()
     {
-        std::thread art(
-            [this]() {
-                this->load_art();
-                this->load_samples();
-            }
-        );
-
-        std::thread chart(
-            [this]() {
-                this->load_chart();
-                this->sort_sequence();
-            }
-        );
-
-        art.join();
-        chart.join();
+        clan::PixelBuffer art = read_art();
+        if (art.is_null() == false) {
+            setCoverArt(art);
+            cover_loaded = true;
+        }
     }
 
+    inline  void sort_sequence() { for (Measure* m : sequence) m->sort_lists(); }
     void clear();
+    void clear_samples();
+
+    inline void setProgressCallback(ProgressCallback const &callback) { progress = callback; }
 
     /**
      * Calculates the distance (in ticks) between two time points in
@@ -93,6 +127,10 @@ public:
     inline unsigned int getDuration () const { return duration; }
     inline double       getTempo    () const { return tempo; }
 
+    inline bool isCoverLoaded   () const { return cover_loaded;    }
+    inline bool isSequenceLoaded() const { return sequence_loaded; }
+    inline bool isSamplesLoaded () const { return samples_loaded;  }
+
 
     inline       clan::PixelBuffer &  getCoverArt () { return cover; }
     inline const clan::PixelBuffer & cgetCoverArt () { return cover; }
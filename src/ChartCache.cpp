@@ -0,0 +1,334 @@
+//  ChartCache.cpp :: Compiled chart cache
+//  Copyright 2014 Keigen Shu
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <sys/stat.h>
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <ClanLib/core.h>
+#include "ChartCache.hpp"
+#include "ChartData.hpp"
+#include "Chart.hpp"
+
+namespace ChartCache
+{
+
+static char     const MAGIC[4] = { 'L', 'W', 'C', 'C' };
+static uint32_t const VERSION  = 1;
+
+struct Section {
+    uint64_t offset;    //!< Offset from start of file; 8-byte aligned
+    uint32_t count;     //!< Number of records
+    uint32_t size;      //!< Size of one record
+};
+
+struct Header {
+    char     magic[4];
+    uint32_t version;
+
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;   //!< FNV-1a hash of the source file
+    uint32_t source_index;
+
+    uint32_t notes;
+    uint32_t events;
+    uint32_t reserved;
+
+    Section  measures;
+    Section  note_records;
+    Section  param_records;
+    Section  tempo_records;
+    Section  sample_records;
+};
+
+static std::mutex  gMutex;
+static std::string gDirectory;
+
+/** Read-only file mapping; falls back to reading the file into memory. */
+class MappedFile
+{
+private:
+    char const        * mData;
+    size_t              mSize;
+    std::vector<char>   mBuffer;
+    bool                mMapped;
+
+public:
+    MappedFile() : mData(nullptr), mSize(0), mBuffer(), mMapped(false) {}
+    ~MappedFile()
+    {
+#if !( defined(_WIN32) || defined(_WIN64) )
+        if (mMapped)
+            munmap(const_cast<char*>(mData), mSize);
+#endif
+    }
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile& operator= (MappedFile const &) = delete;
+
+    bool open(std::string const &path)
+    {
+#if !( defined(_WIN32) || defined(_WIN64) )
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                mData   = static_cast<char const *>(data);
+                mSize   = st.st_size;
+                mMapped = true;
+            }
+        }
+
+        ::close(fd);
+
+        if (mMapped)
+            return true;
+#endif
+        try {
+            clan::DataBuffer buffer = clan::File::read_bytes(path);
+            mBuffer.assign(buffer.get_data(), buffer.get_data() + buffer.get_size());
+        } catch (clan::Exception &e) {
+            return false;
+        }
+
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+        return true;
+    }
+
+    inline char const * data() const { return mData; }
+    inline size_t       size() const { return mSize; }
+};
+
+static uint64_t fnv1a(void const *data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL)
+{
+    uint8_t const *p = static_cast<uint8_t const *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static bool stat_source(std::string const &path, uint64_t &size, int64_t &mtime)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    size  = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+static bool hash_source(std::string const &path, uint64_t &hash)
+{
+    MappedFile file;
+    if (file.open(path) == false)
+        return false;
+
+    hash = fnv1a(file.data(), file.size());
+    return true;
+}
+
+static std::string get_directory()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gDirectory;
+}
+
+static std::string cache_path(std::string const &directory, Chart const &chart)
+{
+    std::string const key = chart.getSourcePath() + "#" + std::to_string(chart.getSourceIndex());
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.lwc", static_cast<unsigned long long>(fnv1a(key.data(), key.size())));
+
+    return directory + "/" + name;
+}
+
+template< typename Record >
+static bool get_span(MappedFile const &file, Section const &section, ChartData::Span<Record> &span)
+{
+    if (section.size != sizeof(Record) || section.offset % 8 != 0)
+        return false;
+
+    if (section.offset > file.size() || (file.size() - section.offset) / sizeof(Record) < section.count)
+        return false;
+
+    span.data = reinterpret_cast<Record const *>(file.data() + section.offset);
+    span.size = section.count;
+    return true;
+}
+
+void setDirectory(std::string const &path)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDirectory = path;
+}
+
+bool load(Chart &chart)
+{
+    std::string const directory = get_directory();
+    if (directory.empty())
+        return false;
+
+    std::string const source = chart.getSourcePath();
+
+    uint64_t size, hash;
+    int64_t  mtime;
+    if (stat_source(source, size, mtime) == false)
+        return false;
+
+    MappedFile file;
+    if (file.open(cache_path(directory, chart)) == false)
+        return false;
+
+    if (file.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.version      != VERSION
+            || header.source_size  != size
+            || header.source_mtime != mtime
+            || header.source_index != chart.getSourceIndex())
+        return false;
+
+    ChartData::View view;
+    view.notes  = header.notes;
+    view.events = header.events;
+
+    if (get_span(file, header.measures      , view.measures      ) == false
+     || get_span(file, header.note_records  , view.note_records  ) == false
+     || get_span(file, header.param_records , view.param_records ) == false
+     || get_span(file, header.tempo_records , view.tempo_records ) == false
+     || get_span(file, header.sample_records, view.sample_records) == false)
+    {
+        fprintf(stderr, "[warn] Ignoring malformed chart cache for %s.\n", source.c_str());
+        return false;
+    }
+
+    // Size and time stamp match; make sure the content does too.
+    if (hash_source(source, hash) == false || header.source_hash != hash)
+        return false;
+
+    try {
+        chart.load_compiled(view);
+    } catch (std::exception &e) {
+        fprintf(stderr, "[warn] Failed to load chart cache for %s: %s\n", source.c_str(), e.what());
+        chart.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void store(Chart const &chart)
+{
+    std::string const directory = get_directory();
+    if (directory.empty() || chart.isSequenceLoaded() == false)
+        return;
+
+    std::string const source = chart.getSourcePath();
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+    header.version      = VERSION;
+    header.source_index = chart.getSourceIndex();
+
+    if (stat_source(source, header.source_size, header.source_mtime) == false
+     || hash_source(source, header.source_hash) == false)
+        return;
+
+    ChartData::Data data;
+    chart.compile(data);
+
+    header.notes  = data.notes;
+    header.events = data.events;
+
+    // Lay out sections one after another, 8-byte aligned.
+    uint64_t offset = sizeof(Header);
+    auto const place = [&offset] (Section &section, uint32_t count, uint32_t size) {
+        offset = (offset + 7) & ~static_cast<uint64_t>(7);
+        section = Section { offset, count, size };
+        offset += static_cast<uint64_t>(count) * size;
+    };
+
+    place(header.measures      , data.measures      .size(), sizeof(ChartData::MeasureRecord));
+    place(header.note_records  , data.note_records  .size(), sizeof(ChartData::NoteRecord   ));
+    place(header.param_records , data.param_records .size(), sizeof(ChartData::ParamRecord  ));
+    place(header.tempo_records , data.tempo_records .size(), sizeof(ChartData::TempoRecord  ));
+    place(header.sample_records, data.sample_records.size(), sizeof(ChartData::SampleRecord ));
+
+    std::vector<char> image(offset, 0);
+    auto const write = [&image] (Section const &section, void const *records) {
+        if (section.count > 0)
+            std::memcpy(image.data() + section.offset, records, static_cast<size_t>(section.count) * section.size);
+    };
+
+    std::memcpy(image.data(), &header, sizeof(Header));
+    write(header.measures      , data.measures      .data());
+    write(header.note_records  , data.note_records  .data());
+    write(header.param_records , data.param_records .data());
+    write(header.tempo_records , data.tempo_records .data());
+    write(header.sample_records, data.sample_records.data());
+
+    struct stat st;
+    if (stat(directory.c_str(), &st) != 0)
+    {
+        try {
+            clan::Directory::create(directory, true);
+        } catch (clan::Exception &e) {
+            fprintf(stderr, "[warn] Failed to create chart cache directory %s.\n", directory.c_str());
+            return;
+        }
+    }
+
+    // Write to a temporary file first so that readers never see a partial file.
+    std::string const path = cache_path(directory, chart);
+    std::string const temp = path + ".tmp";
+
+    FILE* fp = fopen(temp.c_str(), "wb");
+    if (fp == nullptr) {
+        fprintf(stderr, "[warn] Failed to write chart cache %s.\n", temp.c_str());
+        return;
+    }
+
+    bool const written = fwrite(image.data(), 1, image.size(), fp) == image.size();
+    fclose(fp);
+
+    std::remove(path.c_str());
+    if (written == false || std::rename(temp.c_str(), path.c_str()) != 0)
+    {
+        fprintf(stderr, "[warn] Failed to write chart cache %s.\n", path.c_str());
+        std::remove(temp.c_str());
+    }
+}
+
+bool hash(Chart const &chart, uint64_t &hash)
+{
+    return hash_source(chart.getSourcePath(), hash);
+}
+
+}
@@ -0,0 +1,52 @@
+//  ChartCache.hpp :: Compiled chart cache
+//  Copyright 2014 Keigen Shu
+
+#ifndef CHART_CACHE_H
+#define CHART_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+class Chart;
+
+/**
+ * Compiled chart cache.
+ *
+ * After a chart is parsed for the first time, its sequence is flattened
+ * into chart records (see ChartData) and written to the cache directory
+ * as a versioned binary file:
+ *
+ *      Header      magic, version, source file size, mtime and hash,
+ *                  record counts and section offsets
+ *      Measures    time signature table
+ *      Notes       flat note records
+ *      Params      flat parameter event records
+ *      Tempo       tempo segment table, with segment start times
+ *      Samples     referenced sample table
+ *
+ * Later loads map the file into memory and rebuild the sequence directly
+ * from the records, provided the source file still has the same size,
+ * modification time and content hash.
+ */
+namespace ChartCache
+{
+    /** Sets the cache directory. An empty path disables the cache. */
+    void setDirectory(std::string const &path);
+
+    /**
+     * Loads the sequence of a chart from its compiled cache.
+     * @return false if there is no valid cache for this chart.
+     */
+    bool load (Chart &chart);
+
+    /** Writes the loaded sequence of a chart to the cache. */
+    void store(Chart const &chart);
+
+    /**
+     * Hashes the source file of a chart, as checked by the cache.
+     * @return false if the source file could not be read.
+     */
+    bool hash (Chart const &chart, uint64_t &hash);
+}
+
+#endif
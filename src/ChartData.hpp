@@ -0,0 +1,111 @@
+//  ChartData.hpp :: Flat chart data records
+//  Copyright 2014 Keigen Shu
+
+#ifndef CHART_DATA_H
+#define CHART_DATA_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Normalized chart format.
+ *
+ * A chart is flattened into plain arrays of fixed-size records, in the
+ * order the chart stores them after sorting. Every format parser produces
+ * the same records, which makes them suitable for caching and for tools.
+ */
+namespace ChartData {
+
+struct Time {
+    uint32_t tick, beat, measure;
+};
+
+struct MeasureRecord {
+    uint32_t a;         //!< Beats per measure
+    uint32_t b;         //!< Ticks per beat
+};
+
+struct NoteRecord {
+    enum Kind : uint8_t { SINGLE = 0, LONG = 1, LONG_OPEN = 2 };
+
+    uint32_t measure;   //!< Index of measure holding this note
+    Time     begin;
+    Time     end;       //!< Same as begin for single notes
+    uint32_t sample;
+    uint32_t end_sample;
+    float    vol;
+    float    pan;
+    uint8_t  key;       //!< ENKey
+    Kind     kind;
+    uint8_t  reserved[2];
+};
+
+struct ParamRecord {
+    uint32_t measure;   //!< Index of measure holding this event
+    Time     time;
+    uint16_t param;     //!< EParam
+    uint16_t reserved;
+    uint64_t value;     //!< Bit pattern of the value union
+};
+
+/** Tempo segment; starts at the given time and lasts until the next one. */
+struct TempoRecord {
+    double   start;     //!< Start of segment in seconds
+    Time     time;
+    uint32_t reserved;
+    double   tempo;     //!< Tempo in BPM
+};
+
+struct SampleRecord {
+    uint32_t id;        //!< Sample ID
+    uint32_t uses;      //!< Number of notes referencing this sample
+};
+
+/** Non-owning view into chart records, e.g. in a mapped cache file. */
+template< typename Record >
+struct Span {
+    Record const *data;
+    uint32_t      size;
+
+    inline Record const * begin() const { return data; }
+    inline Record const * end  () const { return data + size; }
+};
+
+struct View {
+    uint32_t notes;     //!< Number of playable notes
+    uint32_t events;    //!< Number of event objects
+
+    Span< MeasureRecord > measures;
+    Span< NoteRecord    > note_records;
+    Span< ParamRecord   > param_records;
+    Span< TempoRecord   > tempo_records;
+    Span< SampleRecord  > sample_records;
+};
+
+/** Owning chart records. */
+struct Data {
+    uint32_t notes  = 0;
+    uint32_t events = 0;
+
+    std::vector< MeasureRecord > measures;
+    std::vector< NoteRecord    > note_records;
+    std::vector< ParamRecord   > param_records;
+    std::vector< TempoRecord   > tempo_records;
+    std::vector< SampleRecord  > sample_records;
+
+    inline View view() const
+    {
+        return View {
+            notes, events,
+            { measures      .data(), static_cast<uint32_t>(measures      .size()) },
+            { note_records  .data(), static_cast<uint32_t>(note_records  .size()) },
+            { param_records .data(), static_cast<uint32_t>(param_records .size()) },
+            { tempo_records .data(), static_cast<uint32_t>(tempo_records .size()) },
+            { sample_records.data(), static_cast<uint32_t>(sample_records.size()) }
+        };
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "ChartLoader.hpp"
+#include "Chart.hpp"
+#include "ChartCache.hpp"
+
+#include <exception>
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming and scheduling
+#else
+#include <windows.h> // Thread priority
+#endif
+
+ChartLoader::ChartLoader(Chart* chart, bool background, ChartLoader* after)
+    : mChart        (chart)
+    , mAfter        (after)
+    , mThread       ()
+    , mState        (static_cast<int>(State::IDLE))
+    , mCancel       (false)
+    , mCoverReady   (false)
+    , mChartReady   (false)
+    , mDone         (0)
+    , mTotal        (0)
+    , mError        ()
+    , mBackground   (background)
+{}
+
+ChartLoader::~ChartLoader()
+{
+    cancel();
+    wait();
+    delete mAfter;
+}
+
+void ChartLoader::start()
+{
+    if (mChart == nullptr || getState() != State::IDLE)
+        return;
+
+    mState.store(static_cast<int>(State::LOADING_CHART));
+    mThread = std::thread(&ChartLoader::run, this);
+}
+
+void ChartLoader::cancel()
+{
+    mCancel.store(true);
+}
+
+void ChartLoader::wait()
+{
+    if (mThread.joinable())
+        mThread.join();
+}
+
+float ChartLoader::getProgress() const
+{
+    if (getState() == State::DONE)
+        return 1.0f;
+
+    size_t const total = mTotal.load();
+    return total == 0 ? 0.0f : static_cast<float>(mDone.load()) / static_cast<float>(total);
+}
+
+void ChartLoader::run()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+    pthread_setname_np(pthread_self(), mBackground ? "Chart Preloader" : "Chart Loader");
+#endif
+
+    if (mBackground)
+    {
+#if defined(__linux__)
+        sched_param param { 0 };
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#elif defined(_WIN32) || defined(_WIN64)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+    }
+
+    // Let the earlier load wind down first.
+    if (mAfter != nullptr)
+    {
+        mAfter->cancel();
+        delete mAfter;
+        mAfter = nullptr;
+    }
+
+    try {
+        // Stage 1 :: cover art and note chart
+        if (mChart->isCoverLoaded() == false)
+            mChart->load_art();
+        mCoverReady.store(true);
+
+        if (mCancel.load()) {
+            mState.store(static_cast<int>(State::CANCELLED));
+            return;
+        }
+
+        if (mChart->isSequenceLoaded() == false && ChartCache::load(*mChart) == false)
+        {
+            mChart->load_chart();
+            mChart->sort_sequence();
+            ChartCache::store(*mChart);
+        }
+        mChartReady.store(true);
+
+        // Stage 2 :: keysound samples
+        mState.store(static_cast<int>(State::LOADING_SAMPLES));
+
+        if (mChart->isSamplesLoaded() == false)
+        {
+            mChart->setProgressCallback(
+                [this] (size_t done, size_t total) -> bool {
+                    mDone .store(done );
+                    mTotal.store(total);
+                    return mCancel.load() == false;
+                });
+
+            mChart->load_samples();
+            mChart->setProgressCallback(nullptr);
+
+            if (mCancel.load() || mChart->isSamplesLoaded() == false) {
+                mChart->clear_samples();
+                mState.store(static_cast<int>(State::CANCELLED));
+                return;
+            }
+        }
+
+        mState.store(static_cast<int>(State::DONE));
+
+    } catch (std::exception &e) {
+        mChart->setProgressCallback(nullptr);
+        mChart->clear_samples();
+
+        mError = e.what();
+        fprintf(stderr, "[error] Failed to load chart: %s\n", e.what());
+        mState.store(static_cast<int>(State::FAILED));
+    }
+}
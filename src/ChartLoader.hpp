@@ -0,0 +1,95 @@
+//  ChartLoader.hpp :: Asynchronous chart loading pipeline
+//  Copyright 2014 Keigen Shu
+
+#ifndef CHART_LOADER_H
+#define CHART_LOADER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+class Chart;
+
+/**
+ * Loads a chart on a background thread.
+ *
+ * The load is done in stages so that the interface can show something as
+ * soon as possible:
+ *
+ *  1. the cover art, followed by the note chart (structure),
+ *  2. the keysound samples, which are streamed in while reporting their
+ *     progress through getProgress().
+ *
+ * The load can be cancelled at any time with cancel(); the samples that
+ * have been loaded up to that point are discarded, while a chart that has
+ * already been loaded is kept.
+ *
+ * Background loaders (used for speculative preloading) run at idle
+ * priority. The loader never touches the audio engine; swapping the
+ * sample map in is left to the caller once the load is DONE.
+ *
+ * A loader may take over an earlier, cancelled or failed, load of the
+ * same chart. It then waits for that load's thread on its own thread
+ * before starting, so that nobody has to block on it.
+ */
+class ChartLoader
+{
+public:
+    enum class State : int {
+        IDLE            = 0,    //!< Not started yet.
+        LOADING_CHART   = 1,    //!< Loading cover art and note chart.
+        LOADING_SAMPLES = 2,    //!< Loading keysound samples.
+        DONE            = 3,    //!< Everything has been loaded.
+        CANCELLED       = 4,    //!< Load was cancelled.
+        FAILED          = 5     //!< Load failed; see getError().
+    };
+
+private:
+    Chart             * mChart;
+    ChartLoader       * mAfter;         //!< Earlier load to wait for and delete
+    std::thread         mThread;
+
+    std::atomic<int>    mState;         //!< Current loader state
+    std::atomic<bool>   mCancel;        //!< Cancellation request flag
+    std::atomic<bool>   mCoverReady;    //!< Cover art loading attempted
+    std::atomic<bool>   mChartReady;    //!< Note chart loaded and sorted
+
+    std::atomic<size_t> mDone;          //!< Sample loading work done
+    std::atomic<size_t> mTotal;         //!< Sample loading work total
+
+    std::string         mError;         //!< Failure message; valid when FAILED
+    bool const          mBackground;    //!< Low priority preload without art
+
+    void run();
+
+public:
+    /**
+     * @param after earlier load of the same chart, or nullptr. The new
+     *              loader owns it and picks up whatever it has loaded.
+     */
+    ChartLoader(Chart* chart, bool background = false, ChartLoader* after = nullptr);
+    ~ChartLoader(); //!< Cancels and waits for any running load.
+
+    ChartLoader(ChartLoader const &) = delete;
+    ChartLoader& operator= (ChartLoader const &) = delete;
+
+    void start ();  //!< Starts loading the chart in the background.
+    void cancel();  //!< Requests the load to stop; does not block.
+    void wait  ();  //!< Blocks until the worker thread has finished.
+
+    inline Chart      * getChart() const { return mChart; }
+    inline bool    isBackground() const { return mBackground; }
+    inline State        getState() const { return static_cast<State>(mState.load()); }
+    inline std::string const & getError() const { return mError; }
+
+    inline bool isCancelled () const { return mCancel.load(); }
+    inline bool isCoverReady() const { return mCoverReady.load(); }
+    inline bool isChartReady() const { return mChartReady.load(); }
+    inline bool isDone      () const { return getState() == State::DONE; }
+    inline bool isFinished  () const { return getState() >= State::DONE; }
+
+    /** @return sample loading progress within 0.0 .. 1.0 */
+    float getProgress() const;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "ChartPreloader.hpp"
+#include "ChartLoader.hpp"
+#include "Chart.hpp"
+
+ChartPreloader::ChartPreloader(size_t capacity, unsigned dwell_ms)
+    : mCache    ()
+    , mEvicted  ()
+    , mCapacity (capacity)
+    , mDwell    (std::chrono::milliseconds(dwell_ms))
+    , mFocus    (nullptr)
+    , mSince    (Clock::now())
+    , mRequested(false)
+{}
+
+ChartPreloader::~ChartPreloader()
+{
+    for (ChartLoader* loader : mCache)
+        evict(loader);
+
+    mCache.clear();
+
+    for (ChartLoader* loader : mEvicted)
+    {
+        loader->wait();
+        delete loader;
+    }
+}
+
+std::list< ChartLoader* >::iterator ChartPreloader::find(Chart* chart)
+{
+    auto it = mCache.begin();
+    while (it != mCache.end() && (*it)->getChart() != chart)
+        it++;
+    return it;
+}
+
+// Cancels a load and frees what it has loaded once its thread is done.
+void ChartPreloader::evict(ChartLoader* loader)
+{
+    loader->cancel();
+    mEvicted.push_back(loader);
+}
+
+// Deletes evicted loaders that are no longer running.
+void ChartPreloader::collect()
+{
+    auto it = mEvicted.begin();
+    while (it != mEvicted.end())
+    {
+        ChartLoader* loader = *it;
+        if (loader->isFinished())
+        {
+            loader->wait(); // Only joins; the thread is done.
+            loader->getChart()->clear_samples();
+            loader->getChart()->clear();
+            delete loader;
+            it = mEvicted.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+// Takes an evicted load of the given chart off the list, so that it can be
+// handed over to a new load of the chart instead of freeing the chart.
+ChartLoader* ChartPreloader::retire(Chart* chart)
+{
+    for (auto it = mEvicted.begin(); it != mEvicted.end(); it++)
+    {
+        if ((*it)->getChart() == chart)
+        {
+            ChartLoader* loader = *it;
+            mEvicted.erase(it);
+            return loader;
+        }
+    }
+
+    return nullptr;
+}
+
+void ChartPreloader::focus(Chart* chart)
+{
+    collect();
+
+    if (chart != mFocus)
+    {
+        demote();
+        mFocus      = chart;
+        mSince      = Clock::now();
+        mRequested  = false;
+    }
+    else if (mRequested == false && chart != nullptr && Clock::now() - mSince >= mDwell)
+    {
+        request(chart);
+        mRequested = true;
+    }
+}
+
+void ChartPreloader::request(Chart* chart)
+{
+    if (chart == nullptr || mCapacity == 0)
+        return;
+
+    ChartLoader* after = nullptr;
+
+    auto it = find(chart);
+    if (it != mCache.end())
+    {
+        after = *it;
+        mCache.erase(it);
+
+        if (after->isCancelled() == false &&
+            after->getState() != ChartLoader::State::FAILED)
+        {
+            mCache.push_front(after);
+            return;
+        }
+    } else {
+        after = retire(chart);
+    }
+
+    demote();
+
+    // Demoted, failed or evicted loads are restarted; the new loader picks
+    // up from whatever the chart has already loaded.
+    ChartLoader* loader = new ChartLoader(chart, true, after);
+    mCache.push_front(loader);
+    loader->start();
+
+    while (mCache.size() > mCapacity)
+    {
+        evict(mCache.back());
+        mCache.pop_back();
+    }
+}
+
+void ChartPreloader::demote()
+{
+    for (ChartLoader* loader : mCache)
+        if (loader->isFinished() == false)
+            loader->cancel();
+}
+
+ChartLoader* ChartPreloader::take(Chart* chart)
+{
+    auto it = find(chart);
+    if (it == mCache.end())
+        return retire(chart);
+
+    ChartLoader* loader = *it;
+    mCache.erase(it);
+
+    if (mFocus == chart)
+        mRequested = false;
+
+    return loader;
+}
+
+void ChartPreloader::discard(ChartLoader* loader)
+{
+    if (loader == nullptr)
+        return;
+
+    evict(loader);
+    collect();
+}
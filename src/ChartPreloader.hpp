@@ -0,0 +1,94 @@
+//  ChartPreloader.hpp :: Speculative background chart loading
+//  Copyright 2014 Keigen Shu
+
+#ifndef CHART_PRELOADER_H
+#define CHART_PRELOADER_H
+
+#include <list>
+#include <chrono>
+
+class Chart;
+class ChartLoader;
+
+/**
+ * Bounded cache of background chart loads.
+ *
+ * The music selector requests a chart once the player's selection has
+ * rested on it for a while; its note chart and keysounds are then loaded
+ * by a low-priority ChartLoader. Only one chart is loaded at a time. When
+ * the player moves on, the unfinished load is demoted: its samples are
+ * dropped but the note chart is kept in the cache, so a later request only
+ * needs to load the samples again.
+ *
+ * The cache holds at most `capacity` charts. The least recently requested
+ * chart is evicted first, freeing both its samples and note chart.
+ *
+ * Nothing here waits on a loader thread. Evicted loads are deleted once
+ * they have finished, and a load that is restarted is handed over to its
+ * replacement, which waits for it on its own thread.
+ *
+ * This class is not thread-safe; it is meant to be driven by the UI thread.
+ */
+class ChartPreloader
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::list< ChartLoader* >   mCache;     //!< Cached loads, most recent first
+    std::list< ChartLoader* >   mEvicted;   //!< Evicted loads still winding down
+
+    size_t const                mCapacity;  //!< Maximum number of cached charts
+    Clock::duration const       mDwell;     //!< Selection rest time before preloading
+
+    Chart                     * mFocus;     //!< Chart being looked at
+    Clock::time_point           mSince;     //!< Time the focus last changed
+    bool                        mRequested; //!< Has the focus been requested yet?
+
+    std::list< ChartLoader* >::iterator find(Chart* chart);
+
+    void evict  (ChartLoader* loader);
+    void collect();
+    ChartLoader* retire(Chart* chart);
+
+public:
+    ChartPreloader(size_t capacity = 2, unsigned dwell_ms = 500);
+    ~ChartPreloader();
+
+    ChartPreloader(ChartPreloader const &) = delete;
+    ChartPreloader& operator= (ChartPreloader const &) = delete;
+
+    /**
+     * Tells the preloader which chart the player is currently looking at.
+     * Should be called every frame; the chart is requested once the focus
+     * has rested on it for the dwell time. Changing the focus demotes any
+     * unfinished load.
+     */
+    void focus(Chart* chart);
+
+    /**
+     * Starts loading a chart right away, demoting any other unfinished
+     * load.
+     */
+    void request(Chart* chart);
+
+    /** Demotes the running load, if it is not done yet. */
+    void demote();
+
+    /**
+     * Removes a chart's load from the cache and hands it over to the
+     * caller, who is then responsible for deleting it. The returned load
+     * may have been cancelled or still be winding down, in which case the
+     * caller should pass it on to a new loader.
+     * @return the chart's loader or nullptr if it is not in the cache.
+     */
+    ChartLoader* take(Chart* chart);
+
+    /**
+     * Takes back a load handed out by take() that is no longer wanted.
+     * It is cancelled and freed once its thread has wound down.
+     */
+    void discard(ChartLoader* loader);
+};
+
+#endif
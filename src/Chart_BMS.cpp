@@ -4,7 +4,6 @@
 #include "Chart_BMS.hpp"
 
 #include <ClanLib/core.h>
-#include "Music.hpp"
 
 
 uint string_to_raw_uint(const std::string &str)
@@ -88,9 +87,9 @@ void Chart_BMS::init_sequence()
     {
         auto it = measure_ts_z.find(m);
         if (it == measure_ts_z.end()) {
-            sequence.push_back(new Measure(4, 48));
+            sequence.push_back(arena.make<Measure>(4, 48, &arena));
         } else {
-            sequence.push_back(new Measure(it->second));
+            sequence.push_back(arena.make<Measure>(it->second, &arena));
         }
     }
 }
@@ -223,16 +222,30 @@ Chart_BMS::Chart_BMS(const std::string &path) :
 
 
 
-void Chart_BMS::load_art()
+static clan::PixelBuffer load_stage_file(const std::string &file)
+{
+    clan::PixelBuffer cover = clan::ImageProviderFactory::load(file);
+    if (cover.is_null())
+        return cover;
+
+    return cover.to_format(clan::tf_rgb8);
+}
+
+clan::PixelBuffer Chart_BMS::read_art() const
 {
     if (stage_file.empty())
-        return;
+        return clan::PixelBuffer();
 
-    clan::PixelBuffer cover = clan::ImageProviderFactory::load(bms_fullpath + stage_file);
-    if (cover.is_null())
-        return;
+    return load_stage_file(bms_fullpath + stage_file);
+}
 
-    setCoverArt(cover.to_format(clan::tf_rgb8));
+clan::PixelBuffer Chart_BMS::read_art(const std::string &path)
+{
+    Header header;
+    if (read_header(path, header) == false || header.stage.empty())
+        return clan::PixelBuffer();
+
+    return load_stage_file(clan::PathHelp::get_fullpath(path) + header.stage);
 }
 
 void Chart_BMS::load_chart()
@@ -282,7 +295,7 @@ void Chart_BMS::load_chart()
                 if (bpm != 0)
                 {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    ParamEvent* p = new ParamEvent(time, EParam::EP_C_TEMPO, double(bpm));
+                    ParamEvent* p = arena.make<ParamEvent>(time, EParam::EP_C_TEMPO, double(bpm));
                     m->addParamEvent(p);
                     printf(
                             "BMS [info] Added BPM_D event at %u:%u:%u [%lf]\n",
@@ -311,7 +324,7 @@ void Chart_BMS::load_chart()
                     continue;
                 } else {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    ParamEvent *p = new ParamEvent(time, EParam::EP_C_TEMPO, double(bpms[bpm]));
+                    ParamEvent *p = arena.make<ParamEvent>(time, EParam::EP_C_TEMPO, double(bpms[bpm]));
                     m->addParamEvent(p);
                     printf(
                             "BMS [info] Added BPM_L event at %u:%u:%u [%s]->%lf\n",
@@ -338,7 +351,7 @@ void Chart_BMS::load_chart()
                     continue;
                 } else {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    ParamEvent* p = new ParamEvent(time, EParam::EP_C_STOP_T, int64_t(stops[stop]));
+                    ParamEvent* p = arena.make<ParamEvent>(time, EParam::EP_C_STOP_T, int64_t(stops[stop]));
                     m->addParamEvent(p);
                     printf(
                             "BMS [info] Added STOP event at %u:%u:%u [%s]->%li\n",
@@ -359,7 +372,7 @@ void Chart_BMS::load_chart()
                 if (wav != repeating_char_to_raw_uint('0', WAV_ID_LENGTH))
                 {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    Note_Single* n = new Note_Single(ENKey::NOTE_AUTO, time, wav);
+                    Note_Single* n = arena.make<Note_Single>(ENKey::NOTE_AUTO, time, wav);
                     m->addNote(n);
                 }
             }
@@ -395,7 +408,7 @@ void Chart_BMS::load_chart()
                 if (wav != repeating_char_to_raw_uint('0', WAV_ID_LENGTH))
                 {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    Note_Single* n = new Note_Single(key, time, wav);
+                    Note_Single* n = arena.make<Note_Single>(key, time, wav);
                     m->addNote(n);
                 }
             }
@@ -435,7 +448,7 @@ void Chart_BMS::load_chart()
                 if (wav != repeating_char_to_raw_uint('0', WAV_ID_LENGTH))
                 {
                     TTime time = m->getTimeFromTickCount(i*factor); time.measure = mn;
-                    Note_Single* n = new Note_Single(key, time, wav);
+                    Note_Single* n = arena.make<Note_Single>(key, time, wav);
                     LongNotes.push_back(n);
                 }
             }
@@ -458,13 +471,11 @@ void Chart_BMS::load_chart()
         while(b->getKey() != a->getKey())
             b = *(++it);
 
-        Note_Long *p = new Note_Long(*a, *b);
+        Note_Long *p = arena.make<Note_Long>(*a, *b);
         sequence[p->getTime().first.measure]->addNote(p);
 
         LongNotes.erase(LongNotes.begin());
         LongNotes.erase(it);
-        delete a;
-        delete b;
     }
 
     sort_sequence();
@@ -474,8 +485,13 @@ void Chart_BMS::load_chart()
 
 void Chart_BMS::load_samples()
 {
+    size_t done = 0;
+
     for(auto def : wavs)
     {
+        if (report_progress(done++, wavs.size()) == false)
+            return;
+
         std::string file = bms_fullpath;
         file = clan::PathHelp::add_trailing_slash(file);
         file.append(def.second);
@@ -485,33 +501,85 @@ void Chart_BMS::load_samples()
         else
             sample_map[def.first] = sample;
     }
+
+    report_progress(wavs.size(), wavs.size());
+    this->samples_loaded = true;
 }
 
-Music* scan_BMS_directory(const std::string &path)
+bool Chart_BMS::read_header(const std::string &path, Header &header)
 {
-    clan::DirectoryScanner clDS;
-    Music* music = new Music { path };
-    size_t index = 0;
+    std::string full_script;
+    try {
+        full_script = clan::File::read_text(path);
+    } catch (clan::Exception &e) {
+        return false;
+    }
+
+    header = Header { std::string(), std::string(), std::string(), 0, 0.0, 5, 0, std::string() };
 
-    if (clDS.scan(path, "*.bms"))
+    bool p1_67 = false, p2 = false;
+    unsigned int long_halves = 0;
+
+    // Only header commands are parsed; note data is skipped.
+    size_t a = 0;
+    while (a < full_script.size())
     {
-        while(clDS.next())
+        size_t b = full_script.find('\n', a);
+        if (b == std::string::npos)
+            b = full_script.size();
+
+        size_t p = full_script.find_first_not_of("\t ", a);
+        if (p < b && full_script[p] == '#')
         {
-            std::string file = std::string(path) + "/" + clDS.get_name().c_str();
-            Chart_BMS* chart = new Chart_BMS(file);
-            music->title  = chart->getName();
-            music->artist = chart->getCharter();
-            music->genre  = chart->getGenre();
-            music->charts[index] = chart;
-            index++;
+            size_t q = full_script.find_last_not_of("\t\r ", b - 1);
+            std::string line = full_script.substr(p, q + 1 - p);
+            std::string t, v;
+
+            /****/ if (get_bms_token(line, "#GENRE", t)) {
+                header.genre = t;
+            } else if (get_bms_token(line, "#TITLE", t)) {
+                header.title = t;
+            } else if (get_bms_token(line, "#ARTIST", t)) {
+                header.artist = t;
+            } else if (get_bms_token(line, "#PLAYLEVEL", t)) {
+                header.level = clan::StringHelp::text_to_uint(t);
+            } else if (get_bms_token(line, "#STAGEFILE", t)) {
+                header.stage = t;
+            } else if (get_bms_token(line, "#BPM", t, v)) {
+                // BPM value statement; not a header command.
+            } else if (get_bms_token(line, "#BPM", t)) {
+                header.tempo = clan::StringHelp::text_to_double(t);
+            } else if (get_bms_token(line, t, v) && t.size() == 5) {
+                // Count note objects to find the key mode and note count.
+                int const c = (t[3] - '0') * 10 + (t[4] - '0');
+                int const n = c % 10;
+                int const g = c / 10;
+
+                if ((g == 1 || g == 2 || g == 5 || g == 6) && n >= 1 && n <= 9 && n != 7)
+                {
+                    unsigned int objects = 0;
+                    for (size_t i = 0; i + 1 < v.size(); i += 2)
+                        if (v[i] != '0' || v[i+1] != '0')
+                            objects++;
+
+                    if (g == 1 || g == 2)
+                        header.notes += objects;
+                    else
+                        long_halves  += objects;
+
+                    if (objects > 0) {
+                        if (n == 8 || n == 9) p1_67 = true;
+                        if (g == 2 || g == 6) p2    = true;
+                    }
+                }
+            }
         }
-    }
 
-    if (index == 0)
-    {
-        delete music;
-        music = nullptr;
+        a = b + 1;
     }
 
-    return music;
-}
\ No newline at end of file
+    header.notes += long_halves / 2;
+    header.keys   = (p1_67 ? 7 : 5) * (p2 ? 2 : 1);
+
+    return true;
+}
@@ -6,12 +6,23 @@
 
 #include "Chart.hpp"
 
-struct Music;
 class Chart_BMS : public Chart
 {
 public:
     using BMSMsg = std::pair<std::string, std::string>;
 
+    /** Header commands needed to list a chart without parsing it. */
+    struct Header {
+        std::string     title;
+        std::string     artist;
+        std::string     genre;
+        unsigned int    level;
+        double          tempo;
+        unsigned int    keys;   //!< Number of key lanes, excluding scratch
+        unsigned int    notes;  //!< Number of playable notes
+        std::string     stage;  //!< Loading art file, relative to the chart
+    };
+
 private:
     std::map<uint, double> measure_ts_z;    // Measure Z Time Signatures
     std::map<uint, BMSMsg> messages;        // Line number -> Message map
@@ -49,11 +60,23 @@ public:
     unsigned int getRank () const { return rank;  }
     unsigned int getType () const { return type;  }
 
-    virtual void load_art     ();
+    virtual clan::PixelBuffer read_art() const;
     virtual void load_chart   ();
     virtual void load_samples ();
-};
 
-Music* scan_BMS_directory(const std::string &path);
+    virtual std::string getSourcePath() const { return bms_fullpath; }
+
+    /**
+     * Reads only the header commands of a BMS file.
+     * @return false if the file cannot be read.
+     */
+    static bool read_header(const std::string &path, Header &header);
+
+    /**
+     * Reads the loading art of a BMS file from its header alone.
+     * @return the art, or a null buffer if there is none.
+     */
+    static clan::PixelBuffer read_art(const std::string &path);
+};
 
 #endif
\ No newline at end of file
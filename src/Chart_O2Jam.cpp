@@ -1,59 +1,61 @@
+#include <cstring>
 #include "Chart_O2Jam.hpp"
 #include "Music.hpp"
 
 namespace O2Jam {
 
-//!~ OJN Music Parser
-Music* openOJN (const std::string& path)
+//!~ OJN Header Reader
+bool readOJNHeader (const std::string& path, OJN_Header& header)
 {
+    static_assert(sizeof(OJN_Header) == 300, "OJN header must be 300 bytes long.");
+
     clan::File file;
     if (file.open(path,
                 clan::File::OpenMode::open_existing,
                 clan::File::AccessFlags::access_read
                 ) == false)
-        return nullptr;
+        return false;
 
-    uint8_t* buffer = new uint8_t[300];
-    int read = file.read(buffer, 300);
-    if (read != 300) {
-        delete[] buffer;
-        return nullptr;
-    }
+    return file.read(&header, sizeof(OJN_Header)) == sizeof(OJN_Header);
+}
+
+std::string getGenre (const OJN_Header& header)
+{
+    switch(header.newGenreCode) {
+        case 0 : return "Ballad";
+        case 1 : return "Rock";
+        case 2 : return "Dance";
+        case 3 : return "Techno";
+        case 4 : return "Hip-hop";
+        case 5 : return "Soul/R&B";
+        case 6 : return "Jazz";
+        case 7 : return "Funk";
+        case 8 : return "Traditional";
+        case 9 : return "Classical";
+        case 10: return "Others";
+        default: return std::string(header.oldGenre, strnlen(header.oldGenre, sizeof(header.oldGenre)));
+    };
+}
 
-    OJN_Header *pHead = (OJN_Header*)buffer;
+//!~ OJN Music Parser
+Music* openOJN (const std::string& path)
+{
+    OJN_Header header;
+    if (readOJNHeader(path, header) == false)
+        return nullptr;
 
     // parse header
     Music* music = new Music;
     music->path     = path;
-    music->title    = pHead->Title;
-    music->artist   = pHead->Artist;
-    music->genre    = pHead->oldGenre;
-
-    switch(pHead->newGenreCode) {
-        case 0 : music->genre = "Ballad"; break;
-        case 1 : music->genre = "Rock"; break;
-        case 2 : music->genre = "Dance"; break;
-        case 3 : music->genre = "Techno"; break;
-        case 4 : music->genre = "Hip-hop"; break;
-        case 5 : music->genre = "Soul/R&B"; break;
-        case 6 : music->genre = "Jazz"; break;
-        case 7 : music->genre = "Funk"; break;
-        case 8 : music->genre = "Traditional"; break;
-        case 9 : music->genre = "Classical"; break;
-        case 10: music->genre = "Others"; break;
-    };
+    music->title    = std::string(header.Title , strnlen(header.Title , sizeof(header.Title )));
+    music->artist   = std::string(header.Artist, strnlen(header.Artist, sizeof(header.Artist)));
+    music->genre    = getGenre(header);
 
     // initialise charts
-    O2JamChart *ex = new O2JamChart(path, *pHead, 0);
-    O2JamChart *nx = new O2JamChart(path, *pHead, 1);
-    O2JamChart *hx = new O2JamChart(path, *pHead, 2);
-
-    // sync
-    music->charts[0] = (Chart*)ex;
-    music->charts[1] = (Chart*)nx;
-    music->charts[2] = (Chart*)hx;
+    music->charts[0] = new O2JamChart(path, header, 0);
+    music->charts[1] = new O2JamChart(path, header, 1);
+    music->charts[2] = new O2JamChart(path, header, 2);
 
-    delete[] buffer;
     return music;
 } // end openOJN
 
@@ -78,40 +80,55 @@ O2JamChart::O2JamChart(const std::string &path, const OJN_Header &header, uint8_
 
 
 
-void O2JamChart::load_art ()
+clan::PixelBuffer readOJNCover (const std::string& path, const OJN_Header& header)
 {
-    if (ojn_header.newCoverArtSize == 0)
-        return;
+    clan::PixelBuffer cover;
+
+    if (header.newCoverArtSize == 0)
+        return cover;
 
     clan::File file;
-    if (file.open(ojn_path,
+    if (file.open(path,
                 clan::File::OpenMode::open_existing,
                 clan::File::AccessFlags::access_read
                 ) == false)
-        return;
+        return cover;
 
-    file.seek(ojn_header.DataOffset[3], clan::File::seek_set);
+    file.seek(header.DataOffset[3], clan::File::seek_set);
 
-    uint8_t* buffer = new uint8_t[ojn_header.newCoverArtSize];
+    uint8_t* buffer = new uint8_t[header.newCoverArtSize];
 
-    int read = file.read(buffer, ojn_header.newCoverArtSize);
+    int read = file.read(buffer, header.newCoverArtSize);
 
-    if (read == static_cast<int>(ojn_header.newCoverArtSize)) {
+    if (read == static_cast<int>(header.newCoverArtSize)) {
         try
         {
             clan::DataBuffer        dbuff ( buffer, read );
             clan::IODevice_Memory   memio ( dbuff );
-            clan::PixelBuffer       cover ( memio, "jpg", false );
 
-            this->setCoverArt(cover);
-            this->cover_loaded = true;
+            cover = clan::PixelBuffer( memio, "jpg", false );
         } catch (clan::Exception &e) {
-            clan::Console::write_line("Failed to load .jpg cover art for %1.", ojn_header.Title);
+            clan::Console::write_line("Failed to load .jpg cover art for %1.", header.Title);
             clan::Console::write_line(e.get_message_and_stack_trace());
         }
     }
 
     delete[] buffer;
+    return cover;
+}
+
+clan::PixelBuffer readOJNCover (const std::string& path)
+{
+    OJN_Header header;
+    if (readOJNHeader(path, header) == false)
+        return clan::PixelBuffer();
+
+    return readOJNCover(path, header);
+}
+
+clan::PixelBuffer O2JamChart::read_art () const
+{
+    return readOJNCover(ojn_path, ojn_header);
 }
 
 void O2JamChart::load_chart ()
@@ -122,14 +139,14 @@ void O2JamChart::load_chart ()
     Measure*   pMeasure;
 
     // LONG note lists
-    SingleNoteList HNL, RNL;
+    std::vector<Note_Single*> HNL, RNL;
 
     // Counters : Params, Notes, SingleNotes, LongNotes, HoldNotes, ReleaseNotes, PlayNotes, AutoNotes.
     size_t cP = 0, cN = 0, cSN = 0, cLN = 0, cHN = 0, cRN = 0, cPN = 0, cAN = 0;
 
 
     for (unsigned n = 0; n <= ojn_header.numMeasures[chart_index]; n++)
-        sequence.push_back(new Measure(4, 48));
+        sequence.push_back(arena.make<Measure>(4, 48, &arena));
 
     clan::File file;
 
@@ -178,7 +195,7 @@ void O2JamChart::load_chart ()
                         uint16_t Tick = k * 192 / numEvents;
                         time = TTime(Tick % 48, Tick / 48, iMeasure);
 
-                        ParamEvent* pParamEvent = new ParamEvent(time, EParam::EP_C_TEMPO, *((float*)pPtr));
+                        ParamEvent* pParamEvent = arena.make<ParamEvent>(time, EParam::EP_C_TEMPO, *((float*)pPtr));
                         cP++;
 
                         pMeasure->addParamEvent(pParamEvent);
@@ -243,27 +260,27 @@ void O2JamChart::load_chart ()
                             nChannel = ENKey_toBG(iChannel - 9);
                             // Silently remove release notes.
                             if (Type == 2) {
-                                Note_Single* pNote = new Note_Single(nChannel, time, SmplID, Vol, Pan);
+                                Note_Single* pNote = arena.make<Note_Single>(nChannel, time, SmplID, Vol, Pan);
                                 pMeasure->addNote(pNote);
                                 cAN++, cSN++;
                                 fprintf(stderr, "[debug] Parsing to Hold Note in Autoplay Channel as Normal Note. \n");
                             } else if (Type == 3) {
                                 fprintf(stderr, "[debug] Skipping Release Note in Autoplay Channel. \n");
                             } else {
-                                Note_Single* pNote = new Note_Single(nChannel, time, SmplID, Vol, Pan);
+                                Note_Single* pNote = arena.make<Note_Single>(nChannel, time, SmplID, Vol, Pan);
                                 pMeasure->addNote(pNote);
                                 cAN++, cSN++;
                             }
                         } else if (Type == 2) { // Hold Notes
-                            Note_Single* pNote = new Note_Single(nChannel, time, SmplID, Vol, Pan);
+                            Note_Single* pNote = arena.make<Note_Single>(nChannel, time, SmplID, Vol, Pan);
                             HNL.push_back(pNote);
                             cHN++;
                         } else if (Type == 3) { // Release Notes
-                            Note_Single* pNote = new Note_Single(nChannel, time, SmplID, Vol, Pan);
+                            Note_Single* pNote = arena.make<Note_Single>(nChannel, time, SmplID, Vol, Pan);
                             RNL.push_back(pNote);
                             cRN++;
                         } else {
-                            Note_Single* pNote = new Note_Single(nChannel, time, SmplID, Vol, Pan);
+                            Note_Single* pNote = arena.make<Note_Single>(nChannel, time, SmplID, Vol, Pan);
                             pMeasure->addNote(pNote);
                             cAN++, cPN++;
                         }
@@ -277,15 +294,17 @@ void O2JamChart::load_chart ()
     }
 
     // Resolve links between hold and release notes.
-    NoteList L = zip_to_long_notes(HNL, RNL);
-    while(!L.empty())
-    {
-        auto it = L.begin();
-        Note* n = *it;
+    std::vector<Note*> L;
+    LongNoteReport const report = zip_to_long_notes(HNL, RNL, L, arena);
+
+    for (Note* n : L)
         sequence[n->getTime().measure]->addNote(n);
-        L.erase(it);
-        cLN++;
-    }
+
+    cLN = L.size();
+
+    if (report.lone_holds + report.mismatched_holds + report.dropped_releases > 0)
+        fprintf(stderr, "[debug] Long notes: %zu paired, %zu lone holds, %zu mismatched holds, %zu dropped releases.\n",
+                report.paired, report.lone_holds, report.mismatched_holds, report.dropped_releases);
 
     sort_sequence();
     this->notes = cPN;
@@ -369,7 +388,9 @@ static void decrypt_arrange (std::vector<uint8_t> &sData)
 }
 
 // type M30 parser
-void parseM30 (clan::File& file, SampleMap& sample_map)
+// returns false if the parse was cancelled through the progress callback;
+// throws if the file is malformed or cut short
+static bool parseM30 (clan::File& file, SampleMap& sample_map, Chart::ProgressCallback const &progress)
 {
     const int fileSize = file.get_size();
     static const /* constexpr */ int headSize = sizeof(M30_File_Header);   // 32 - 4 (signature) = 28
@@ -403,13 +424,15 @@ void parseM30 (clan::File& file, SampleMap& sample_map)
 
     for (unsigned int i = 0; i < smplCount; i++)
     {
+        if (progress(i, smplCount) == false)
+            return false;
+
         // Read M30 sample header
         buffer = new uint8_t[M30hSize];
         read = file.read(buffer, M30hSize);
         if (read != M30hSize) {
-            fprintf(stderr, "[debug] Fatal OJM file read error.\n");
             delete[] buffer;
-            break;
+            throw std::runtime_error("Truncated OJM file.");
         }
 
         M30_Sample_Header *pSmplHeader = (M30_Sample_Header*)buffer;
@@ -425,8 +448,10 @@ void parseM30 (clan::File& file, SampleMap& sample_map)
 
         buffer = new uint8_t[smplSize];
         read = file.read(buffer, smplSize);
-        if (read != (int)smplSize)
+        if (read != (int)smplSize) {
             delete[] buffer;
+            throw std::runtime_error("Truncated OJM file.");
+        }
 
         uint8_t* pSmplData = buffer;
 
@@ -456,11 +481,15 @@ void parseM30 (clan::File& file, SampleMap& sample_map)
         delete[] buffer;
     }
 
+    progress(smplCount, smplCount);
+    return true;
 }
 
 
 // type OMC parser
-void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
+// returns false if the parse was cancelled through the progress callback;
+// throws if the file is malformed or cut short
+static bool parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map, Chart::ProgressCallback const &progress)
 {
     // read headers
     int fileSize = file.get_size();
@@ -503,6 +532,9 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
     // clear buffer
     delete[] buffer;
 
+    // Progress is reported in bytes over both archives.
+    size_t const workTotal = WAV_PackSize + OGG_PackSize;
+
 
     if (WAV_PackSize > 0)
     {
@@ -513,8 +545,8 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
         buffer = new uint8_t[WAV_PackSize];
         read = file.read(buffer, WAV_PackSize);
         if (read != (int)WAV_PackSize) {
-            fprintf(stderr, "[fatal] Fatal OJM file read error.\n");
             delete[] buffer;
+            throw std::runtime_error("Truncated OJM file.");
         }
 
         uint8_t* pPtr = buffer;
@@ -525,6 +557,11 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 
         while (i < WAV_PackSize)
         {
+            if (progress(i, workTotal) == false) {
+                delete[] buffer;
+                return false;
+            }
+
             // read WAV header
             OMC_WAV_Header *pWAVHeader = (OMC_WAV_Header*)pPtr;
             pPtr += WAVhSize, i += WAVhSize;
@@ -639,8 +676,10 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 
         buffer = new uint8_t[OGG_PackSize];
         read = file.read(buffer, OGG_PackSize);
-        if (read != (int)OGG_PackSize)
+        if (read != (int)OGG_PackSize) {
             delete[] buffer;
+            throw std::runtime_error("Truncated OJM file.");
+        }
 
         uint8_t* pPtr = buffer;
 
@@ -648,6 +687,11 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 
         for(unsigned long i = 0; i < OGG_PackSize; )
         {
+            if (progress(WAV_PackSize + i, workTotal) == false) {
+                delete[] buffer;
+                return false;
+            }
+
             // read header
             OMC_OGG_Header *pOGGHeader = (OMC_OGG_Header*)pPtr;
             pPtr += OGGhSize, i += OGGhSize;
@@ -671,7 +715,12 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
             }
 
         }
+
+        delete[] buffer;
     }
+
+    progress(workTotal, workTotal);
+    return true;
 }
 
 
@@ -688,17 +737,22 @@ void O2JamChart::load_samples()
     if (file.get_size() < 4)
         throw std::invalid_argument("Malformed OJM file.");
 
+    ProgressCallback report = [this] (size_t done, size_t total) -> bool {
+        return this->report_progress(done, total);
+    };
+
     // Read file based on signature
+    bool complete = true;
     uint32_t signature = file.read_uint32();
     switch (signature)
     {
-        case OJM_SIGNATURE: parseOMC(file, false, sample_map); break;
-        case OMC_SIGNATURE: parseOMC(file, true , sample_map); break;
-        case M30_SIGNATURE: parseM30(file, sample_map); break;
+        case OJM_SIGNATURE: complete = parseOMC(file, false, sample_map, report); break;
+        case OMC_SIGNATURE: complete = parseOMC(file, true , sample_map, report); break;
+        case M30_SIGNATURE: complete = parseM30(file, sample_map, report); break;
         default: fprintf(stderr, "[warn] Unknown OJM signature. \n");
     }
 
-    this->samples_loaded = true;
+    this->samples_loaded = complete;
 }
 
 };
@@ -22,11 +22,23 @@ protected:
 
 public:
     O2JamChart(const std::string &path, const OJN_Header &header, uint8_t index);
-    virtual void load_art    () override;
+    virtual clan::PixelBuffer read_art() const override;
     virtual void load_chart  () override;
     virtual void load_samples() override;
+
+    virtual std::string  getSourcePath () const override { return ojn_path; }
+    virtual unsigned int getSourceIndex() const override { return chart_index; }
 };
 
+/** Reads the header of an OJN file. @return false if it cannot be read. */
+bool        readOJNHeader(const std::string &path, OJN_Header &header);
+/** Gets the genre name of an OJN file from its header. */
+std::string getGenre(const OJN_Header &header);
+/** Reads the cover art of an OJN file. @return a null buffer if there is none. */
+clan::PixelBuffer readOJNCover(const std::string &path, const OJN_Header &header);
+/** Reads the cover art of an OJN file without opening its charts. */
+clan::PixelBuffer readOJNCover(const std::string &path);
+
 Music* openOJN(const std::string &path);
 
 }
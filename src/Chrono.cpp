@@ -62,6 +62,8 @@ void TClock::resetClock (double BPM, bool startNow)
 
     tct_tick = 0;
     tct_stop = 0;
+    tct_rstop = 0;
+    tct_rheld = false;
 
     currTTime.reset();
     nextTTime.reset();
@@ -79,11 +81,9 @@ void TClock::resetClock (double BPM, bool startNow)
 }
 
 // Update clock. Returns false if interrupted.
-bool TClock::update()
+bool TClock::update(sysTimeP const &tpt_now)
 {
     if (isTicking) {
-        const sysTimeP tpt_now = sysClock::now();
-
         // This casting and converting hack is done to make the clock run correctly on Linux.
         // The original works just fine on Windows.
         //       -= std::chrono::duration_cast<TimeUnit>(tpt_now - tpt_LastRun).count();
@@ -91,6 +91,18 @@ bool TClock::update()
         tpt_LastRun = tpt_now;
     }
 
+    // The held time of a real-time stop has run out.
+    if (tct_rheld && tct_mstt <= 0)
+        tct_rheld = false;
+
+    // Real-time stops hold the clock for their whole length at once.
+    if (tct_rstop > 0 && tct_mstt <= 0)
+    {
+        tct_mstt += tct_rstop;
+        tct_rstop = 0;
+        tct_rheld = true;
+    }
+
     while (tct_stop > 0)
     {
         if (tct_mstt <= 0) {
@@ -121,7 +133,7 @@ bool TClock::update()
 
         // Interrupted. Exit now.
         if (currTTime == nextTTime) {
-            tpt_Segment = sysClock::now();
+            tpt_Segment = tpt_now;
 
             nextTTime.reset();
             return false;
@@ -7,7 +7,7 @@
 #include <cstdio>
 #include <chrono>
 
-typedef std::chrono::system_clock           sysClock; // Steady clock
+typedef std::chrono::steady_clock           sysClock; // Steady clock
 typedef std::chrono::time_point<sysClock>   sysTimeP; // Time point from steady clock
 typedef std::chrono::milliseconds           TimeUnit; // Time point unit in milliseconds
 
@@ -49,6 +49,8 @@ private:
     unsigned    tct_tick;       // Total tick count
 
     unsigned    tct_stop;       // Stop tick count
+    double      tct_rstop;      // Stop time left in milliseconds
+    bool        tct_rheld;      // Is a real-time stop holding the clock?
 
     bool        isTicking;      // Is the clock ticking?
 
@@ -65,7 +67,10 @@ public:
     void resetClock (double BPM = 0.0, bool startNow = false);
 
     // Update clock. Returns false if interrupted.
-    bool update ();
+    inline bool update () { return update(sysClock::now()); }
+
+    // Update clock to the given time point. Returns false if interrupted.
+    bool update (sysTimeP const &now);
 
     // Change time signature
     inline void setTCSig (unsigned nA = 4, unsigned nB = 48)
@@ -96,8 +101,13 @@ public:
         printf("[%lf] GOT TSTOP %u @ ", tmp_bpm, t); currTTime.print(); printf("\n");
         tct_stop = t;
     }
+    inline void setRStop (double ms)
+    {
+        tct_rstop = ms;
+    }
+
     inline bool isTStopped () const {
-        return tct_stop > 0;
+        return tct_stop > 0 || tct_rstop > 0 || tct_rheld;
     }
 
     inline unsigned const &getTicksPerBeat   () const { return tsg_tpb; }
@@ -107,7 +117,7 @@ public:
     inline unsigned getTicksSinceMeasure() const { return currTTime.tick + currTTime.beat * tsg_tpb; }
 
     inline bool status () { return isTicking; }
-    inline void start () { isTicking = true ; tct_mstt = 0; }
+    inline void start (sysTimeP const &now = sysClock::now()) { isTicking = true ; tct_mstt = 0; tpt_Music = tpt_LastRun = now; }
     inline void pause () { isTicking = false; }
     inline void unpause() { isTicking = true; }
 
@@ -1,7 +1,5 @@
 #include "Game.hpp"
 
-#include "Note.hh"      // Declare global audio manager on Note.hh
-
 Game::Game(clan::DisplayWindow &_clDW, clan::GUIManager &_clUI) :
     GUIComponent(&_clUI, { recti{ 0, 0, _clDW.get_gc().get_size() }, false }, "Game"),
     conf("config.json"),
@@ -10,11 +8,14 @@ Game::Game(clan::DisplayWindow &_clDW, clan::GUIManager &_clUI) :
     clUI(_clUI),
     clCv(clDW),
     clGC(clCv.get_gc()),
-    am  (conf.getInteger("audio.frame-rate"), conf.getInteger("audio.sample-rate")),
+    am  (conf.getInteger("audio.frame-rate"), conf.getInteger("audio.sample-rate"),
+         conf.get_if_else_set(
+             &JSONReader::getInteger, "audio.mix-threads", 0,
+             [](long const & value) -> bool { return value >= 0 && value <= 16; }
+             )),
     im  (clDW.get_ic())
 {
     func_input().set(this, &Game::process_input);
-    Note::am = &am;
     // TODO compile list of keys that would be used in the game and
     // notify InputManager to listen to these keys
 }
@@ -3,67 +3,167 @@
 
 #include "InputManager.hpp"
 
-KeyStatus& InputManager::getKey(const KeyCode& key) { return keys[key]; }
+constexpr size_t  InputManager::kKeyCount;
+constexpr size_t  InputManager::kLaneCount;
+constexpr uint8_t InputManager::kNoLane;
 
-bool InputManager::isOff   (const KeyCode& key) const { return (keys.at(key) == KeyStatus::OFF); }
-bool InputManager::isOn    (const KeyCode& key) const { return (keys.at(key) != KeyStatus::OFF); }
-bool InputManager::isLocked(const KeyCode& key) const { return (keys.at(key) == KeyStatus::LOCKED); }
+KeyStatus InputManager::getKey(const KeyCode& key) const { return mKeys[index(key)].load(std::memory_order_acquire); }
+
+bool InputManager::isOff   (const KeyCode& key) const { return (getKey(key) == KeyStatus::OFF); }
+bool InputManager::isOn    (const KeyCode& key) const { return (getKey(key) != KeyStatus::OFF); }
+bool InputManager::isLocked(const KeyCode& key) const { return (getKey(key) == KeyStatus::LOCKED); }
 
 void InputManager::turn_on (const KeyCode& key)
 {
-    KeyStatus& s = keys[key];
-    if (s == KeyStatus::OFF)
-        s =  KeyStatus::ON;
+    KeyStatus s = KeyStatus::OFF;
+    mKeys[index(key)].compare_exchange_strong(s, KeyStatus::ON, std::memory_order_acq_rel);
 }
 
 void InputManager::turn_off(const KeyCode& key)
 {
-    keys[key] = KeyStatus::OFF;
+    mKeys[index(key)].store(KeyStatus::OFF, std::memory_order_release);
 }
 
 bool InputManager::try_lock(const KeyCode& key)
 {
-    KeyStatus& s = keys[key];
+    KeyStatus s = KeyStatus::ON;
+    return mKeys[index(key)].compare_exchange_strong(s, KeyStatus::LOCKED, std::memory_order_acq_rel);
+}
+
+bool InputManager::try_unlock(const KeyCode& key)
+{
+    KeyStatus s = KeyStatus::LOCKED;
+    return mKeys[index(key)].compare_exchange_strong(s, KeyStatus::ON, std::memory_order_acq_rel);
+}
 
-    if (s == KeyStatus::ON) {
-        s =  KeyStatus::LOCKED;
-        return true;
-    } else {
+
+bool InputManager::pop_event(KeyEvent &event)
+{
+    if (mEvents.pop(event) == false)
         return false;
+
+    if (mExternal.load(std::memory_order_relaxed)) {
+        if (event.down)
+            turn_on (event.code);
+        else
+            turn_off(event.code);
     }
+
+    return true;
 }
 
-bool InputManager::try_unlock(const KeyCode& key)
+void InputManager::clear_events()
+{
+    KeyEvent event;
+    while(mEvents.pop(event))
+        continue;
+
+    // Events may have been dropped when the queue was full; start over.
+    if (mExternal.load(std::memory_order_relaxed))
+        for(size_t i = 0; i < kKeyCount; i++)
+            mKeys[i].store(KeyStatus::OFF, std::memory_order_relaxed);
+}
+
+
+// Sample ID (32 bits), track (8 bits), volume (8 bits), pan (8 bits), set (1 bit)
+static inline uint64_t pack_sound(InputManager::KeySound const &s)
+{
+    uint64_t const vol = static_cast<uint64_t>(lround(std::min(1.0f, std::max(0.0f, s.vol)) * 255.0f));
+    uint64_t const pan = static_cast<uint64_t>(lround(std::min(1.0f, std::max(-1.0f, s.pan)) * 127.0f) + 127);
+
+    return static_cast<uint64_t>(s.sample)
+        | (static_cast<uint64_t>(s.track) << 32)
+        | (vol << 40)
+        | (pan << 48)
+        | (1ull << 56);
+}
+
+static inline InputManager::KeySound unpack_sound(uint64_t v)
+{
+    return InputManager::KeySound {
+        static_cast<unsigned>(v & 0xFFFFFFFF),
+        static_cast<uchar>((v >> 32) & 0xFF),
+        static_cast<float>((v >> 40) & 0xFF) / 255.0f,
+        (static_cast<float>((v >> 48) & 0xFF) - 127.0f) / 127.0f
+    };
+}
+
+void InputManager::bind_lane(KeyCode const &key, uint8_t lane)
+{
+    if (index(key) != 0)
+        mLanes[index(key)].store(lane < kLaneCount ? lane : kNoLane, std::memory_order_relaxed);
+}
+
+void InputManager::unbind_lanes()
+{
+    for(size_t i = 0; i < kKeyCount; i++)
+        mLanes[i].store(kNoLane, std::memory_order_relaxed);
+    for(size_t i = 0; i < kLaneCount; i++)
+        mSounds[i].store(0, std::memory_order_relaxed);
+}
+
+void InputManager::set_sound(uint8_t lane, KeySound const &sound)
+{
+    if (lane < kLaneCount)
+        mSounds[lane].store(pack_sound(sound), std::memory_order_release);
+}
+
+void InputManager::clear_sound(uint8_t lane)
+{
+    if (lane < kLaneCount)
+        mSounds[lane].store(0, std::memory_order_release);
+}
+
+bool InputManager::get_sound(KeyCode const &key, KeySound &sound) const
 {
-    KeyStatus& s = keys[key];
-    if (s == KeyStatus::LOCKED) {
-        s =  KeyStatus::ON;
-        return true;
-    } else {
+    uint8_t const lane = getLane(key);
+    if (lane >= kLaneCount)
         return false;
-    }
+
+    uint64_t const v = mSounds[lane].load(std::memory_order_acquire);
+    if (v == 0)
+        return false;
+
+    sound = unpack_sound(v);
+    return true;
+}
+
+
+void InputManager::FKeyUp  (const clan::InputEvent& event)
+{
+    if (mExternal.load(std::memory_order_relaxed))
+        return;
+
+    push_event({ event.id, false, sysClock::now() });
+    this->turn_off(event.id);
 }
 
+void InputManager::FKeyDown(const clan::InputEvent& event)
+{
+    if (mExternal.load(std::memory_order_relaxed))
+        return;
 
-void InputManager::FKeyUp  (const clan::InputEvent& event) { this->turn_off(event.id); }
-void InputManager::FKeyDown(const clan::InputEvent& event) { this->turn_on (event.id); }
+    // Ignore key repeats.
+    if (getKey(event.id) == KeyStatus::OFF)
+        push_event({ event.id, true , sysClock::now() });
+    this->turn_on (event.id);
+}
 
 InputManager::InputManager(clan::InputContext clIC)
-:   mCKeyUp  (this, &InputManager::FKeyUp)
+:   mKeys    (new std::atomic<KeyStatus>[kKeyCount])
+,   mLanes   (new std::atomic<uint8_t  >[kKeyCount])
+,   mExternal(false)
+,   mCKeyUp  (this, &InputManager::FKeyUp)
 ,   mCKeyDown(this, &InputManager::FKeyDown)
 {
+    for(size_t i = 0; i < kKeyCount; i++)
+        mKeys[i].store(KeyStatus::OFF, std::memory_order_relaxed);
+    unbind_lanes();
+
     clIC.get_keyboard().sig_key_up  ().connect(mCKeyUp);
     clIC.get_keyboard().sig_key_down().connect(mCKeyDown);
     // clIC.get_mouse().sig_key_up  ().connect(&CLIDCallback_KeyUp, this);
     // clIC.get_mouse().sig_key_down().connect(&CLIDCallback_KeyDown, this);
-
-    // Create used keys in map
-    try_lock(clan::keycode_escape);
-    try_lock(clan::keycode_enter);
-    try_lock(clan::keycode_up);
-    try_lock(clan::keycode_down);
-    try_lock(clan::keycode_left);
-    try_lock(clan::keycode_right);
 }
 
 InputManager::InputManager(clan::GUIComponent *clUIC) : InputManager(clUIC->get_ic())
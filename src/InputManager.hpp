@@ -5,30 +5,21 @@
 #define INPUT_H
 
 #include "__zzCore.hpp"
+#include "Chrono.hpp"
+#include "KeyStatus.hpp"
+#include "libawe/aweQueue.h"
 
 /**
- * A key can be in any of these four states: OFF, ON, LOCKED and AUTO.
- *
- * When the key is being pressed down, it is ON.
- * When the key is NOT being pressed down, it is OFF.
+ * Class used to manage input from input devices.
  *
- * Any function with access to this class can call try_lock() to LOCK a key
- * that has been pressed down to describe that the key has already been used by
- * the calling function. The lock is reset whenever the key is de-pressed or by
- * calling try_unlock().
+ * The status of every key is kept in a flat table indexed by key code,
+ * and can be read and changed from any thread. Key codes are bound to
+ * lanes, so that a lane can be played with more than one key.
  *
- * AUTO is a state used by the game to auto-trigger notes.
- */
-enum class KeyStatus : uchar {
-    OFF    = 0, /** When button is up.   */
-    ON     = 1, /** When button is down. */
-    LOCKED = 2, /** When button is down and LOCKED. */
-    AUTO   = 3, /** Auto-fire */
-};
-
-/**
- * Class used to manage input from input devices.
- * TODO: Make keys more configurable.
+ * Besides keeping the current status of every key, key presses and
+ * releases are time stamped and queued when they come in, so that they
+ * can be judged by the time they happened rather than the frame they
+ * were noticed in.
  */
 class InputManager
 {
@@ -36,10 +27,40 @@ public:
     typedef int KeyCode;
     typedef std::pair<KeyCode, KeyStatus> Key;
 
+    static constexpr size_t  kKeyCount  = 0x10000;  //!< Size of the key table
+    static constexpr size_t  kLaneCount = 32;       //!< Number of lanes keys can be bound to
+    static constexpr uint8_t kNoLane    = 0xFF;     //!< Lane of unbound keys
+
+    /** Position of a key in the key table. Codes out of the table share
+     *  the unused slot 0. */
+    static inline size_t index(KeyCode const &key)
+    {
+        return (key > 0 && static_cast<size_t>(key) < kKeyCount) ? static_cast<size_t>(key) : 0;
+    }
+
+    /** A key press or release. */
+    struct KeyEvent
+    {
+        KeyCode     code;   //! Key pressed or released
+        bool        down;   //! Was the key pressed?
+        sysTimeP    time;   //! When it happened
+    };
+
+    using EventQueue = awe::AqueueMPSC<KeyEvent, 1024>;
+
+    /** Sound to play when a key is pressed. */
+    struct KeySound
+    {
+        unsigned    sample; //! Chart sample ID
+        uchar       track;  //! Audio track to play on
+        float       vol;
+        float       pan;
+    };
+
     InputManager(clan::InputContext clIC);
     InputManager(clan::GUIComponent *clUIC);
 
-    KeyStatus& getKey(const KeyCode& key);
+    KeyStatus getKey(const KeyCode& key) const;
 
     /** @return true if the key is not being pressed. */
     bool isOff (const KeyCode& key) const;
@@ -58,8 +79,50 @@ public:
     /** Returns true on success or false if the key was not previously locked. */
     bool try_unlock (const KeyCode& key);
 
+    /** Queues a key event. Safe to call from any thread.
+     *  @return false if the queue is full and the event was dropped. */
+    inline bool push_event(KeyEvent const &event) { return mEvents.push(event); }
+
+    /** Takes the oldest key event off the queue. Only one thread may do this.
+     *  If events come from an external source, the key status is updated.
+     *  @return false if there are no events. */
+    bool pop_event(KeyEvent &event);
+
+    /** Throws away all queued key events. */
+    void clear_events();
+
+    /** Sets whether key events come from somewhere else than ClanLib, i.e.
+     *  an InputPoller. ClanLib key signals are then ignored, and the key
+     *  status follows the events as they are taken off the queue. */
+    inline void set_external_events(bool external) { mExternal.store(external); }
+
+    /** Binds a key to a lane. */
+    void bind_lane(KeyCode const &key, uint8_t lane);
+    /** Unbinds every key from its lane, and the sound of every lane. */
+    void unbind_lanes();
+    /** @return the lane a key is bound to, or kNoLane. */
+    inline uint8_t getLane(KeyCode const &key) const
+    {
+        return mLanes[index(key)].load(std::memory_order_relaxed);
+    }
+
+    /** Sets the sound to play when a key of a lane is pressed. */
+    void set_sound(uint8_t lane, KeySound const &sound);
+    /** Unsets the sound of a lane. */
+    void clear_sound(uint8_t lane);
+    /** Looks up the sound to play when a key is pressed. Safe to call from any thread.
+     *  @return false if the key has no sound. */
+    bool get_sound(KeyCode const &key, KeySound &sound) const;
+
 private:
-    std::map<KeyCode, KeyStatus> keys;
+    std::unique_ptr< std::atomic<KeyStatus>[] > mKeys;  //! Key status table
+    std::unique_ptr< std::atomic<uint8_t  >[] > mLanes; //! Key lane table
+
+    EventQueue          mEvents;
+    std::atomic<bool>   mExternal;
+
+    // Lane sounds; packed into one word so they are read in one go.
+    std::array<std::atomic<uint64_t>, kLaneCount> mSounds;
 
     clan::Callback<void(const clan::InputEvent &)> mCKeyUp;
     clan::Callback<void(const clan::InputEvent &)> mCKeyDown;
@@ -0,0 +1,231 @@
+//  InputPoller.cpp :: Input device polling thread
+//  Copyright 2014 Keigen Shu
+
+#include "InputPoller.hpp"
+#include "AudioManager.hpp"
+
+#if defined(__linux__)
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+//! Maps evdev key codes to ClanLib key codes.
+static InputManager::KeyCode evdev_to_keycode(unsigned code)
+{
+    static std::array<InputManager::KeyCode, KEY_CNT> const table = [] {
+        std::array<InputManager::KeyCode, KEY_CNT> t;
+        t.fill(0);
+
+        unsigned const letters[26] = {
+            KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I,
+            KEY_J, KEY_K, KEY_L, KEY_M, KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R,
+            KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+        };
+        for(int i = 0; i < 26; i++)
+            t[letters[i]] = clan::InputCode::keycode_a + i;
+
+        unsigned const digits[10] = {
+            KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9
+        };
+        for(int i = 0; i < 10; i++)
+            t[digits[i]] = clan::InputCode::keycode_0 + i;
+
+        unsigned const functions[12] = {
+            KEY_F1, KEY_F2, KEY_F3, KEY_F4 , KEY_F5 , KEY_F6 ,
+            KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12
+        };
+        for(int i = 0; i < 12; i++)
+            t[functions[i]] = clan::InputCode::keycode_f1 + i;
+
+        t[KEY_SPACE     ] = clan::InputCode::keycode_space;
+        t[KEY_ENTER     ] = clan::InputCode::keycode_enter;
+        t[KEY_ESC       ] = clan::InputCode::keycode_escape;
+        t[KEY_BACKSPACE ] = clan::InputCode::keycode_backspace;
+        t[KEY_TAB       ] = clan::InputCode::keycode_tab;
+        t[KEY_UP        ] = clan::InputCode::keycode_up;
+        t[KEY_DOWN      ] = clan::InputCode::keycode_down;
+        t[KEY_LEFT      ] = clan::InputCode::keycode_left;
+        t[KEY_RIGHT     ] = clan::InputCode::keycode_right;
+        t[KEY_LEFTSHIFT ] = clan::InputCode::keycode_lshift;
+        t[KEY_RIGHTSHIFT] = clan::InputCode::keycode_rshift;
+        t[KEY_LEFTCTRL  ] = clan::InputCode::keycode_lcontrol;
+        t[KEY_RIGHTCTRL ] = clan::InputCode::keycode_rcontrol;
+        t[KEY_SEMICOLON ] = clan::InputCode::keycode_semicolon;
+        t[KEY_COMMA     ] = clan::InputCode::keycode_comma;
+        t[KEY_DOT       ] = clan::InputCode::keycode_period;
+        t[KEY_SLASH     ] = clan::InputCode::keycode_slash;
+        return t;
+    }();
+
+    return (code < KEY_CNT) ? table[code] : 0;
+}
+
+static inline bool test_bit(unsigned char const *bits, unsigned bit)
+{
+    return (bits[bit / 8] >> (bit % 8)) & 1;
+}
+#endif
+
+
+InputPoller::InputPoller(InputManager &im, AudioManager *am, unsigned rate)
+    : mIM       (im)
+    , mAM       (am)
+    , mDevices  ()
+    , mThread   (nullptr)
+    , mRunning  (false)
+    , mTimeout  (std::max(1u, 1000u / std::max(1u, rate)))
+{ }
+
+InputPoller::~InputPoller()
+{
+    stop();
+}
+
+bool InputPoller::start()
+{
+#if defined(__linux__)
+    if (mThread != nullptr)
+        return true;
+
+    for(int i = 0; i < 32; i++)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "/dev/input/event%d", i);
+
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        // Only take devices that have letter keys.
+        unsigned char ev [(EV_MAX  + 8) / 8] = {};
+        unsigned char key[(KEY_MAX + 8) / 8] = {};
+
+        if (ioctl(fd, EVIOCGBIT(0     , sizeof(ev )), ev ) < 0 || test_bit(ev, EV_KEY) == false
+        ||  ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key)), key) < 0 || test_bit(key, KEY_A) == false)
+        {
+            close(fd);
+            continue;
+        }
+
+        // Have the kernel time stamp events on the clock TClock runs on;
+        // real time stamps cannot be compared with the game clock.
+        int clock = CLOCK_MONOTONIC;
+        if (ioctl(fd, EVIOCSCLOCKID, &clock) < 0)
+        {
+            fprintf(stderr, "[warn] InputPoller: Skipping %s; it does not take monotonic time stamps.\n", path);
+            close(fd);
+            continue;
+        }
+
+        printf("[info] InputPoller: Reading keys from %s.\n", path);
+        mDevices.push_back(fd);
+    }
+
+    if (mDevices.empty()) {
+        fprintf(stderr, "[warn] InputPoller: No readable keyboard devices.\n");
+        return false;
+    }
+
+    mIM.set_external_events(true);
+
+    mRunning.store(true);
+    mThread = new std::thread(&InputPoller::run, this);
+    return true;
+#else
+    fprintf(stderr, "[warn] InputPoller: Not supported on this platform.\n");
+    return false;
+#endif
+}
+
+void InputPoller::stop()
+{
+    if (mThread == nullptr)
+        return;
+
+    mRunning.store(false);
+    mThread->join();
+    delete mThread;
+    mThread = nullptr;
+
+#if defined(__linux__)
+    for(int fd : mDevices)
+        close(fd);
+#endif
+    mDevices.clear();
+
+    mIM.set_external_events(false);
+}
+
+void InputPoller::run()
+{
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), "Input Poller");
+
+    std::vector<pollfd> fds;
+    for(int fd : mDevices)
+        fds.push_back(pollfd { fd, POLLIN, 0 });
+
+    input_event events[64];
+
+    while(mRunning.load(std::memory_order_relaxed))
+    {
+        if (poll(fds.data(), fds.size(), mTimeout) <= 0)
+            continue;
+
+        for(size_t d = 0; d < fds.size(); )
+        {
+            pollfd const &p = fds[d];
+
+            ssize_t n = 0;
+            if (p.revents & POLLIN)
+                n = read(p.fd, events, sizeof(events));
+
+            // Drop devices that have been unplugged; polling them again
+            // would return at once, forever.
+            if ((p.revents & (POLLERR | POLLHUP | POLLNVAL)) || (n < 0 && errno == ENODEV))
+            {
+                fprintf(stderr, "[warn] InputPoller: Lost input device %d.\n", p.fd);
+
+                close(p.fd);
+                mDevices.erase(std::find(mDevices.begin(), mDevices.end(), p.fd));
+                fds.erase(fds.begin() + d);
+                continue;
+            }
+
+            d++;
+
+            for(ssize_t i = 0; i < n / static_cast<ssize_t>(sizeof(input_event)); i++)
+            {
+                input_event const &e = events[i];
+
+                // Values are 0 for release, 1 for press and 2 for repeat.
+                if (e.type != EV_KEY || e.value == 2)
+                    continue;
+
+                InputManager::KeyCode const code = evdev_to_keycode(e.code);
+                if (code == 0)
+                    continue;
+
+                sysTimeP const time {
+                    std::chrono::duration_cast<sysClock::duration>(
+                            std::chrono::seconds(e.time.tv_sec) + std::chrono::microseconds(e.time.tv_usec)
+                            )
+                };
+
+                mIM.push_event({ code, e.value == 1, time });
+
+                InputManager::KeySound sound;
+                if (mAM != nullptr && e.value == 1 && mIM.get_sound(code, sound))
+                    mAM->play(sound.sample, sound.track, sound.vol, sound.pan);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,68 @@
+//  InputPoller.hpp :: Input device polling thread
+//  Copyright 2014 Keigen Shu
+
+#ifndef INPUT_POLLER_H
+#define INPUT_POLLER_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "InputManager.hpp"
+
+class AudioManager;
+
+/**
+ * Reads key presses straight from the input devices on a thread of its
+ * own, so that they do not wait for the window system and the render
+ * loop to dispatch them.
+ *
+ * Events carry the time stamp given by the kernel and are pushed onto the
+ * InputManager's event queue, which becomes their only source. If enabled,
+ * the sound bound to a key is queued on the audio engine right away.
+ *
+ * Devices that cannot time stamp events on the monotonic clock are
+ * skipped, and devices that are unplugged are dropped.
+ *
+ * Only Linux evdev keyboards are supported; \ref start fails elsewhere.
+ */
+class InputPoller
+{
+private:
+    InputManager      & mIM;
+    AudioManager      * mAM;            //!< Plays key sounds; null if disabled
+
+    std::vector<int>    mDevices;       //!< Open device file descriptors; the thread owns them while it runs
+    std::thread       * mThread;
+    std::atomic<bool>   mRunning;
+
+    int                 mTimeout;       //!< Poll timeout in milliseconds
+
+    void run();
+
+public:
+    /**
+     * @param im    input manager to push events to.
+     * @param am    audio manager to play key sounds on; null to leave them
+     *              to the notes.
+     * @param rate  polling rate in Hz.
+     */
+    InputPoller(InputManager &im, AudioManager *am = nullptr, unsigned rate = 1000);
+    ~InputPoller();
+
+    InputPoller(InputPoller const &) = delete;
+    InputPoller& operator=(InputPoller const &) = delete;
+
+    /**
+     * Opens every keyboard device that can be read and starts polling.
+     * @return false if no device could be opened.
+     */
+    bool start();
+
+    //! Stops polling and closes the devices.
+    void stop();
+
+    inline bool isRunning() const { return mThread != nullptr; }
+};
+
+#endif
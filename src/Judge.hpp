@@ -18,7 +18,7 @@ struct JScore
 {
     EJRank  rank;   //! Accuracy ranking
     long    score;  //! Score given
-    long    delta;  //! Tick difference
+    long    delta;  //! Tick difference, or microseconds under real timing
 
     /* constexpr */ JScore() : rank(NONE), score(0), delta(0) { }
     /* constexpr */ JScore(EJRank const &R, long const &S, long const &D) : rank(R), score(S), delta(D) { }
@@ -48,6 +48,11 @@ public:
         tP(0  ), tC(0  ), tG(0  ), tB(0  )
     { }
 
+    inline long const &cgetRP() const { return rP; }
+    inline long const &cgetRC() const { return rC; }
+    inline long const &cgetRG() const { return rG; }
+    inline long const &cgetRB() const { return rB; }
+
     inline long const &cgetTP() const { return tP; }
     inline long const &cgetTC() const { return tC; }
     inline long const &cgetTG() const { return tG; }
@@ -92,6 +97,18 @@ public:
         tB += ceiling_factor - tB % ceiling_factor;
     }
 
+    /**
+     * Sets the rank timing-window to the base timing in microseconds, to
+     * judge real time differences instead of tick differences.
+     */
+    inline void calculateRealTiming()
+    {
+        tP = rP * 1000;
+        tC = rC * 1000;
+        tG = rG * 1000;
+        tB = rB * 1000;
+    }
+
     inline bool isInScoringRange(const long &delta) const
     {
         return (delta < tP + tC + tG + tB);
@@ -0,0 +1,29 @@
+//  KeyStatus.hpp :: Key status enumerator
+//  Copyright 2013 Keigen Shu
+
+#ifndef KEY_STATUS_H
+#define KEY_STATUS_H
+
+#include <cstdint>
+
+/**
+ * A key can be in any of these four states: OFF, ON, LOCKED and AUTO.
+ *
+ * When the key is being pressed down, it is ON.
+ * When the key is NOT being pressed down, it is OFF.
+ *
+ * Any function with access to this class can call try_lock() to LOCK a key
+ * that has been pressed down to describe that the key has already been used by
+ * the calling function. The lock is reset whenever the key is de-pressed or by
+ * calling try_unlock().
+ *
+ * AUTO is a state used by the game to auto-trigger notes.
+ */
+enum class KeyStatus : uint8_t {
+    OFF    = 0, /** When button is up.   */
+    ON     = 1, /** When button is down. */
+    LOCKED = 2, /** When button is down and LOCKED. */
+    AUTO   = 3, /** Auto-fire */
+};
+
+#endif
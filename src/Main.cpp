@@ -1,3 +1,6 @@
+#include <ctime>
+#include <sys/stat.h>
+
 #include "__zzCore.hpp"
 
 #ifdef __USE_D3D
@@ -10,6 +13,7 @@
 #include "Game.hpp"
 
 #include "UI/MusicSelector.hpp"
+#include "UI/LoadScreen.hpp"
 #include "UI/FFT.hpp"
 #include "UI/Tracker.hpp"
 
@@ -18,9 +22,17 @@
 #include "UI/Graph_FrameRate.hpp"
 
 #include "AudioTrack.hpp"
+#include "InputPoller.hpp"
+#include "Replay.hpp"
+#include "Simulation.hpp"
+#include "ChartData.hpp"
 #include "libawe/Filters/Maximizer.h"
 
-#include "MusicScanner.hpp"
+#include "MusicLibrary.hpp"
+#include "Music.hpp"
+#include "ChartCache.hpp"
+#include "ChartLoader.hpp"
+#include "ChartPreloader.hpp"
 #include "Chart_O2Jam.hpp"
 #include "Chart_BMS.hpp"
 
@@ -31,21 +43,21 @@ bool noSound = true;
 
 UI::Tracker::ChannelList default_ChannelList
 {
-    { ENKey::NOTE_P1_1, clan::InputCode::keycode_s },
-    { ENKey::NOTE_P1_2, clan::InputCode::keycode_d },
-    { ENKey::NOTE_P1_3, clan::InputCode::keycode_f },
-    { ENKey::NOTE_P1_4, clan::InputCode::keycode_space },
-    { ENKey::NOTE_P1_5, clan::InputCode::keycode_j },
-    { ENKey::NOTE_P1_6, clan::InputCode::keycode_k },
-    { ENKey::NOTE_P1_7, clan::InputCode::keycode_l }
+    { ENKey::NOTE_P1_1, { clan::InputCode::keycode_s } },
+    { ENKey::NOTE_P1_2, { clan::InputCode::keycode_d } },
+    { ENKey::NOTE_P1_3, { clan::InputCode::keycode_f } },
+    { ENKey::NOTE_P1_4, { clan::InputCode::keycode_space } },
+    { ENKey::NOTE_P1_5, { clan::InputCode::keycode_j } },
+    { ENKey::NOTE_P1_6, { clan::InputCode::keycode_k } },
+    { ENKey::NOTE_P1_7, { clan::InputCode::keycode_l } }
 };
 
+static bool verify_replay(std::string const &path);
+
 
 static void autoVisualize(
     AudioManager* am
-    , UI::FFT* FFTbg
-    , UI::FFT* FFTp1
-    , UI::FFT* FFTp2
+    , SpectrumAnalyzer* analyzer
     , UI::Graph_Time*   graph
     , std::vector<UI::Graph*>   graph_m
 ) {
@@ -59,24 +71,33 @@ static void autoVisualize(
                 am->getMasterTrack().getRack().getFilter(3)
             );
 
+    // Maximizer state is only safe to read on the audio thread.
+    am->set_probe([pMaxer] (std::vector<awe::Afloat> &probe) {
+        probe.resize(3);
+        probe[0] = pMaxer->getCurrentGain();
+        probe[1] = pMaxer->getThreshold();
+        probe[2] = pMaxer->getPeakSample();
+    });
+
+    AudioManager::Snapshots &snapshots = am->getSnapshots();
+
     while(am->getRunning().test_and_set())
     {
-        if (am->getMutex().try_lock())
+        if (snapshots.update())
         {
-            ulong new_count = am->getUpdateCount();
-            if (new_count != count)
+            AudioSnapshot const &snapshot = snapshots.front();
+
+            analyzer->analyze(snapshot);
+            graph->set_time(snapshot.count - count);
+
+            if (snapshot.probe.size() == 3)
             {
-                FFTbg->update_2(am->getMasterTrack().getOutput());
-                FFTp1->update_2(am->getTrackMap()->at(1)->getOutput());
-                FFTp2->update_2(am->getTrackMap()->at(2)->getOutput());
-                graph->set_time(new_count - count);
-
-                graph_m[0]->set_next(-awe::dBFS_limit / pMaxer->getCurrentGain());
-                graph_m[1]->set_next(-awe::dBFS_limit * pMaxer->getThreshold());
-                graph_m[2]->set_next(-awe::dBFS_limit * pMaxer->getPeakSample());
-                count = new_count;
+                graph_m[0]->set_next(-awe::dBFS_limit / snapshot.probe[0]);
+                graph_m[1]->set_next(-awe::dBFS_limit * snapshot.probe[1]);
+                graph_m[2]->set_next(-awe::dBFS_limit * snapshot.probe[2]);
             }
-            am->getMutex().unlock();
+
+            count = snapshot.count;
         } else {
             std::this_thread::sleep_for(std::chrono::milliseconds(5));
         }
@@ -103,6 +124,20 @@ int App::main(std::vector<std::string> const& args)
                 &JSONReader::getBoolean, "debug", false
                 );
 
+        // Replays are verified before the window and audio are set up,
+        // as they need neither.
+        for(size_t a = 1; a + 1 < args.size(); a++)
+        {
+            if (args[a] == "--verify")
+            {
+                ChartCache::setDirectory(config.get_or_set(
+                            &JSONReader::getString, "chart.cache-dir", std::string("./Cache")
+                            ));
+
+                return verify_replay(args[a + 1]) ? 0 : 1;
+            }
+        }
+
         sizei resolution = config.get_if_else_set(
                 &JSONReader::getVec2i, "video.resolution", vec2i(640, 480),
                 [] (vec2i const &value) -> bool {
@@ -152,30 +187,40 @@ int App::main(std::vector<std::string> const& args)
                         return false;
                     });
 
-            UI::FFT::IEWindowType FFTwindow
-                = (fftw.compare(    "lanczos") == 0) ? UI::FFT::IEWindowType::LANCZOS
-                : (fftw.compare("rectangular") == 0) ? UI::FFT::IEWindowType::RECTANGULAR
-                : (fftw.compare( "triangular") == 0) ? UI::FFT::IEWindowType::TRIANGULAR
-                                                     : UI::FFT::IEWindowType::HANNING
+            SpectrumAnalyzer::Window FFTwindow
+                = (fftw.compare(    "lanczos") == 0) ? SpectrumAnalyzer::Window::LANCZOS
+                : (fftw.compare("rectangular") == 0) ? SpectrumAnalyzer::Window::RECTANGULAR
+                : (fftw.compare( "triangular") == 0) ? SpectrumAnalyzer::Window::TRIANGULAR
+                                                     : SpectrumAnalyzer::Window::HANNING
                 ;
 
+            uint FFTframes = game->am.getMasterTrack().getConfig().targetFrameCount;
+            uint FFThop    = config.get_if_else_set(
+                    &JSONReader::getInteger, "audio.fft.hop", FFTframes / 2,
+                    [FFTframes](long const & value) -> bool {
+                        return value > 0 && value <= FFTframes;
+                    });
+
+            // Analyzer is shared by every visualizer; it lives as long as the game.
+            SpectrumAnalyzer* analyzer = new SpectrumAnalyzer(FFTframes, FFThop, FFTwindow);
+
             UI::FFT* FFTbg = new UI::FFT(
                     game, game->get_geometry(),
-                    game->am.getMasterTrack().getConfig().targetFrameCount,
+                    *analyzer, analyzer->add_source(SpectrumAnalyzer::kMaster),
                     game->am.getMasterTrack().getConfig().targetSampleRate,
-                    FFTbars, FFTfade, FFTwindow
+                    FFTbars, FFTfade
                     );
             UI::FFT* FFTp1 = new UI::FFT(
                     game, game->get_geometry(),
-                    game->am.getMasterTrack().getConfig().targetFrameCount,
+                    *analyzer, analyzer->add_source(1),
                     game->am.getMasterTrack().getConfig().targetSampleRate,
-                    FFTbars, FFTfade, FFTwindow
+                    FFTbars, FFTfade
                     );
             UI::FFT* FFTp2 = new UI::FFT(
                     game, game->get_geometry(),
-                    game->am.getMasterTrack().getConfig().targetFrameCount,
+                    *analyzer, analyzer->add_source(2),
                     game->am.getMasterTrack().getConfig().targetSampleRate,
-                    FFTbars, FFTfade, FFTwindow
+                    FFTbars, FFTfade
                     );
 
             std::vector<UI::Graph*> graphMG;
@@ -234,18 +279,55 @@ int App::main(std::vector<std::string> const& args)
                             return value > awe::dBFS_limit && value < 3.0;
                         });
 
-                ATPM->getTrack()->getRack().attach_filter(new awe::Filter::Maximizer<2>(
+                std::string MOMMode = config.get_if_else_set(
+                        &JSONReader::getString, "audio.maximizer.mode"        , std::string("lookahead"),
+                        [](std::string const & value) -> bool {
+                            return value == "classic" || value == "lookahead";
+                        });
+
+                awe::Filter::Maximizer<2> *MOM = new awe::Filter::Maximizer<2>(
                         ATPM->getTrack()->getConfig().targetSampleRate / 2,
                         awe::from_dBFS(MOMBoost),
                         awe::from_dBFS(MOMThreshold),
                         MOMSlowRelease,
                         MOMPeakRelease,
                         awe::from_dBFS(MOMCeiling)
-                        ));
+                        );
+
+                if (MOMMode == "lookahead")
+                {
+                    float MOMLookAhead = config.get_if_else_set(
+                            &JSONReader::getDecimal, "audio.maximizer.lookahead"   , 5.0,
+                            [](double const & value) -> bool {
+                                return value > 0.0 && value <= 50.0;
+                            });
+                    float MOMAttack = config.get_if_else_set(
+                            &JSONReader::getDecimal, "audio.maximizer.attack"      , 2.0,
+                            [](double const & value) -> bool {
+                                return value > 0.0;
+                            });
+                    bool MOMTruePeak = config.get_or_set(
+                            &JSONReader::getBoolean, "audio.maximizer.true-peak"   , true);
+
+                    MOM->setLookAhead(
+                            ATPM->getTrack()->getConfig().targetSampleRate,
+                            MOMLookAhead,
+                            MOMAttack,
+                            MOMSlowRelease,
+                            MOMTruePeak
+                            );
+                }
+
+                ATPM->getTrack()->getRack().attach_filter(MOM);
             }
 
+            game->am.configure_racks(
+                    config.get_or_set(&JSONReader::getBoolean, "audio.rack.fused"  , true ),
+                    config.get_or_set(&JSONReader::getBoolean, "audio.rack.profile", false)
+                    );
+
             std::thread* av_thread = new std::thread(
-                    autoVisualize, &game->am, FFTbg, FFTp1, FFTp2, graphAE, graphMG
+                    autoVisualize, &game->am, analyzer, graphAE, graphMG
                     );
             game->am.attach_thread(av_thread);
         }
@@ -256,12 +338,44 @@ int App::main(std::vector<std::string> const& args)
             game->am.getMasterTrack().setConfig(arc);
         }
 
+        // Read keys on a thread of their own, if asked to.
+        std::unique_ptr<InputPoller> poller;
+
+        if (config.get_or_set(&JSONReader::getBoolean, "input.poll-thread", false))
+        {
+            bool keysounds = config.get_or_set(
+                    &JSONReader::getBoolean, "input.poll-keysounds", true
+                    );
+
+            poller.reset(new InputPoller(
+                    game->im, keysounds ? &game->am : nullptr,
+                    config.get_if_else_set(
+                        &JSONReader::getInteger, "input.poll-rate", 1000,
+                        [](long const & value) -> bool { return value >= 100 && value <= 8000; }
+                        )));
+
+            if (poller->start())
+                Note::hitsounds = !keysounds;
+            else
+                poller.reset();
+        }
+
+        // Compiled charts are cached here; an empty path disables the cache.
+        ChartCache::setDirectory(game->conf.get_or_set(
+                    &JSONReader::getString, "chart.cache-dir", std::string("./Cache")
+                    ));
+
         if (args.size() > 1)
         {
             // TODO read other parameters
             for(size_t a = 1; a < args.size(); a++)
             {
-                if (clan::PathHelp::get_extension(args[a]).compare("ojn") == 0)
+                if (args[a] == "--replay" && a + 1 < args.size())
+                {
+                    launchReplay(args[a + 1]);
+                    a += 1;
+                }
+                else if (clan::PathHelp::get_extension(args[a]).compare("ojn") == 0)
                 {
                     Music* music = O2Jam::openOJN(args[a]);
                     launchChart(music->charts[0]);
@@ -273,15 +387,29 @@ int App::main(std::vector<std::string> const& args)
                 }
             }
         } else {
-            MusicList           ML = scan_music_dir("./Music");
-            UI::MusicSelector   MS { game, game->skin, ML };
+            // The library owns the charts; it must outlive the preloader.
+            MusicLibrary ML;
+            ML.scan("./Music");
+
+            ChartPreloader preloader(
+                    game->conf.get_if_else_set(
+                        &JSONReader::getInteger, "gui.preload.cache-size", 2,
+                        [](long const & value) -> bool { return value >= 0 && value <= 16; }
+                        ),
+                    game->conf.get_if_else_set(
+                        &JSONReader::getInteger, "gui.preload.dwell", 500,
+                        [](long const & value) -> bool { return value >= 0; }
+                        ));
+
+            UI::MusicSelector   MS { game, game->skin, ML, preloader };
 
             while(MS.exec() == 0)
             {
                 MS.set_enabled(false);
                 MS.set_visible(false);
 
-                launchChart(MS.get());
+                Chart* chart = MS.get();
+                launchChart(chart, preloader.take(chart), nullptr, &preloader);
 
                 MS.set_enabled(true);
                 MS.set_visible(true);
@@ -298,19 +426,224 @@ int App::main(std::vector<std::string> const& args)
     return 0;
 }
 
-void App::launchChart(Chart* chart)
+/** Prints the scores of a simulation. */
+static void print_scores(Simulation const &sim)
+{
+    printf("[info] PERFECT %u, COOL %u, GOOD %u, BAD %u, MISS %u, MAX COMBO %u\n",
+            sim.getRankCount(PERFECT), sim.getRankCount(COOL), sim.getRankCount(GOOD),
+            sim.getRankCount(BAD), sim.getRankCount(MISS), sim.getMaxCombo());
+}
+
+/** Writes a recorded replay to the replay directory. */
+static void save_replay(Replay const &replay)
+{
+    std::string const directory = App::game->conf.get_or_set(
+            &JSONReader::getString, "player.replay.dir", std::string("./Replays")
+            );
+
+    if (directory.empty() || replay.getEvents().empty())
+        return;
+
+    struct stat st;
+    if (stat(directory.c_str(), &st) != 0)
+    {
+        try {
+            clan::Directory::create(directory, true);
+        } catch (clan::Exception &e) {
+            fprintf(stderr, "[warn] Failed to create replay directory %s.\n", directory.c_str());
+            return;
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%u-%lld.lwr",
+            static_cast<unsigned long long>(replay.getInfo().hash),
+            replay.getInfo().index,
+            static_cast<long long>(time(nullptr)));
+
+    std::string const path = directory + "/" + name;
+    if (replay.save(path))
+        printf("[info] Saved replay to %s.\n", path.c_str());
+}
+
+/**
+ * Opens the chart a replay was recorded on.
+ * @param music set to the music owning the chart, if any; the caller
+ *              deletes it, or else the chart.
+ * @return the chart, or nullptr if it cannot be opened.
+ */
+static Chart* open_replay_chart(Replay const &replay, std::string const &path, Music* &music)
+{
+    Replay::Info const &info = replay.getInfo();
+
+    Chart* chart = nullptr;
+    music = nullptr;
+
+    if (clan::PathHelp::get_extension(info.source).compare("ojn") == 0)
+    {
+        music = O2Jam::openOJN(info.source);
+        if (music != nullptr && music->charts.count(info.index) > 0)
+            chart = music->charts[info.index];
+    } else {
+        chart = new Chart_BMS(info.source);
+    }
+
+    if (chart == nullptr) {
+        fprintf(stderr, "[warn] Cannot open chart %s of replay %s.\n", info.source.c_str(), path.c_str());
+        delete music;
+        music = nullptr;
+        return nullptr;
+    }
+
+    uint64_t hash;
+    if (ChartCache::hash(*chart, hash) == false || hash != info.hash)
+        fprintf(stderr, "[warn] Chart %s has changed since replay %s was recorded.\n", info.source.c_str(), path.c_str());
+
+    return chart;
+}
+
+static void close_replay_chart(Chart* chart, Music* music)
 {
+    if (music != nullptr) {
+        music->clear_charts();
+        delete music;
+    } else {
+        delete chart;
+    }
+}
+
+/**
+ * Recomputes the scores of a replay on a bare simulation, as fast as
+ * possible. Only the notes of the chart are loaded; there is no window,
+ * tracker or audio.
+ * @return false if the replay or its chart cannot be read.
+ */
+static bool verify_replay(std::string const &path)
+{
+    Replay replay;
+    if (replay.load(path) == false)
+        return false;
+
+    Music* music = nullptr;
+    Chart* chart = open_replay_chart(replay, path, music);
+    if (chart == nullptr)
+        return false;
+
+    if (ChartCache::load(*chart) == false)
+    {
+        chart->load_chart();
+        chart->sort_sequence();
+    }
+
+    Replay::Info const &info = replay.getInfo();
+
+    Judge judge = JHard;
+    judge.setBaseTiming(info.judge[0], info.judge[1], info.judge[2], info.judge[3]);
+
+    std::vector<uint8_t> lanes;
+    for(UI::Tracker::Channel const &elem : default_ChannelList)
+        lanes.push_back(static_cast<uint8_t>(elem.key));
+
+    ChartData::Data data;
+    chart->compile(data);
+
+    Simulation sim(judge);
+    sim.setAutoplay(info.autoplay);
+    sim.load(data.view(), lanes);
+
+    auto const begin = std::chrono::steady_clock::now();
+
+    // Every frame judges the key events recorded before it; autoplay
+    // toggles come right after the frame they follow.
+    std::vector<Simulation::Input> inputs;
+    for(Replay::Event const &event : replay.getEvents())
+    {
+        switch(event.type)
+        {
+            case Replay::Type::PRESS:
+            case Replay::Type::RELEASE:
+                if (event.lane < lanes.size())
+                    inputs.push_back(Simulation::Input {
+                            static_cast<int64_t>(event.time), event.lane, event.type == Replay::Type::PRESS
+                            });
+                break;
+
+            case Replay::Type::FRAME:
+                sim.update(static_cast<int64_t>(event.time), inputs);
+                inputs.clear();
+                break;
+
+            case Replay::Type::AUTOPLAY:
+                sim.setAutoplay(!sim.isAutoplay());
+                break;
+        }
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    printf("[info] Verified replay %s in %.3f s.\n", path.c_str(),
+            std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1.0e6);
+    print_scores(sim);
+
+    chart->clear();
+    close_replay_chart(chart, music);
+    return true;
+}
+
+void App::launchReplay(std::string const &path)
+{
+    Replay replay;
+    if (replay.load(path) == false)
+        return;
+
+    Music* music = nullptr;
+    Chart* chart = open_replay_chart(replay, path, music);
     if (chart == nullptr)
         return;
 
-    chart->load_art();
-    chart->load_samples();
+    launchChart(chart, nullptr, &replay);
+    close_replay_chart(chart, music);
+}
+
+void App::launchChart(Chart* chart, ChartLoader* loader, Replay const* replay, ChartPreloader* preloader)
+{
+    if (chart == nullptr) {
+        delete loader;
+        return;
+    }
+
+    // Restart demoted or failed preloads; the new loader waits for them.
+    if (loader == nullptr || loader->isCancelled() || loader->getState() == ChartLoader::State::FAILED)
+    {
+        loader = new ChartLoader(chart, false, loader);
+        loader->start();
+    }
+
+    if (loader->isDone() == false)
+    {
+        UI::LoadScreen screen(game, game->skin, *loader);
+        if (screen.exec() != 0)
+        {
+            // Player backed out. The note chart cannot be cancelled while
+            // it is parsed, so let the preloader free the load later.
+            loader->cancel();
+            if (preloader != nullptr) {
+                preloader->discard(loader);
+                return;
+            }
+        }
+    }
+
+    loader->wait();
+    bool const ready = loader->isDone();
+    delete loader;
+
+    if (ready == false)
+        return;
 
     game->am.wipe_SampleMap(true);
     game->am.swap_SampleMap(chart->getSampleMap());
-
-    chart->load_chart();
-    chart->sort_sequence();
+    chart->clear_samples(); // The samples now belong to the audio manager.
 
     recti chart_area { 50, 50, 450, game->get_height() - 50 };
 
@@ -331,14 +664,61 @@ void App::launchChart(Chart* chart)
         auto chIter = channels.begin();
 
         for (char const & c : input_str) {
-            chIter->code = c;
+            chIter->codes = { c };
+            chIter++;
+        }
+
+        // Second set of keys for the same lanes; a space leaves a lane out.
+        std::string alt_str = game->conf.get_if_else_set(
+                &JSONReader::getString, "player.P1.map-7K-alt", std::string(""),
+                [](std::string const & value) -> bool { return value.empty() || value.size() == 7; }
+                );
+#ifdef _MSC_VER
+        std::transform(alt_str.begin(), alt_str.end(),
+                       alt_str.begin(), ::toupper);
+#else
+        std::transform(alt_str.begin(), alt_str.end(),
+                       alt_str.begin(), ::tolower);
+#endif
+        chIter = channels.begin();
+
+        for (char const & c : alt_str) {
+            if (c != ' ' && c != input_str[chIter - channels.begin()])
+                chIter->codes.push_back(c);
             chIter++;
         }
     }
 
-    UI::Tracker tracker(game, chart_area, JHard, chart, channels);
-    tracker.start();
-    tracker.exec ();
+    Replay record;
+    bool const recording = (replay == nullptr) && game->conf.get_or_set(
+            &JSONReader::getBoolean, "player.replay.record", true
+            );
+
+    {
+        Judge judge = JHard;
+        if (replay != nullptr)
+            judge.setBaseTiming(
+                    replay->getInfo().judge[0], replay->getInfo().judge[1],
+                    replay->getInfo().judge[2], replay->getInfo().judge[3]
+                    );
+
+        UI::Tracker tracker(game, chart_area, judge, chart, channels);
+        tracker.setRecord(recording ? &record : nullptr);
+        tracker.setReplay(replay);
+        tracker.start();
+        tracker.exec ();
+        tracker.stop ();
+
+        print_scores(tracker.getSimulation());
+    }
+
+    if (recording)
+        save_replay(record);
+
+    game->am.print_rack_costs();
+
+    // Drop the played notes; the chart is parsed anew on its next launch.
+    chart->clear();
 }
 
 // kate: indent-mode cstyle; indent-width 4; replace-tabs on;
@@ -5,6 +5,9 @@
 
 class Game;
 class Chart;
+class ChartLoader;
+class ChartPreloader;
+class Replay;
 
 class App
 {
@@ -13,7 +16,18 @@ public:
 
     static int main(std::vector<std::string> const &args);
 
-    static void launchChart(Chart* chart);
+    /**
+     * Loads and plays a chart.
+     * @param loader    a (pre)load of the chart to reuse, which will be
+     *                  deleted by this function; or nullptr to start anew.
+     * @param preloader preloader to hand the load back to if the player
+     *                  backs out, so that it is not waited for here; or
+     *                  nullptr to wait for it.
+     */
+    static void launchChart(Chart* chart, ChartLoader* loader = nullptr, Replay const* replay = nullptr, ChartPreloader* preloader = nullptr);
+
+    //! Plays back a replay file on the chart it was recorded on.
+    static void launchReplay(std::string const &path);
 };
 
 // ClanLib application boot location.
@@ -19,9 +19,14 @@ private:
     unsigned tickCount;   // total number of ticks in this measure
 
 public:
-    Measure (unsigned a, unsigned b): beatCount(a), beatSize(b), tickCount(a*b) {}
-    Measure (double z) { setTimeSignature(z); }
-    ~Measure() { lNotes.clear(); lParams.clear(); }
+    /** Creates a measure; its lists are allocated from `arena` if given. */
+    Measure (unsigned a, unsigned b, Arena* arena = nullptr) :
+        lNotes (NoteList      ::allocator_type(arena)),
+        lParams(ParamEventList::allocator_type(arena)),
+        beatCount(a), beatSize(b), tickCount(a*b) {}
+    Measure (double z, Arena* arena = nullptr) :
+        lNotes (NoteList      ::allocator_type(arena)),
+        lParams(ParamEventList::allocator_type(arena)) { setTimeSignature(z); }
 
     inline void addNote (Note* _note) { lNotes.push_back(_note); }
     inline void addParamEvent (ParamEvent* _param) { lParams.push_back(_param); }
@@ -0,0 +1,260 @@
+//  MusicLibrary.cpp :: Compact music library
+//  Copyright 2014 Keigen Shu
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <ClanLib/core.h>
+#include "MusicLibrary.hpp"
+#include "Chart_O2Jam.hpp"
+#include "Chart_BMS.hpp"
+
+MusicLibrary::MusicLibrary() :
+    mStrings    (),
+    mMusic      (),
+    mCharts     (),
+    mInstances  (),
+    mOrders     (),
+    mInterned   ()
+{
+    clear();
+}
+
+MusicLibrary::~MusicLibrary()
+{
+    clear();
+}
+
+void MusicLibrary::clear()
+{
+    for (Chart* chart : mInstances)
+        delete chart;
+
+    mInstances.clear();
+    mCharts   .clear();
+    mMusic    .clear();
+    mInterned .clear();
+
+    for (auto &order : mOrders)
+        order.clear();
+
+    // Offset 0 is always the empty string.
+    mStrings.assign(1, '\0');
+}
+
+MusicLibrary::StringRef MusicLibrary::intern(std::string const &str)
+{
+    if (str.empty())
+        return 0;
+
+    auto it = mInterned.find(str);
+    if (it != mInterned.end())
+        return it->second;
+
+    StringRef ref = static_cast<StringRef>(mStrings.size());
+    mStrings.insert(mStrings.end(), str.cbegin(), str.cend());
+    mStrings.push_back('\0');
+
+    mInterned.emplace(str, ref);
+    return ref;
+}
+
+void MusicLibrary::scan(std::string const &path)
+{
+    clan::DirectoryScanner clDS;
+    if (clDS.scan(path))
+    {
+        while(clDS.next())
+        {
+            if (clDS.is_directory())
+                scan_BMS_directory(std::string(path) + "/" + clDS.get_name().c_str());
+        }
+    } else {
+        throw clan::Exception("Failed to open directory " + path);
+    }
+
+    if (clDS.scan(path, "*.ojn"))
+    {
+        while(clDS.next())
+        {
+            if (clDS.is_directory() == false)
+                scan_OJN_file(std::string(path) + "/" + clDS.get_name().c_str());
+        }
+    } else {
+        throw clan::Exception("Failed to open directory " + path);
+    }
+
+    mInstances.resize(mCharts.size(), nullptr);
+    mInterned.clear();
+    mInterned.rehash(0);
+    mStrings.shrink_to_fit();
+    mMusic  .shrink_to_fit();
+    mCharts .shrink_to_fit();
+
+    build_orders();
+}
+
+void MusicLibrary::scan_BMS_directory(std::string const &path)
+{
+    clan::DirectoryScanner clDS;
+    MusicRecord music { intern(path), 0, 0, 0, static_cast<uint32_t>(mCharts.size()), 0 };
+
+    if (clDS.scan(path, "*.bms"))
+    {
+        while(clDS.next())
+        {
+            std::string file = std::string(path) + "/" + clDS.get_name().c_str();
+
+            Chart_BMS::Header header;
+            if (Chart_BMS::read_header(file, header) == false)
+                continue;
+
+            music.title  = intern(header.title);
+            music.artist = intern(header.artist);
+            music.genre  = intern(header.genre);
+
+            mCharts.push_back(ChartRecord {
+                    intern(clan::PathHelp::get_fullpath(file)),
+                    music.title, music.artist,
+                    static_cast<float>(header.tempo),
+                    header.notes,
+                    static_cast<uint16_t>(header.level),
+                    0,
+                    static_cast<uint8_t>(header.keys),
+                    Format::BMS
+                    });
+
+            music.charts++;
+        }
+    }
+
+    if (music.charts > 0)
+        mMusic.push_back(music);
+}
+
+void MusicLibrary::scan_OJN_file(std::string const &path)
+{
+    O2Jam::OJN_Header header;
+    if (O2Jam::readOJNHeader(path, header) == false)
+        return;
+
+    StringRef const file    = intern(path);
+    StringRef const charter = intern(std::string(header.Charter, strnlen(header.Charter, sizeof(header.Charter))));
+
+    mMusic.push_back(MusicRecord {
+            file,
+            intern(std::string(header.Title , strnlen(header.Title , sizeof(header.Title )))),
+            intern(std::string(header.Artist, strnlen(header.Artist, sizeof(header.Artist)))),
+            intern(O2Jam::getGenre(header)),
+            static_cast<uint32_t>(mCharts.size()),
+            3
+            });
+
+    mCharts.push_back(ChartRecord { file, intern("EX"), charter, header.Tempo, header.numNotes[0], header.Level[0], 0, 7, Format::OJN });
+    mCharts.push_back(ChartRecord { file, intern("NX"), charter, header.Tempo, header.numNotes[1], header.Level[1], 1, 7, Format::OJN });
+    mCharts.push_back(ChartRecord { file, intern("HX"), charter, header.Tempo, header.numNotes[2], header.Level[2], 2, 7, Format::OJN });
+}
+
+void MusicLibrary::build_orders()
+{
+    auto const by_string = [this] (StringRef MusicRecord::*field, uint32_t lhs, uint32_t rhs) -> int {
+        return strcmp(str(mMusic[lhs].*field), str(mMusic[rhs].*field));
+    };
+
+    auto const sort = [this, &by_string] (Order o, std::function<int(uint32_t, uint32_t)> const &key) {
+        std::vector< uint32_t > &order = mOrders[static_cast<size_t>(o)];
+
+        order.resize(mMusic.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+
+        std::sort(order.begin(), order.end(), [&] (uint32_t lhs, uint32_t rhs) -> bool {
+            int c = key(lhs, rhs);
+            if (c == 0) c = by_string(&MusicRecord::path, lhs, rhs);
+            return c < 0;
+        });
+    };
+
+    // Level of the easiest chart; BMS charts are listed in scan order.
+    std::vector< uint16_t > easiest(mMusic.size());
+    for (uint32_t m = 0; m < mMusic.size(); m++)
+    {
+        MusicRecord const &music = mMusic[m];
+
+        easiest[m] = UINT16_MAX;
+        for (uint32_t c = music.chart; c < music.chart + music.charts; c++)
+            easiest[m] = std::min(easiest[m], mCharts[c].level);
+    }
+
+    auto const level = [&easiest] (uint32_t m) -> int { return easiest[m]; };
+    auto const tempo = [this] (uint32_t m) -> float { return mCharts[mMusic[m].chart].tempo; };
+
+    sort(Order::ARTIST, [&] (uint32_t l, uint32_t r) -> int {
+        int c = by_string(&MusicRecord::artist, l, r);
+        return c != 0 ? c : by_string(&MusicRecord::title, l, r);
+    });
+
+    sort(Order::TITLE , [&] (uint32_t l, uint32_t r) -> int {
+        int c = by_string(&MusicRecord::title, l, r);
+        return c != 0 ? c : by_string(&MusicRecord::artist, l, r);
+    });
+
+    sort(Order::GENRE , [&] (uint32_t l, uint32_t r) -> int {
+        int c = by_string(&MusicRecord::genre, l, r);
+        if (c == 0) c = by_string(&MusicRecord::artist, l, r);
+        return c != 0 ? c : by_string(&MusicRecord::title, l, r);
+    });
+
+    sort(Order::LEVEL , [&] (uint32_t l, uint32_t r) -> int {
+        int c = level(l) - level(r);
+        return c != 0 ? c : by_string(&MusicRecord::title, l, r);
+    });
+
+    sort(Order::TEMPO , [&] (uint32_t l, uint32_t r) -> int {
+        float const d = tempo(l) - tempo(r);
+        return d < 0.0f ? -1 : (d > 0.0f ? 1 : by_string(&MusicRecord::title, l, r));
+    });
+}
+
+Chart* MusicLibrary::getChart(uint32_t chart_index)
+{
+    if (chart_index >= mCharts.size())
+        return nullptr;
+
+    Chart* &chart = mInstances[chart_index];
+    if (chart != nullptr)
+        return chart;
+
+    ChartRecord const &record = mCharts[chart_index];
+
+    try {
+        switch (record.format)
+        {
+            case Format::BMS:
+                chart = new Chart_BMS(str(record.path));
+                break;
+
+            case Format::OJN:
+                {
+                    O2Jam::OJN_Header header;
+                    if (O2Jam::readOJNHeader(str(record.path), header))
+                        chart = new O2Jam::O2JamChart(str(record.path), header, record.index);
+                }
+                break;
+        }
+    } catch (clan::Exception &e) {
+        fprintf(stderr, "[warn] Failed to open chart %s: %s\n", str(record.path), e.what());
+        chart = nullptr;
+    }
+
+    return chart;
+}
+
+Chart* MusicLibrary::getChart(MusicRecord const &music, uint32_t n)
+{
+    if (music.charts == 0)
+        return nullptr;
+
+    return getChart(music.chart + std::min(n, music.charts - 1));
+}
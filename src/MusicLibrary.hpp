@@ -0,0 +1,112 @@
+//  MusicLibrary.hpp :: Compact music library
+//  Copyright 2014 Keigen Shu
+
+#ifndef MUSIC_LIBRARY_H
+#define MUSIC_LIBRARY_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Chart;
+
+/**
+ * Compact music library.
+ *
+ * Music and charts are kept as small records in contiguous arrays, with
+ * their strings interned in a single string pool. Sort orders are built
+ * once after scanning as permutation index arrays, so switching orders
+ * costs nothing. Chart objects are only created when a chart is asked
+ * for, and are owned by the library from then on.
+ */
+class MusicLibrary
+{
+public:
+    enum class Order : uint8_t {
+        ARTIST = 0, //!< By artist, then title
+        TITLE,      //!< By title, then artist
+        GENRE,      //!< By genre, then artist and title
+        LEVEL,      //!< By level of the easiest chart, then title
+        TEMPO,      //!< By starting tempo, then title
+        COUNT
+    };
+
+    enum class Format : uint8_t { BMS, OJN };
+
+    using StringRef = uint32_t; //!< Offset into the string pool
+
+    struct ChartRecord {
+        StringRef   path;       //!< Path to chart file
+        StringRef   name;       //!< Name of chart
+        StringRef   charter;    //!< Name of charter
+        float       tempo;      //!< Starting tempo in BPM
+        uint32_t    notes;      //!< Number of playable notes
+        uint16_t    level;      //!< Difficulty rating
+        uint8_t     index;      //!< Chart index within the file
+        uint8_t     keys;       //!< Number of key lanes
+        Format      format;     //!< Chart file format
+    };
+
+    struct MusicRecord {
+        StringRef   path;       //!< Path to music directory or file
+        StringRef   title;
+        StringRef   artist;
+        StringRef   genre;
+        uint32_t    chart;      //!< Index of first chart record
+        uint32_t    charts;     //!< Number of chart records
+    };
+
+private:
+    std::vector< char >         mStrings;   //!< String pool
+    std::vector< MusicRecord >  mMusic;
+    std::vector< ChartRecord >  mCharts;
+    std::vector< Chart* >       mInstances; //!< Chart objects, created on demand
+
+    std::array< std::vector< uint32_t >, static_cast<size_t>(Order::COUNT) >
+                                mOrders;    //!< Sort permutations of mMusic
+
+    std::unordered_map< std::string, StringRef >
+                                mInterned;  //!< Pool lookup; only kept while scanning
+
+    StringRef intern(std::string const &str);
+
+    void scan_BMS_directory(std::string const &path);
+    void scan_OJN_file     (std::string const &path);
+    void build_orders();
+
+public:
+    MusicLibrary();
+    ~MusicLibrary();
+
+    MusicLibrary(MusicLibrary const &) = delete;
+    MusicLibrary& operator= (MusicLibrary const &) = delete;
+
+    /** Scans a directory for BMS directories and OJN files. */
+    void scan(std::string const &path);
+
+    /** Deletes every record and chart object. */
+    void clear();
+
+    inline size_t size() const { return mMusic.size(); }
+
+    inline char const * str(StringRef ref) const { return mStrings.data() + ref; }
+
+    inline MusicRecord const & music(uint32_t index) const { return mMusic [index]; }
+    inline ChartRecord const & chart(uint32_t index) const { return mCharts[index]; }
+
+    /** Gets the music index array for the given sort order. */
+    inline std::vector< uint32_t > const & order(Order o) const { return mOrders[static_cast<size_t>(o)]; }
+
+    /**
+     * Gets the chart object of a chart record, creating it if needed.
+     * @return the chart, or nullptr if it could not be opened.
+     */
+    Chart* getChart(uint32_t chart_index);
+
+    /** Gets the chart object of the n-th chart of a music record. */
+    Chart* getChart(MusicRecord const &music, uint32_t n);
+};
+
+#endif
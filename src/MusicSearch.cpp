@@ -0,0 +1,440 @@
+//  MusicSearch.cpp :: Music library search and filtering
+//  Copyright 2014 Keigen Shu
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+#include "MusicSearch.hpp"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+static inline uint32_t trigram(char const *s)
+{
+    return (static_cast<uint32_t>(static_cast<uint8_t>(s[0])) << 16)
+         | (static_cast<uint32_t>(static_cast<uint8_t>(s[1])) <<  8)
+         | (static_cast<uint32_t>(static_cast<uint8_t>(s[2]))      );
+}
+
+MusicSearch::MusicSearch(MusicLibrary const &library) :
+    mLibrary    (library),
+    mThread     (nullptr),
+    mMutex      (),
+    mWake       (),
+    mRunning    (true),
+    mGeneration (0),
+    mQuery      (),
+    mOrder      (MusicLibrary::Order::ARTIST),
+    mResult     (),
+    mResultGen  (0),
+    mPolledGen  (0)
+{
+    mThread = new std::thread(&MusicSearch::run, this);
+}
+
+MusicSearch::~MusicSearch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+        mGeneration++; // Cancel the query in progress.
+    }
+    mWake.notify_all();
+
+    mThread->join();
+    delete mThread;
+}
+
+void MusicSearch::submit(std::string const &query, MusicLibrary::Order order)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuery = query;
+        mOrder = order;
+        mGeneration++;
+    }
+    mWake.notify_one();
+}
+
+bool MusicSearch::poll(Result &result)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mResultGen == mPolledGen || mResultGen != mGeneration.load())
+        return false;
+
+    result.swap(mResult);
+    mResult.clear();
+    mPolledGen = mResultGen;
+    return true;
+}
+
+void MusicSearch::run()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+    pthread_setname_np(pthread_self(), "Music Search");
+#endif
+
+    build_index();
+
+    uint32_t done = 0;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWake.wait(lock, [this, done] () { return mRunning == false || mGeneration.load() != done; });
+
+        if (mRunning == false)
+            return;
+
+        uint32_t            const generation = done = mGeneration.load();
+        std::string         const query      = mQuery;
+        MusicLibrary::Order const order      = mOrder;
+
+        lock.unlock();
+
+        Result result;
+        bool const finished = evaluate(parse(query), order, generation, result);
+
+        lock.lock();
+
+        if (finished && generation == mGeneration.load())
+        {
+            mResult.swap(result);
+            mResultGen = generation;
+        }
+    }
+}
+
+////    Index    ///////////////////////////////////////////////////////
+std::string MusicSearch::normalize(std::string const &str)
+{
+    std::string out;
+    out.reserve(str.size());
+
+    for (char c : str)
+    {
+        uint8_t const u = static_cast<uint8_t>(c);
+
+        /****/ if (u >= 'A' && u <= 'Z') {
+            out += static_cast<char>(u - 'A' + 'a');
+        } else if ((u >= 'a' && u <= 'z') || (u >= '0' && u <= '9') || u >= 0x80) {
+            out += c;   // Multi-byte text is matched byte-wise.
+        } else if (out.empty() == false && out.back() != ' ') {
+            out += ' ';
+        }
+    }
+
+    if (out.empty() == false && out.back() == ' ')
+        out.pop_back();
+
+    return out;
+}
+
+void MusicSearch::build_index()
+{
+    uint32_t const M = mLibrary.size();
+
+    // Normalized text
+    mTextOffsets.reserve(M + 1);
+    for (uint32_t m = 0; m < M; m++)
+    {
+        MusicLibrary::MusicRecord const &music = mLibrary.music(m);
+        std::string const text =
+            normalize(mLibrary.str(music.title)) + ' ' +
+            normalize(mLibrary.str(music.artist));
+
+        mTextOffsets.push_back(mText.size());
+        mText.insert(mText.end(), text.cbegin(), text.cend());
+    }
+    mTextOffsets.push_back(mText.size());
+
+    // Trigram table; built by sorting (trigram, music) pairs.
+    std::vector< uint64_t > pairs;
+    pairs.reserve(mText.size());
+
+    for (uint32_t m = 0; m < M; m++)
+    {
+        for (uint32_t i = mTextOffsets[m]; i + 3 <= mTextOffsets[m+1]; i++)
+        {
+            char const *s = mText.data() + i;
+            if (s[0] == ' ' || s[1] == ' ' || s[2] == ' ')
+                continue;
+
+            pairs.push_back((static_cast<uint64_t>(trigram(s)) << 32) | m);
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    mGramPostings.reserve(pairs.size());
+    for (uint64_t pair : pairs)
+    {
+        uint32_t const key = static_cast<uint32_t>(pair >> 32);
+        if (mGramKeys.empty() || mGramKeys.back() != key)
+        {
+            mGramKeys   .push_back(key);
+            mGramOffsets.push_back(mGramPostings.size());
+        }
+
+        mGramPostings.push_back(static_cast<uint32_t>(pair));
+    }
+    mGramOffsets.push_back(mGramPostings.size());
+
+    // Chart attribute columns
+    uint32_t C = 0;
+    for (uint32_t m = 0; m < M; m++)
+        C += mLibrary.music(m).charts;
+
+    mChartMusic.resize(C);
+    for (uint32_t m = 0; m < M; m++)
+    {
+        MusicLibrary::MusicRecord const &music = mLibrary.music(m);
+        for (uint32_t c = 0; c < music.charts; c++)
+            mChartMusic[music.chart + c] = m;
+    }
+
+    auto const build = [this, C] (Column &column, std::function<float(MusicLibrary::ChartRecord const &)> const &value) {
+        std::vector< std::pair<float, uint32_t> > entries(C);
+        for (uint32_t c = 0; c < C; c++)
+            entries[c] = std::make_pair(value(mLibrary.chart(c)), c);
+
+        std::sort(entries.begin(), entries.end());
+
+        column.values.resize(C);
+        column.charts.resize(C);
+        for (uint32_t c = 0; c < C; c++)
+        {
+            column.values[c] = entries[c].first;
+            column.charts[c] = entries[c].second;
+        }
+    };
+
+    build(mLevel, [] (MusicLibrary::ChartRecord const &r) -> float { return r.level; });
+    build(mTempo, [] (MusicLibrary::ChartRecord const &r) -> float { return r.tempo; });
+    build(mNotes, [] (MusicLibrary::ChartRecord const &r) -> float { return r.notes; });
+    build(mKeys , [] (MusicLibrary::ChartRecord const &r) -> float { return r.keys;  });
+}
+
+////    Queries    /////////////////////////////////////////////////////
+bool MusicSearch::parse_range(std::string const &str, Range &range)
+{
+    if (str.empty())
+        return false;
+
+    char *end = nullptr;
+    auto const dash = str.find('-');
+
+    if (dash == std::string::npos) {
+        range.min = range.max = std::strtof(str.c_str(), &end);
+        return *end == '\0';
+    }
+
+    std::string const a = str.substr(0, dash);
+    std::string const b = str.substr(dash + 1);
+
+    if (a.empty() == false) {
+        range.min = std::strtof(a.c_str(), &end);
+        if (*end != '\0') return false;
+    }
+
+    if (b.empty() == false) {
+        range.max = std::strtof(b.c_str(), &end);
+        if (*end != '\0') return false;
+    }
+
+    return true;
+}
+
+MusicSearch::Query MusicSearch::parse(std::string const &query)
+{
+    Query q;
+
+    size_t a = 0;
+    while (a < query.size())
+    {
+        size_t b = query.find(' ', a);
+        if (b == std::string::npos)
+            b = query.size();
+
+        std::string const token = query.substr(a, b - a);
+        a = b + 1;
+
+        if (token.empty())
+            continue;
+
+        auto const colon = token.find(':');
+        if (colon != std::string::npos)
+        {
+            std::string const key = token.substr(0, colon);
+            std::string const val = token.substr(colon + 1);
+
+            // Incomplete filters are ignored until they are complete.
+            /****/ if (key == "lv" ) { parse_range(val, q.level); continue; }
+            else if (key == "bpm") { parse_range(val, q.tempo); continue; }
+            else if (key == "n"  ) { parse_range(val, q.notes); continue; }
+            else if (key == "k"  ) { parse_range(val, q.keys ); continue; }
+            else if (key == "g"  ) { q.genre = normalize(val) ; continue; }
+        }
+
+        // A plain term may normalize into several words.
+        std::string const text = normalize(token);
+        size_t c = 0;
+        while (c < text.size())
+        {
+            size_t d = text.find(' ', c);
+            if (d == std::string::npos)
+                d = text.size();
+
+            q.terms.push_back(text.substr(c, d - c));
+            c = d + 1;
+        }
+    }
+
+    return q;
+}
+
+void MusicSearch::filter_column(Column const &column, Range const &range, std::vector< uint8_t > &mask) const
+{
+    auto const lo = std::lower_bound(column.values.cbegin(), column.values.cend(), range.min);
+    auto const hi = std::upper_bound(lo                     , column.values.cend(), range.max);
+
+    std::vector< uint8_t > hit(mask.size(), 0);
+    for (auto i = lo - column.values.cbegin(); i < hi - column.values.cbegin(); i++)
+        hit[column.charts[i]] = 1;
+
+    for (size_t c = 0; c < mask.size(); c++)
+        mask[c] &= hit[c];
+}
+
+void MusicSearch::filter_text(std::string const &term, std::vector< uint8_t > &mask) const
+{
+    auto const contains = [this, &term] (uint32_t m) -> bool {
+        char const *a = mText.data() + mTextOffsets[m];
+        char const *b = mText.data() + mTextOffsets[m+1];
+        return std::search(a, b, term.cbegin(), term.cend()) != b;
+    };
+
+    if (term.size() < 3)
+    {
+        for (uint32_t m = 0; m < mask.size(); m++)
+            if (mask[m] && contains(m) == false)
+                mask[m] = 0;
+
+        return;
+    }
+
+    // Intersect the postings of every trigram in the term, rarest first.
+    std::vector< std::pair<uint32_t, uint32_t> > lists;
+    for (size_t i = 0; i + 3 <= term.size(); i++)
+    {
+        uint32_t const key = trigram(term.data() + i);
+        auto const it = std::lower_bound(mGramKeys.cbegin(), mGramKeys.cend(), key);
+
+        if (it == mGramKeys.cend() || *it != key) {
+            std::fill(mask.begin(), mask.end(), 0);
+            return;
+        }
+
+        size_t const k = it - mGramKeys.cbegin();
+        lists.push_back(std::make_pair(mGramOffsets[k], mGramOffsets[k+1]));
+    }
+
+    std::sort(lists.begin(), lists.end(), [] (std::pair<uint32_t, uint32_t> const &l, std::pair<uint32_t, uint32_t> const &r) {
+        return (l.second - l.first) < (r.second - r.first);
+    });
+
+    std::vector< uint32_t > candidates (
+            mGramPostings.cbegin() + lists[0].first,
+            mGramPostings.cbegin() + lists[0].second
+            );
+
+    for (size_t l = 1; l < lists.size() && candidates.empty() == false; l++)
+    {
+        std::vector< uint32_t > next;
+        std::set_intersection(
+                candidates.cbegin(), candidates.cend(),
+                mGramPostings.cbegin() + lists[l].first,
+                mGramPostings.cbegin() + lists[l].second,
+                std::back_inserter(next)
+                );
+        candidates.swap(next);
+    }
+
+    // Trigrams only narrow the candidates down; confirm the whole term.
+    std::vector< uint8_t > hit(mask.size(), 0);
+    for (uint32_t m : candidates)
+        if (mask[m] && contains(m))
+            hit[m] = 1;
+
+    mask.swap(hit);
+}
+
+bool MusicSearch::evaluate(Query const &query, MusicLibrary::Order order, uint32_t generation, Result &result) const
+{
+    auto const cancelled = [this, generation] () -> bool { return mGeneration.load() != generation; };
+
+    uint32_t const M = mLibrary.size();
+    std::vector< uint8_t > mask(M, 1);
+
+    // Chart attribute filters
+    if (query.level.bounded() || query.tempo.bounded() || query.notes.bounded() || query.keys.bounded())
+    {
+        std::vector< uint8_t > charts(mChartMusic.size(), 1);
+
+        if (query.level.bounded()) filter_column(mLevel, query.level, charts);
+        if (query.tempo.bounded()) filter_column(mTempo, query.tempo, charts);
+        if (query.notes.bounded()) filter_column(mNotes, query.notes, charts);
+        if (query.keys .bounded()) filter_column(mKeys , query.keys , charts);
+
+        std::fill(mask.begin(), mask.end(), 0);
+        for (size_t c = 0; c < charts.size(); c++)
+            if (charts[c])
+                mask[mChartMusic[c]] = 1;
+    }
+
+    if (cancelled())
+        return false;
+
+    // Genre filter; genre strings are interned, so each is checked once.
+    if (query.genre.empty() == false)
+    {
+        std::unordered_map< MusicLibrary::StringRef, bool > genres;
+
+        for (uint32_t m = 0; m < M; m++)
+        {
+            if (mask[m] == 0)
+                continue;
+
+            MusicLibrary::StringRef const ref = mLibrary.music(m).genre;
+
+            auto it = genres.find(ref);
+            if (it == genres.end())
+                it = genres.emplace(ref, normalize(mLibrary.str(ref)).find(query.genre) != std::string::npos).first;
+
+            mask[m] = it->second;
+        }
+    }
+
+    // Text terms
+    for (std::string const &term : query.terms)
+    {
+        if (cancelled())
+            return false;
+
+        filter_text(term, mask);
+    }
+
+    if (cancelled())
+        return false;
+
+    for (uint32_t m : mLibrary.order(order))
+        if (mask[m])
+            result.push_back(m);
+
+    return true;
+}
@@ -0,0 +1,119 @@
+//  MusicSearch.hpp :: Music library search and filtering
+//  Copyright 2014 Keigen Shu
+
+#ifndef MUSIC_SEARCH_H
+#define MUSIC_SEARCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "MusicLibrary.hpp"
+
+/**
+ * Searches and filters a music library on a background thread.
+ *
+ * The index is built once, on the search thread, from the library:
+ *  - normalized (lower-case alphanumeric) title + artist text per music,
+ *  - a trigram table mapping every 3-character run of that text to the
+ *    sorted list of music containing it,
+ *  - per-chart attribute columns sorted by value (level, tempo, notes and
+ *    key count), so range filters are two binary searches.
+ *
+ * A query is a list of whitespace separated terms. Plain terms must all
+ * appear in the title or artist. Filter terms take the form
+ *
+ *      lv:<range>   Chart level           bpm:<range>  Starting tempo
+ *      n:<range>    Note count            k:<range>    Number of keys
+ *      g:<text>     Genre contains text
+ *
+ * where a range is `a`, `a-b`, `a-` or `-b`. Attribute filters match a
+ * music if any one of its charts satisfies all of them.
+ *
+ * Submitting a query cancels the one being evaluated; the UI polls for
+ * the result of the latest query.
+ */
+class MusicSearch
+{
+public:
+    using Result = std::vector< uint32_t >; //!< Matching music indices, in sort order
+
+private:
+    struct Range {
+        float min = -std::numeric_limits<float>::infinity();
+        float max =  std::numeric_limits<float>::infinity();
+
+        inline bool bounded () const { return min > -std::numeric_limits<float>::infinity() || max < std::numeric_limits<float>::infinity(); }
+        inline bool contains(float v) const { return v >= min && v <= max; }
+    };
+
+    struct Query {
+        std::vector< std::string > terms;
+        std::string genre;
+        Range level, tempo, notes, keys;
+    };
+
+    /** Chart attribute values sorted in ascending order. */
+    struct Column {
+        std::vector< float    > values;
+        std::vector< uint32_t > charts;
+    };
+
+    MusicLibrary const &mLibrary;
+
+    ////    Index    ///////////////////////////////////////////////////
+    std::vector< char     > mText;          //!< Normalized title + artist of every music
+    std::vector< uint32_t > mTextOffsets;   //!< Offset of each music's text; size() + 1 entries
+
+    std::vector< uint32_t > mGramKeys;      //!< Sorted trigram keys
+    std::vector< uint32_t > mGramOffsets;   //!< Offset of each key's postings; keys + 1 entries
+    std::vector< uint32_t > mGramPostings;  //!< Sorted music indices per trigram
+
+    std::vector< uint32_t > mChartMusic;    //!< Music index of every chart
+    Column mLevel, mTempo, mNotes, mKeys;
+
+    ////    Worker state    ////////////////////////////////////////////
+    std::thread            *mThread;
+    std::mutex              mMutex;
+    std::condition_variable mWake;
+    bool                    mRunning;
+
+    std::atomic< uint32_t > mGeneration;    //!< Incremented on every submission
+    std::string             mQuery;         //!< Latest submitted query
+    MusicLibrary::Order     mOrder;         //!< Sort order of latest submission
+
+    Result                  mResult;        //!< Result of the latest finished query
+    uint32_t                mResultGen;     //!< Generation of mResult
+    uint32_t                mPolledGen;     //!< Generation last returned by poll()
+
+    void run();
+    void build_index();
+
+    static std::string normalize(std::string const &str);
+    static bool  parse_range(std::string const &str, Range &range);
+    static Query parse(std::string const &query);
+
+    bool evaluate(Query const &query, MusicLibrary::Order order, uint32_t generation, Result &result) const;
+    void filter_text  (std::string const &term, std::vector< uint8_t > &mask) const;
+    void filter_column(Column const &column, Range const &range, std::vector< uint8_t > &mask) const;
+
+public:
+    MusicSearch(MusicLibrary const &library);
+    ~MusicSearch();
+
+    MusicSearch(MusicSearch const &) = delete;
+    MusicSearch& operator= (MusicSearch const &) = delete;
+
+    /** Submits a query, cancelling the one in progress. */
+    void submit(std::string const &query, MusicLibrary::Order order);
+
+    /**
+     * Gets the result of the latest submitted query if it has finished
+     * and has not been polled yet.
+     * @return true if result has been set.
+     */
+    bool poll(Result &result);
+};
+
+#endif
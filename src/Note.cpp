@@ -1,24 +1,18 @@
 //  Note.h :: Standard Note object definitions
 //  Copyright 2013 Keigen Shu
 
-#include <future>
+#include <algorithm>
+#include <array>
 #include "Note.hpp"
 #include "UI/Tracker.hpp"
-#include "AudioManager.hpp"
 
-AudioManager* Note::am = nullptr;
+bool Note::hitsounds = true;
 
-void Note_Single::init(UI::Tracker const &tracker)
+void Note_Single::render(UI::Tracker const &tracker, clan::Canvas &canvas, Simulation::NoteState const &state) const
 {
-    mScore = JScore();
-    mTick  = tracker.compare_ticks(TTime(), this->getTime());
-}
-
-void Note_Single::render(UI::Tracker const &tracker, clan::Canvas &canvas) const
-{
-    if (this->getScore().rank != EJRank::NONE) return;
+    if (state.isScored()) return;
 
-    rectf p = tracker.getNoteRect(this->getKey(), this->getTick());
+    rectf p = tracker.getNoteRect(this->getKey(), state.begin);
 
     if (p.left > tracker.get_width () || p.right  < 0)
         return;
@@ -58,56 +52,12 @@ void Note_Single::render(UI::Tracker const &tracker, clan::Canvas &canvas) const
     canvas.fill_rect(p, color);
 }
 
-void Note_Single::update(UI::Tracker const &tracker, const KeyStatus &stat)
-{
-    JScore score = tracker.cgetJudge().judge(this->getTick() - tracker.getCurrentTick());
-
-    switch(stat)
-    {
-        case KeyStatus::AUTO:
-            am->play(mSampleID, ENKey_toInteger(getKey()), mVol, mPan);
-            mScore = JScore( AUTO, 0, score.delta );
-            mDead  = true;
-            return;
-        case KeyStatus::ON :
-            am->play(mSampleID, ENKey_isPlayer1(getKey()) ? 1 : 2, mVol, mPan);
-            if (score.rank == EJRank::NONE)
-            {
-                return;
-            } else {
-                mScore = score;
-                mDead  = true;
-                return;
-            }
-
-        case KeyStatus::OFF:
-        case KeyStatus::LOCKED:
-        default:
-            if (score.rank == EJRank::MISS) // Too late to hit.
-            {
-                mScore = score;
-                mDead  = true;
-                return;
-            } else {
-                return;
-            }
-    }
-}
-
-
 ////    Note_Long    //////////////////////////////////////////////////
 
-void Note_Long::init(UI::Tracker const &tracker)
-{
-    mScore = JScore();
-    mBTick = tracker.compare_ticks(TTime(), mBTime);
-    mETick = tracker.compare_ticks(TTime(), mETime);
-}
-
-void Note_Long::render(UI::Tracker const &tracker, clan::Canvas &canvas) const
+void Note_Long::render(UI::Tracker const &tracker, clan::Canvas &canvas, Simulation::NoteState const &state) const
 {
-    recti pb = tracker.getNoteRect(this->getKey(), mBTick);
-    recti pe = tracker.getNoteRect(this->getKey(), mETick);
+    recti pb = tracker.getNoteRect(this->getKey(), state.begin);
+    recti pe = tracker.getNoteRect(this->getKey(), state.end);
 
     // Skip unused
     if (pb.left > tracker.get_width () || pb.right  < 0 ||
@@ -151,17 +101,17 @@ void Note_Long::render(UI::Tracker const &tracker, clan::Canvas &canvas) const
 
     clan::Colorf body, head;
 
-    if (mBScore.rank == EJRank::AUTO) {
+    if (state.bscore.rank == EJRank::AUTO) {
         body = head = clan::Colorf::purple;
         body.a = 0.8f;
-    } else if (mBScore.rank == EJRank::MISS || mEScore.rank == EJRank::MISS) {
+    } else if (state.bscore.rank == EJRank::MISS || state.escore.rank == EJRank::MISS) {
         body = head = clan::Colorf::red;
         body.a = 0.4f;
         head.a = 0.8f;
-    } else if (mBScore.rank == EJRank::NONE) {
+    } else if (state.bscore.rank == EJRank::NONE) {
         body = head = color;
         body.a = 0.8f;
-    } else if (mEScore.rank == EJRank::NONE) {
+    } else if (state.escore.rank == EJRank::NONE) {
         body = head = clan::Colorf::green;
         body.a = 0.8f;
     } else {
@@ -177,161 +127,6 @@ void Note_Long::render(UI::Tracker const &tracker, clan::Canvas &canvas) const
 }
 
 
-void Note_Long::calc_score()
-{
-    mScore.rank  = mEScore.rank;
-    mScore.score = mEScore.score + mBScore.score;
-    mScore.delta = mEScore.delta + mBScore.delta;
-}
-
-
-void Note_Long::update(UI::Tracker const &tracker, KeyStatus const &stat)
-{
-    JScore b_temp = JScore();
-    JScore e_temp = JScore();
-
-    b_temp = tracker.cgetJudge().judge(mBTick - tracker.getCurrentTick());
-    e_temp = tracker.cgetJudge().judge(mETick - tracker.getCurrentTick());
-
-
-    // Remove from key-lock context if score is already set.
-    // But stay alive if not past deletion point.
-    if (mScore.rank != EJRank::NONE) {
-        mDead = (e_temp.rank == EJRank::MISS) ? true : mDead;
-        return;
-    }
-
-    //// WAIT -> Starting point not hit yet. Respond to key status.
-    //// LIVE -> Starting point hit, but end point hasn't. Respond to key status.
-    //// DONE -> Note::score is set, but not dead as we still need to render graphics.
-    //// DEAD -> Note::dead  is set.
-    //// TODO Make this prettier and less redundant.
-    switch(stat)
-    {
-        case KeyStatus::AUTO: // [DONE] Autoplay note.
-            if (mBScore.rank == EJRank::NONE) {
-                am->play(mBSID, ENKey_toInteger(getKey()), mVol, mPan);
-                mBScore = JScore( EJRank::AUTO, 0, b_temp.delta );
-            }
-
-            if (mEScore.rank == EJRank::NONE) {
-                mEScore = JScore( EJRank::AUTO, 0, e_temp.delta );
-            }
-
-            if (e_temp.delta <= 0) {
-                mScore  = JScore( EJRank::AUTO, 0, 0 );
-                mDead = true;
-            }
-
-            return;
-
-        case KeyStatus::LOCKED: // Holding Key
-            if (mEScore.rank == EJRank::NONE) {         // Unscored end
-                if (mBScore.rank != EJRank::NONE
-                &&  mBScore.rank != EJRank::MISS
-                &&  mBScore.rank != EJRank::AUTO) {     // Scored starting point
-                    assert(mScore.rank == NONE && "Note logic leak.");
-                    if (e_temp.rank == MISS) {          // [DONE] Too late to release
-                        mEScore = e_temp;
-                        calc_score();
-                        mDead = true;
-                        return;
-                    } else {                            // [LIVE] Still waiting for end point
-                        return;
-                    }
-                } else if (mBScore.rank == EJRank::MISS
-                        || mBScore.rank == EJRank::AUTO) {      // Missed starting point
-                    mEScore = mBScore;                  // This should not be needed, but someone kept forgetting to set mEScore somewhere.
-                    calc_score();
-                    return;
-                } else {                                        // Unscored starting point
-                    if (b_temp.rank == EJRank::MISS) {  // [DONE] Missed starting point.
-                        mBScore = b_temp;
-                        mEScore = b_temp;
-                        calc_score();
-                        return;
-                    } else {                            // [WAIT] Still have the time to respond.
-                        return;
-                    }
-                }
-                // Key lock belongs to another note... Same effect as being OFF.
-            } else { return; }                                  // [DONE] Scored end
-            break;
-
-        case KeyStatus::OFF : // Have not hit anything OR released key.
-            if (mBScore.rank == EJRank::NONE) {     // Unscored starting point; not active yet.
-                if (b_temp.rank == EJRank::MISS) {  // [DONE] Missed starting point.
-                    mBScore = b_temp;
-                    mEScore = b_temp;
-                    calc_score();
-                    return;
-                } else {                            // [WAIT] Still have the time to respond.
-                    return;
-                }
-            } else if (mBScore.rank == EJRank::MISS
-                    || mBScore.rank == EJRank::AUTO) {      // Starting point was scored MISS or AUTO
-                assert(mBScore.rank == mEScore.rank);       // Starting point and ending points must be equal.
-                if (e_temp.rank == EJRank::MISS) {  // [DEAD] Past target time
-                    mDead = true;
-                    return;
-                } else {                            // [DONE] Not past target time
-                    return;
-                }
-            } else {                                // Starting point was scored.
-                if (mEScore.rank == EJRank::NONE) {         // Ending point hasn't, so the player was holding this.
-                    if (e_temp.rank == EJRank::NONE) {              // [DONE] Release too early
-                        mEScore = JScore( EJRank::MISS, 0, e_temp.delta );
-                        calc_score();
-                        return;
-                    } else {                                        // [DEAD] Release at the right time
-                        mEScore = e_temp;
-                        calc_score();
-                        return;
-                    }
-                } else {                                    // Ending point was scored.
-                    if (e_temp.rank == EJRank::MISS) {              // [DEAD] Past target time
-                        mDead = true;
-                        return;
-                    } else {                                        // [DONE] Not past target time
-                        return;
-                    }
-                }
-            }
-
-        case KeyStatus::ON: // Just hit the key or rehit after miss.
-            if (mBScore.rank == EJRank::NONE) {             // Starting point was not hit
-                am->play(mBSID, ENKey_isPlayer1(getKey()) ? 1 : 2, mVol, mPan);  // Play sound.
-                if (b_temp.rank == EJRank::NONE) {                  // [WAIT] Hit too early
-                    return;
-                } else if (b_temp.rank == EJRank::MISS
-                        || b_temp.rank == EJRank::AUTO) {           // [DONE] Rare case of MISS right when the key is hit.
-                    mBScore = b_temp;
-                    mEScore = b_temp;
-                    calc_score();
-                    return;
-                } else {                                            // [LIVE] Staring point scores!
-                    mBScore = b_temp;
-                    return;                                     // DO NOT CLEAR FROM ACTIVE QUEUE
-                }
-            } else if (mEScore.rank == EJRank::NONE) {      // Starting point was hit, ending point hasn't
-                if (e_temp.rank == EJRank::MISS) {                  // [DEAD] Past target time
-                    mEScore = e_temp;
-                    calc_score();
-                    mDead = true;
-                    return;
-                } else {                                            // [DONE] Not past target time
-                    am->play(mBSID, ENKey_isPlayer1(getKey()) ? 1 : 2, mVol, mPan);             // Play sound.
-                    return;
-                }
-            } else {
-                return;
-            }
-
-        default:
-            return;
-    }
-}
-
 /*! Connects two lists of notes to a list of long notes.
  *
  * This function assumes that all notes being sent into this function
@@ -346,110 +141,125 @@ void Note_Long::update(UI::Tracker const &tracker, KeyStatus const &stat)
  *   they both make sounds.
  * - Deletion of RELEASE notes are allowed because they do not make any sound.
  */
-NoteList zip_key(SingleNoteList H, SingleNoteList R)
+// Pairs the hold and release notes of a single lane, both sorted by time.
+static void zip_lane(
+        Note_Single * const * H, size_t nH,
+        Note_Single * const * R, size_t nR,
+        std::vector<Note*> &out, LongNoteReport &report, Arena &arena
+        )
 {
-    NoteList L;
+    size_t h = 0, r = 0;
 
-    while(!H.empty())
+    while (h < nH)
     {
-        if (R.empty())
-        {
-            clan::Console::write_line("Note [debug] Converting lone HOLD to NORMAL.");
-            L.push_back(*(H.begin()));
-            H.erase(H.begin());
-        } else {
-            SingleNoteList::iterator
-                h = H.begin(), r = R.begin();
-            Note_Single
-                *hn = *h, *rn = *r;
-
-            ////    CHECK AND FIX NOTES    ////////////////////////////
-            // TODO Put note checking logic into a class.
-            bool errTime = hn->getTime()     >  rn->getTime();
-            bool errSmpl = hn->getSampleID() != rn->getSampleID();
-
-            if (hn->getTime() == rn->getTime()) {
-                clan::Console::write_line("Note [debug] Bad long note: Instant RELEASE.");
-                clan::Console::write_line("     [---->] Deleting RELEASE.");
-
-                if (errSmpl)
-                    clan::Console::write_line("     [---->] Note: It has mis-matched samples.");
-
-                R.erase(r); delete rn;
-                continue;
-            }
+        Note_Single *hn = H[h];
 
-            if (errTime)
-            {
-                clan::Console::write_line("Note [debug] Bad long note: Invalid time.");
-                clan::Console::write_line("     [---->] Deleting RELEASE.");
+        if (r == nR)
+        {
+            clan::Console::write_line("Note [debug] Converting lone HOLD at %1:%2:%3 to NORMAL.",
+                    hn->getTime().measure, hn->getTime().beat, hn->getTime().tick);
+            out.push_back(hn);
+            report.lone_holds++;
+            h++;
+            continue;
+        }
 
-                if (errSmpl)
-                    clan::Console::write_line("     [---->] Note: It has mis-matched samples.");
+        Note_Single *rn = R[r];
 
-                // TODO If the note before `r` is a NORMAL note with the same sample ID,
-                //      one may change the type of that NORMAL note to HOLD. But we don't
-                //      have access to any NORMAL notes.
-                R.erase(r); delete rn;
-                continue;
-            }
+        ////    CHECK AND FIX NOTES    ////////////////////////////////
+        // A release at or before its hold is useless; drop it.
+        if (rn->getTime() <= hn->getTime())
+        {
+            clan::Console::write_line("Note [debug] Dropping RELEASE at %1:%2:%3; it does not follow a HOLD.",
+                    rn->getTime().measure, rn->getTime().beat, rn->getTime().tick);
+            report.dropped_releases++;
+            r++;
+            continue;
+        }
 
-            if (errSmpl)
+        if (hn->getSampleID() != rn->getSampleID())
+        {
+            // TODO If the note before `r` is a NORMAL note with the same sample ID,
+            //      one may change the type of that NORMAL note to HOLD. But we don't
+            //      have access to any NORMAL notes.
+            if (h + 1 < nH && H[h+1]->getTime() < rn->getTime())
             {
-                clan::Console::write_line("Note [debug] Bad long note: Sound mismatch.");
-
-                SingleNoteList::iterator t = h;
-                if ((++t) != H.end())
-                {
-                    if ((*t)->getTime() < rn->getTime())
-                    {
-                        clan::Console::write_line("     [---->] Converting HOLD to NORMAL since the next hold note can fit.");
-                        L.push_back(hn);
-                        H.erase(h);
-                        continue;
-                    }
-                }
-
-                clan::Console::write_line("     [---->] Deleting RELEASE.");
-                R.erase(r); delete rn;
+                clan::Console::write_line("Note [debug] Converting HOLD at %1:%2:%3 to NORMAL; the next HOLD matches its RELEASE.",
+                        hn->getTime().measure, hn->getTime().beat, hn->getTime().tick);
+                out.push_back(hn);
+                report.mismatched_holds++;
+                h++;
                 continue;
             }
 
-            L.push_back(new Note_Long(*hn, *rn, hn->getVol(), hn->getPan()));
-            H.erase(h); delete hn;
-            R.erase(r); delete rn;
+            clan::Console::write_line("Note [debug] Dropping RELEASE at %1:%2:%3; its sound does not match its HOLD.",
+                    rn->getTime().measure, rn->getTime().beat, rn->getTime().tick);
+            report.dropped_releases++;
+            r++;
+            continue;
         }
+
+        out.push_back(arena.make<Note_Long>(*hn, *rn, hn->getVol(), hn->getPan()));
+        report.paired++;
+        h++, r++;
     }
 
-    return L;
+    report.dropped_releases += nR - r;
 }
 
-NoteList zip_to_long_notes(SingleNoteList const &HNL, SingleNoteList const &RNL)
+// Groups notes by key with a counting sort, then sorts each lane by time.
+static void split_lanes(
+        std::vector<Note_Single*> const &notes,
+        std::vector<Note_Single*> &lanes, std::array<size_t, 257> &offsets
+        )
 {
-    auto Hmap = split_notes_by_key(HNL);
-    auto Rmap = split_notes_by_key(RNL);
+    offsets.fill(0);
+    for (Note_Single const *n : notes)
+        offsets[static_cast<uint8_t>(n->getKey()) + 1]++;
 
-    std::list<std::future<NoteList>> futures;
+    for (size_t k = 1; k < offsets.size(); k++)
+        offsets[k] += offsets[k-1];
 
-    for(auto node : Hmap)
-        futures.push_back(
-                std::async(
-                    std::launch::async,
-                    zip_key, Hmap[node.first], Rmap[node.first]
-                    )
-                );
-
-    NoteList L;
+    std::array<size_t, 257> fill = offsets;
+    lanes.resize(notes.size());
+    for (Note_Single *n : notes)
+        lanes[fill[static_cast<uint8_t>(n->getKey())]++] = n;
 
-    while(!futures.empty())
+    // Parsers emit lanes mostly in order; only sort what is not.
+    auto const earlier = [] (Note_Single const *a, Note_Single const *b) { return a->getTime() < b->getTime(); };
+    for (size_t k = 0; k < 256; k++)
     {
-        auto it = futures.begin();
-        NoteList l = it->get();
-        L.insert(L.end(), l.begin(), l.end());
-        futures.erase(it);
+        auto const a = lanes.begin() + offsets[k], b = lanes.begin() + offsets[k+1];
+        if (std::is_sorted(a, b, earlier) == false)
+            std::stable_sort(a, b, earlier);
     }
-
-    return L;
 }
 
+LongNoteReport zip_to_long_notes(
+        std::vector<Note_Single*> const &holds,
+        std::vector<Note_Single*> const &releases,
+        std::vector<Note*> &out,
+        Arena &arena
+        )
+{
+    LongNoteReport report { 0, 0, 0, 0 };
 
+    std::vector<Note_Single*> H, R;
+    std::array<size_t, 257>   oH, oR;
+
+    split_lanes(holds   , H, oH);
+    split_lanes(releases, R, oR);
+
+    out.reserve(out.size() + holds.size());
+
+    for (size_t k = 0; k < 256; k++)
+    {
+        zip_lane(
+                H.data() + oH[k], oH[k+1] - oH[k],
+                R.data() + oR[k], oR[k+1] - oR[k],
+                out, report, arena
+                );
+    }
+
+    return report;
+}
@@ -8,14 +8,13 @@
 #include <list>
 #include <map>
 #include <set>
+#include "Arena.hpp"
 #include "Chrono.hpp"
 #include "Judge.hpp"
+#include "Simulation.hpp"
 
 namespace clan { class Canvas;  }
 namespace UI   { class Tracker; }
-class AudioManager;
-
-enum class KeyStatus : uint8_t;
 
 // Note Key enumerator
 enum class ENKey : uint8_t
@@ -79,29 +78,23 @@ private:
     ENKey   mKey;  //! The key of the note.
     TTime   mTime; //! The position of the note in tick-base time.
 
-protected:
-    long    mTick; //! Tick position after chart instantiation.
-    JScore  mScore;//! Note score.
-    bool    mDead; //! Should this note still be updated?
-
 public:
-    static AudioManager *am;
+    static bool hitsounds; //! Do notes play their sound when hit by the player?
 
-    Note(ENKey const &key, TTime const &time) : mKey(key), mTime(time), mTick(-1), mScore(), mDead(false) { }
+    Note(ENKey const &key, TTime const &time) : mKey(key), mTime(time) { }
 
     inline const ENKey  & getKey   () const { return mKey; }
     inline const TTime  & getTime  () const { return mTime; }
-    inline const long   & getTick  () const { return mTick; }
-    inline const JScore & getScore () const { return mScore; }
-    inline       bool      isScored() const { return mScore.rank != EJRank::NONE; }
-    inline const bool   &  isDead  () const { return mDead; }
-
-    virtual void init  (UI::Tracker const &) = 0;
-    virtual void render(UI::Tracker const &, clan::Canvas&) const = 0;
-    virtual void update(UI::Tracker const &, const KeyStatus&) = 0;
+
+    /** Gets the sound played when the note is hit or autoplayed. */
+    virtual void getHitSound(unsigned &sample, float &vol, float &pan) const = 0;
+
+    /** Draws the note at the position and in the judgement state the
+     *  simulation keeps for it. */
+    virtual void render(UI::Tracker const &, clan::Canvas&, Simulation::NoteState const &) const = 0;
 };
 
-typedef std::list<Note*> NoteList;
+typedef std::list< Note*, ArenaAllocator<Note*> > NoteList;
 
 /** Note comparator function (for use with NoteList::sort())
  * This function is used to sort notes by time and key in ascending order.
@@ -119,23 +112,4 @@ inline bool cmpNote_Greater(const Note * const &a, const Note * const &b)
         (a->getTime() < b->getTime());
 }
 
-template<class NoteType>
-    std::map< ENKey, std::list<NoteType*> >
-split_notes_by_key(
-        const std::list< NoteType* >& list
-        )
-{
-    std::map< ENKey, std::list<NoteType*> > map;
-    for(NoteType* note : list)
-        map[note->getKey()].push_back(note);
-
-    for(auto node : map)
-        node.second.sort(
-                [] (const NoteType* const &a, const NoteType* const &b) -> bool
-                { return (a->getTime() < b->getTime()); }
-                );
-
-    return map;
-}
-
 #endif
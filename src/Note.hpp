@@ -6,6 +6,7 @@
 
 #include <stdexcept>
 #include <utility>
+#include <vector>
 #include "Note.hh"
 
 class Note_Single : public Note
@@ -30,9 +31,12 @@ public:
 
     inline unsigned const & getSampleID() const { return mSampleID; }
 
-    void init  (UI::Tracker const &);
-    void render(UI::Tracker const &, clan::Canvas &) const;
-    void update(UI::Tracker const &, KeyStatus const &);
+    inline void getHitSound(unsigned &sample, float &vol, float &pan) const
+    {
+        sample = mSampleID, vol = mVol, pan = mPan;
+    }
+
+    void render(UI::Tracker const &, clan::Canvas &, Simulation::NoteState const &) const;
 };
 
 class Note_Long : public Note
@@ -43,14 +47,9 @@ protected:
     unsigned    mBSID, mESID;
     float       mVol, mPan;
 
-    long        mBTick , mETick;
-    JScore      mBScore, mEScore;
-
 private:
     bool        mHasEndPoint;
 
-    void calc_score();
-
 public:
     Note_Long(
         ENKey key,
@@ -61,8 +60,6 @@ public:
         mBTime (bTime)   , mETime (eTime),
         mBSID  (bSID)    , mESID  (eSID),
         mVol   (vol)     , mPan   (pan),
-        mBTick (0)       , mETick (0),
-        mBScore(JScore()), mEScore(JScore()),
         mHasEndPoint(true)
     { }
 
@@ -75,8 +72,6 @@ public:
         mBTime (time)    , mETime (time),
         mBSID  (sampleID), mESID  (sampleID),
         mVol   (vol)     , mPan   (pan),
-        mBTick (0)       , mETick (0),
-        mBScore(JScore()), mEScore(JScore()),
         mHasEndPoint(false)
     { }
 
@@ -88,8 +83,6 @@ public:
         mBTime (begin.getTime())    , mETime (end.getTime()),
         mBSID  (begin.getSampleID()), mESID  (end.getSampleID()),
         mVol   (vol)     , mPan   (pan),
-        mBTick (0)       , mETick (0),
-        mBScore(JScore()), mEScore(JScore()),
         mHasEndPoint(true)
     { }
 
@@ -99,6 +92,19 @@ public:
     {
         return std::pair<TTime, TTime>(mBTime, mETime);
     }
+    inline std::pair<unsigned,unsigned> getSampleID() const
+    {
+        return std::pair<unsigned, unsigned>(mBSID, mESID);
+    }
+
+    inline float const & getVol() const { return mVol; }
+    inline float const & getPan() const { return mPan; }
+    inline bool   hasEndPoint  () const { return mHasEndPoint; }
+    inline void getHitSound(unsigned &sample, float &vol, float &pan) const
+    {
+        sample = mBSID, vol = mVol, pan = mPan;
+    }
+
     inline bool attach_release(TTime const &time, unsigned const &sampleID)
     {
         if (mHasEndPoint)
@@ -110,16 +116,36 @@ public:
         return true;
     }
 
-    void init  (UI::Tracker const &);
-    void render(UI::Tracker const &, clan::Canvas&) const;
-    void update(UI::Tracker const &, const KeyStatus&);
+    void render(UI::Tracker const &, clan::Canvas&, Simulation::NoteState const &) const;
 };
 
 
 typedef std::list< Note_Single* >   SingleNoteList;
 typedef std::list< Note_Long  * >   LongNoteList;
 
-/** Merge two lists of single notes into a long note list.
-*/
-NoteList zip_to_long_notes(SingleNoteList const &HNL, SingleNoteList const &RNL);
+/** Outcome of pairing hold and release notes into long notes. */
+struct LongNoteReport
+{
+    size_t paired;              //!< Long notes made
+    size_t lone_holds;          //!< Holds without a release, kept as normal notes
+    size_t mismatched_holds;    //!< Holds skipped by a release, kept as normal notes
+    size_t dropped_releases;    //!< Releases without a matching hold, dropped
+};
+
+/** Pairs hold and release notes into long notes, lane by lane.
+ *
+ * Notes are grouped by key and paired in one pass per lane. Paired notes
+ * are replaced by a long note made in `arena`; holds that cannot be paired
+ * are passed on as normal notes and releases that cannot be paired are
+ * dropped. Every resulting note is appended to `out`.
+ *
+ * @note The hold and release notes must have been made in `arena`; those
+ *       replaced or dropped are left for the arena to reclaim.
+ */
+LongNoteReport zip_to_long_notes(
+        std::vector<Note_Single*> const &holds,
+        std::vector<Note_Single*> const &releases,
+        std::vector<Note*> &out,
+        Arena &arena
+        );
 #endif
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <list>
 #include <queue>
+#include "Arena.hpp"
 #include "Chrono.hpp"
 
 enum class EParam : uint16_t
@@ -75,7 +76,7 @@ inline bool cmpParamEvent_Greater(const ParamEvent * const &a, const ParamEvent
     return (a->time == b->time) ? (a->param < b->param) : (a->time < b->time);
 }
 
-typedef std::list <ParamEvent*> ParamEventList;
+typedef std::list <ParamEvent*, ArenaAllocator<ParamEvent*> > ParamEventList;
 typedef std::queue<ParamEvent*> ParamEventQueue;
 
 #endif
@@ -0,0 +1,213 @@
+//  Replay.cpp :: Play session recording
+//  Copyright 2014 Keigen Shu
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Replay.hpp"
+
+static char     const MAGIC[4] = { 'L', 'W', 'R', 'P' };
+static uint32_t const VERSION  = 2;    // 2: key events come before their frame
+
+constexpr uint8_t Replay::kMaxLanes;
+
+namespace {
+
+/** Little-endian writer over a byte vector. */
+class Writer
+{
+private:
+    std::vector<uint8_t> &mData;
+
+public:
+    Writer(std::vector<uint8_t> &data) : mData(data) {}
+
+    void u8 (uint8_t  v) { mData.push_back(v); }
+    void u16(uint16_t v) { for(int i = 0; i < 2; i++) mData.push_back(v >> (i * 8)); }
+    void u32(uint32_t v) { for(int i = 0; i < 4; i++) mData.push_back(v >> (i * 8)); }
+    void u64(uint64_t v) { for(int i = 0; i < 8; i++) mData.push_back(v >> (i * 8)); }
+    void f32(float    v) { uint32_t u; std::memcpy(&u, &v, 4); u32(u); }
+
+    void var(uint64_t v)
+    {
+        while (v >= 0x80) {
+            mData.push_back(static_cast<uint8_t>(v) | 0x80);
+            v >>= 7;
+        }
+        mData.push_back(static_cast<uint8_t>(v));
+    }
+
+    void bytes(void const *data, size_t size)
+    {
+        uint8_t const *p = static_cast<uint8_t const *>(data);
+        mData.insert(mData.end(), p, p + size);
+    }
+};
+
+/** Little-endian reader over a byte vector; fails once it runs out. */
+class Reader
+{
+private:
+    std::vector<uint8_t> const &mData;
+    size_t  mPos;
+    bool    mGood;
+
+    bool take(size_t size)
+    {
+        mGood = mGood && (mData.size() - mPos >= size);
+        return mGood;
+    }
+
+public:
+    Reader(std::vector<uint8_t> const &data) : mData(data), mPos(0), mGood(true) {}
+
+    inline bool good() const { return mGood; }
+
+    uint64_t uint(int size)
+    {
+        uint64_t v = 0;
+        if (take(size))
+            for(int i = 0; i < size; i++)
+                v |= static_cast<uint64_t>(mData[mPos++]) << (i * 8);
+        return v;
+    }
+
+    float f32()
+    {
+        uint32_t u = uint(4);
+        float v;
+        std::memcpy(&v, &u, 4);
+        return v;
+    }
+
+    uint64_t var()
+    {
+        uint64_t v = 0;
+        for(int shift = 0; shift < 64 && take(1); shift += 7)
+        {
+            uint8_t const b = mData[mPos++];
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+                return v;
+        }
+        mGood = false;
+        return 0;
+    }
+
+    bool bytes(void *data, size_t size)
+    {
+        if (take(size)) {
+            std::memcpy(data, mData.data() + mPos, size);
+            mPos += size;
+        }
+        return mGood;
+    }
+};
+
+}
+
+
+Replay::Replay() : mInfo { "", 0, 0, { 0, 0, 0, 0 }, 1.0f, false }, mEvents() {}
+
+bool Replay::save(std::string const &path) const
+{
+    std::vector<uint8_t> data;
+    data.reserve(64 + mInfo.source.size() + mEvents.size() * 3);
+
+    Writer w(data);
+    w.bytes(MAGIC, sizeof(MAGIC));
+    w.u32(VERSION);
+    w.u64(mInfo.hash);
+    w.u32(mInfo.index);
+    for(uint32_t const &j : mInfo.judge)
+        w.u32(j);
+    w.f32(mInfo.speedx);
+    w.u8 (mInfo.autoplay ? 1 : 0);
+    w.u16(mInfo.source.size());
+    w.bytes(mInfo.source.data(), mInfo.source.size());
+
+    w.u32(mEvents.size());
+
+    uint64_t last = 0;
+    for(Event const &e : mEvents)
+    {
+        w.var(e.time - last);
+        w.u8 ((static_cast<uint8_t>(e.type) << 5) | (e.lane & (kMaxLanes - 1)));
+        last = e.time;
+    }
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr) {
+        fprintf(stderr, "[warn] Failed to write replay %s.\n", path.c_str());
+        return false;
+    }
+
+    bool const written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+
+    if (written == false) {
+        fprintf(stderr, "[warn] Failed to write replay %s.\n", path.c_str());
+        std::remove(path.c_str());
+    }
+
+    return written;
+}
+
+bool Replay::load(std::string const &path)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        fprintf(stderr, "[warn] Failed to open replay %s.\n", path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    for(size_t n; (n = fread(chunk, 1, sizeof(chunk), fp)) > 0; )
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(fp);
+
+    Reader r(data);
+
+    char magic[4];
+    if (r.bytes(magic, sizeof(magic)) == false
+            || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+            || r.uint(4) != VERSION)
+    {
+        fprintf(stderr, "[warn] %s is not a replay of this version.\n", path.c_str());
+        return false;
+    }
+
+    Info info;
+    info.hash  = r.uint(8);
+    info.index = r.uint(4);
+    for(uint32_t &j : info.judge)
+        j = r.uint(4);
+    info.speedx   = r.f32();
+    info.autoplay = (r.uint(1) & 1) != 0;
+    info.source.resize(r.uint(2));
+    r.bytes(&info.source[0], info.source.size());
+
+    uint64_t const count = r.uint(4);
+
+    std::vector<Event> events;
+    events.reserve(std::min<uint64_t>(count, data.size()));
+
+    uint64_t time = 0;
+    for(uint64_t i = 0; i < count && r.good(); i++)
+    {
+        time += r.var();
+        uint8_t const b = r.uint(1);
+        events.push_back(Event { time, static_cast<Type>(b >> 5), static_cast<uint8_t>(b & (kMaxLanes - 1)) });
+    }
+
+    if (r.good() == false) {
+        fprintf(stderr, "[warn] Replay %s is truncated.\n", path.c_str());
+        return false;
+    }
+
+    mInfo   = info;
+    mEvents = std::move(events);
+    return true;
+}
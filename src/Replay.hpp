@@ -0,0 +1,93 @@
+//  Replay.hpp :: Play session recording
+//  Copyright 2014 Keigen Shu
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Recording of a play session.
+ *
+ * A replay identifies the chart it was played on, the judge timing and
+ * modifiers it was played with, and holds every frame update and lane
+ * key press the tracker processed, in order and time stamped in
+ * microseconds since the chart started. The key presses a frame judges
+ * come before it, and an autoplay toggle right after the frame it
+ * follows. Playing the frames and presses back through a simulation
+ * reproduces the session's judgement exactly.
+ *
+ * Replays are written as a compact binary file:
+ *
+ *      Header      magic, version, chart source hash and index,
+ *                  judge timing, speed, flags, source path
+ *      Events      event count, then for every event the time since
+ *                  the previous one as a variable-length integer and
+ *                  one byte holding the event type and lane
+ */
+class Replay
+{
+public:
+    enum class Type : uint8_t
+    {
+        FRAME       = 0,    //!< Tracker frame update
+        PRESS       = 1,    //!< Lane key pressed
+        RELEASE     = 2,    //!< Lane key released
+        AUTOPLAY    = 3     //!< Autoplay toggled
+    };
+
+    struct Event
+    {
+        uint64_t    time;   //!< Microseconds since the chart started
+        Type        type;
+        uint8_t     lane;   //!< Tracker channel index; 0 if unused
+    };
+
+    //! Session settings.
+    struct Info
+    {
+        std::string source;     //!< Chart source file path
+        uint32_t    index;      //!< Chart index in the source file
+        uint64_t    hash;       //!< Source file hash, as in the chart cache
+        uint32_t    judge[4];   //!< Judge base timing in milliseconds
+        float       speedx;     //!< Note speed multiplier
+        bool        autoplay;   //!< Autoplay at the start of the chart
+    };
+
+    static constexpr uint8_t kMaxLanes = 32;
+
+private:
+    Info                mInfo;
+    std::vector<Event>  mEvents;
+
+public:
+    Replay();
+
+    inline Info       & getInfo()       { return mInfo; }
+    inline Info const & getInfo() const { return mInfo; }
+
+    inline std::vector<Event> const & getEvents() const { return mEvents; }
+
+    //! Appends an event. Events must come in order of time.
+    inline void push(Type type, uint64_t time, uint8_t lane = 0)
+    {
+        assert(mEvents.empty() || mEvents.back().time <= time);
+        mEvents.push_back(Event { time, type, lane });
+    }
+
+    //! Drops every event.
+    inline void clear() { mEvents.clear(); }
+
+    /** Writes the replay to a file.
+     *  @return false if the file could not be written. */
+    bool save(std::string const &path) const;
+
+    /** Reads a replay from a file.
+     *  @return false if the file could not be read or is not a replay. */
+    bool load(std::string const &path);
+};
+
+#endif
@@ -0,0 +1,504 @@
+//  Simulation.cpp :: Note judgement and scoring core
+//  Copyright 2014 Keigen Shu
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "Simulation.hpp"
+#include "ParamEvent.hpp"
+
+constexpr uint8_t  Simulation::kNoLane;
+constexpr uint32_t Simulation::kNoNote;
+
+Simulation::Simulation(Judge const &judge)
+    : mJudge    (judge)
+    , mNotes    ()
+    , mOrder    ()
+    , mSegments ()
+    , mLanes    ()
+    , mLive     ()
+    , mCursor   (0)
+    , mTime     (0)
+    , mTick     (0)
+    , mAutoPlay (false)
+    , mRanks    ()
+    , mCombo    (0)
+    , mMaxCombo (0)
+    , mListener ()
+{
+    mRanks.fill(0);
+    mJudge.calculateRealTiming();
+}
+
+void Simulation::load(ChartData::View const &chart, std::vector<uint8_t> const &lanes)
+{
+    // Tick at which every measure starts.
+    size_t const measures = chart.measures.size;
+    std::vector<long> start(measures + 1, 0);
+    for(size_t m = 0; m < measures; m++)
+        start[m + 1] = start[m] + chart.measures.data[m].a * chart.measures.data[m].b;
+
+    auto const tick_of = [&] (ChartData::Time const &t) -> long {
+        if (t.measure >= measures)
+            return start[measures];
+        return start[t.measure] + t.beat * chart.measures.data[t.measure].b + t.tick;
+    };
+
+    // Lay out the tempo changes and stops in order of time. Tempo changes
+    // go first on the same tick, so that stops take the new tempo.
+    struct Change { long tick; uint8_t order; double value; };
+    std::vector<Change> changes;
+
+    for(ChartData::TempoRecord const &r : chart.tempo_records)
+        changes.push_back(Change { tick_of(r.time), 0, r.tempo });
+
+    for(ChartData::ParamRecord const &r : chart.param_records)
+    {
+        // The value is the bit pattern of a ParamEvent::Value.
+        int64_t asInt;
+        double  asFloat;
+        std::memcpy(&asInt  , &r.value, sizeof(asInt  ));
+        std::memcpy(&asFloat, &r.value, sizeof(asFloat));
+
+        switch(static_cast<EParam>(r.param))
+        {
+            case EParam::EP_C_STOP_T:
+                changes.push_back(Change { tick_of(r.time), 1, static_cast<double>(asInt) });
+                break;
+            case EParam::EP_C_STOP_R:
+                changes.push_back(Change { tick_of(r.time), 2, asFloat * 1000000.0 });
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::stable_sort(changes.begin(), changes.end(), [] (Change const &a, Change const &b) {
+            return (a.tick == b.tick) ? (a.order < b.order) : (a.tick < b.tick);
+            });
+
+    // A beat is always 48 ticks long (see TClock).
+    mSegments.assign(1, Segment { 0, 0.0, 60000000.0 / 48.0 / 120.0 });
+
+    for(Change const &c : changes)
+    {
+        Segment const &last = mSegments.back();
+        double  const time  = last.start + (c.tick - last.tick) * last.length;
+
+        switch(c.order)
+        {
+            case 0: mSegments.push_back(Segment { c.tick, time, 60000000.0 / 48.0 / c.value }); break;
+            case 1: mSegments.push_back(Segment { c.tick, time + c.value * last.length, last.length }); break;
+            case 2: mSegments.push_back(Segment { c.tick, time + c.value, last.length }); break;
+        }
+    }
+
+    std::array<uint8_t, 256> lane_of;
+    lane_of.fill(kNoLane);
+
+    mLanes.clear();
+    for(uint8_t key : lanes)
+    {
+        if (mLanes.size() < kNoLane && lane_of[key] == kNoLane)
+            lane_of[key] = mLanes.size();
+        mLanes.push_back(Lane { key, KeyStatus::OFF, {}, 0 });
+    }
+
+    mNotes.clear();
+    mNotes.reserve(chart.note_records.size);
+
+    for(ChartData::NoteRecord const &r : chart.note_records)
+    {
+        uint32_t const index = mNotes.size();
+
+        long const begin = tick_of(r.begin);
+        long const end   = tick_of(r.end);
+
+        mNotes.push_back(NoteState {
+                begin, end, time_at(begin), time_at(end),
+                JScore(), JScore(), JScore(),
+                r.key, lane_of[r.key],
+                r.kind != ChartData::NoteRecord::SINGLE,
+                false, false
+                });
+
+        if (lane_of[r.key] != kNoLane)
+            mLanes[lane_of[r.key]].notes.push_back(index);
+    }
+
+    auto const earlier = [this] (uint32_t a, uint32_t b) { return mNotes[a].begin < mNotes[b].begin; };
+
+    mOrder.resize(mNotes.size());
+    for(uint32_t i = 0; i < mOrder.size(); i++)
+        mOrder[i] = i;
+
+    // Records come sorted by measure and time; only sort what is not.
+    if (std::is_sorted(mOrder.begin(), mOrder.end(), earlier) == false)
+        std::stable_sort(mOrder.begin(), mOrder.end(), earlier);
+
+    for(Lane &lane : mLanes)
+        if (std::is_sorted(lane.notes.begin(), lane.notes.end(), earlier) == false)
+            std::stable_sort(lane.notes.begin(), lane.notes.end(), earlier);
+
+    reset();
+}
+
+void Simulation::reset()
+{
+    for(NoteState &n : mNotes)
+    {
+        n.score = n.bscore = n.escore = JScore();
+        n.dead  = false;
+        n.live  = false;
+    }
+
+    mLive.clear();
+    mCursor   = 0;
+    mTime     = 0;
+    mTick     = 0;
+
+    mRanks.fill(0);
+    mCombo    = 0;
+    mMaxCombo = 0;
+
+    for(uint8_t l = 0; l < mLanes.size(); l++)
+    {
+        mLanes[l].status = KeyStatus::OFF;
+        mLanes[l].next   = 0;
+        emit(Outcome::Type::FOCUS, l, getLaneFocus(l));
+    }
+}
+
+int64_t Simulation::time_at(long tick) const
+{
+    // Segment holding the tick; the first one holds every tick before it.
+    auto const it = std::lower_bound(mSegments.begin() + 1, mSegments.end(), tick,
+            [] (Segment const &s, long t) { return s.tick < t; }) - 1;
+
+    return llround(it->start + (tick - it->tick) * it->length);
+}
+
+double Simulation::tick_at(int64_t time) const
+{
+    // Last segment started by the time; the ticks stay put during a stop.
+    auto const it = std::upper_bound(mSegments.begin() + 1, mSegments.end(), time,
+            [] (int64_t t, Segment const &s) { return t < s.start; }) - 1;
+
+    double const tick = it->tick + (time - it->start) / it->length;
+
+    if (it + 1 != mSegments.end())
+        return std::min<double>(tick, (it + 1)->tick);
+
+    return tick;
+}
+
+void Simulation::update(int64_t time, Input const *inputs, size_t count)
+{
+    mTime = time;
+    mTick = std::floor(tick_at(time));
+
+    // Pass notes that came up.
+    while(mCursor < mOrder.size() && mNotes[mOrder[mCursor]].btime <= time)
+        set_live(mOrder[mCursor++]);
+
+    // Play notes automatically, and let scored notes play out.
+    size_t kept = 0;
+    for(size_t k = 0; k < mLive.size(); k++)
+    {
+        uint32_t const i = mLive[k];
+        NoteState &n = mNotes[i];
+
+        if (n.isScored()) {
+            judge(i, KeyStatus::OFF, time);
+        } else if (n.lane == kNoLane || mAutoPlay) {
+            judge(i, KeyStatus::AUTO, time);
+
+            if (n.lane != kNoLane && n.dead)
+                emit(Outcome::Type::AUTO, n.lane, i);
+        }
+
+        if (n.dead)
+            n.live = false;
+        else
+            mLive[kept++] = i;
+    }
+    mLive.resize(kept);
+
+    for(Lane &lane : mLanes)
+        refocus(lane);
+
+    // Judge key changes at the time they happened.
+    for(size_t k = 0; k < count; k++)
+        input(inputs[k]);
+
+    // Judge the lanes at the current time, to catch misses and holds.
+    if (mAutoPlay == false)
+        for(Lane &lane : mLanes)
+            catch_up(lane, time);
+}
+
+void Simulation::input(Input const &in)
+{
+    if (in.lane >= mLanes.size())
+        return;
+
+    Lane &lane = mLanes[in.lane];
+
+    // Score whatever the lane missed before the key changed, so that the
+    // change goes to the note it was meant for however the steps fall.
+    if (mAutoPlay == false)
+        catch_up(lane, in.time);
+
+    if (mAutoPlay == false && lane.next < lane.notes.size())
+    {
+        uint32_t const i = lane.notes[lane.next];
+        judge(i, in.down ? KeyStatus::ON : KeyStatus::OFF, in.time);
+
+        if (mNotes[i].isScored())
+            score(lane);
+    }
+
+    // A press is used up once judged.
+    lane.status = in.down ? KeyStatus::LOCKED : KeyStatus::OFF;
+}
+
+void Simulation::set_live(uint32_t index)
+{
+    NoteState &n = mNotes[index];
+    if (n.live == false && n.dead == false)
+    {
+        n.live = true;
+        mLive.push_back(index);
+    }
+}
+
+void Simulation::score(Lane &lane)
+{
+    uint32_t  const i = lane.notes[lane.next];
+    NoteState const &n = mNotes[i];
+
+    mRanks[n.score.rank] += 1;
+
+    if (n.score.rank != MISS && n.score.rank != BAD) {
+        mCombo   += 1;
+        mMaxCombo = std::max(mCombo, mMaxCombo);
+    } else {
+        mCombo    = 0;
+    }
+
+    emit(Outcome::Type::SCORE, &lane - mLanes.data(), i);
+
+    // Let it play out.
+    set_live(i);
+    refocus(lane);
+}
+
+void Simulation::refocus(Lane &lane)
+{
+    size_t const from = lane.next;
+
+    while(lane.next < lane.notes.size() && mNotes[lane.notes[lane.next]].isScored())
+        lane.next += 1;
+
+    if (lane.next != from) {
+        uint8_t const l = &lane - mLanes.data();
+        emit(Outcome::Type::FOCUS, l, getLaneFocus(l));
+    }
+}
+
+// Judges the focus of a lane by its key status at a time, moving on until
+// the focus is a note that is still open.
+void Simulation::catch_up(Lane &lane, int64_t time)
+{
+    while(lane.next < lane.notes.size())
+    {
+        uint32_t const i = lane.notes[lane.next];
+        judge(i, lane.status, time);
+
+        if (mNotes[i].isScored() == false)
+            return;
+
+        score(lane);
+    }
+}
+
+void Simulation::judge(uint32_t index, KeyStatus status, int64_t time)
+{
+    if (mNotes[index].held)
+        judge_long  (index, status, time);
+    else
+        judge_single(index, status, time);
+}
+
+void Simulation::judge_single(uint32_t index, KeyStatus status, int64_t time)
+{
+    NoteState &n = mNotes[index];
+    JScore score = mJudge.judge(n.btime - time);
+
+    switch(status)
+    {
+        case KeyStatus::AUTO:
+            emit(Outcome::Type::PLAY, n.lane, index);
+            n.score = JScore( AUTO, 0, score.delta );
+            n.dead  = true;
+            return;
+
+        case KeyStatus::ON :
+            emit(Outcome::Type::HIT, n.lane, index);
+            if (score.rank == EJRank::NONE)
+            {
+                return;
+            } else {
+                n.score = score;
+                n.dead  = true;
+                return;
+            }
+
+        case KeyStatus::OFF:
+        case KeyStatus::LOCKED:
+        default:
+            if (score.rank == EJRank::MISS) // Too late to hit.
+            {
+                n.score = score;
+                n.dead  = true;
+                return;
+            } else {
+                return;
+            }
+    }
+}
+
+void Simulation::judge_long(uint32_t index, KeyStatus status, int64_t time)
+{
+    NoteState &n = mNotes[index];
+
+    JScore const b_temp = mJudge.judge(n.btime - time);
+    JScore const e_temp = mJudge.judge(n.etime - time);
+
+    auto const calc_score = [&n] {
+        n.score.rank  = n.escore.rank;
+        n.score.score = n.escore.score + n.bscore.score;
+        n.score.delta = n.escore.delta + n.bscore.delta;
+    };
+
+    // Remove from key-lock context if score is already set.
+    // But stay alive if not past deletion point.
+    if (n.score.rank != EJRank::NONE) {
+        n.dead = (e_temp.rank == EJRank::MISS) ? true : n.dead;
+        return;
+    }
+
+    //// WAIT -> Starting point not hit yet. Respond to key status.
+    //// LIVE -> Starting point hit, but end point hasn't. Respond to key status.
+    //// DONE -> Note score is set, but not dead as we still need to render graphics.
+    //// DEAD -> Note is dead.
+    switch(status)
+    {
+        case KeyStatus::AUTO: // [DONE] Autoplay note.
+            if (n.bscore.rank == EJRank::NONE) {
+                emit(Outcome::Type::PLAY, n.lane, index);
+                n.bscore = JScore( EJRank::AUTO, 0, b_temp.delta );
+            }
+
+            if (n.escore.rank == EJRank::NONE) {
+                n.escore = JScore( EJRank::AUTO, 0, e_temp.delta );
+            }
+
+            if (e_temp.delta <= 0) {
+                n.score = JScore( EJRank::AUTO, 0, 0 );
+                n.dead  = true;
+            }
+
+            return;
+
+        case KeyStatus::LOCKED: // Holding Key
+            if (n.escore.rank == EJRank::NONE) {        // Unscored end
+                if (n.bscore.rank != EJRank::NONE
+                &&  n.bscore.rank != EJRank::MISS
+                &&  n.bscore.rank != EJRank::AUTO) {    // Scored starting point
+                    assert(n.score.rank == NONE && "Note logic leak.");
+                    if (e_temp.rank == MISS) {          // [DONE] Too late to release
+                        n.escore = e_temp;
+                        calc_score();
+                        n.dead = true;
+                    }                                   // [LIVE] Still waiting for end point
+                    return;
+                } else if (n.bscore.rank == EJRank::MISS
+                        || n.bscore.rank == EJRank::AUTO) {     // Missed starting point
+                    n.escore = n.bscore;
+                    calc_score();
+                    return;
+                } else {                                        // Unscored starting point
+                    if (b_temp.rank == EJRank::MISS) {  // [DONE] Missed starting point.
+                        n.bscore = b_temp;
+                        n.escore = b_temp;
+                        calc_score();
+                    }                                   // [WAIT] Still have the time to respond.
+                    return;
+                }
+            }
+            return;                                             // [DONE] Scored end
+
+        case KeyStatus::OFF : // Have not hit anything OR released key.
+            if (n.bscore.rank == EJRank::NONE) {    // Unscored starting point; not active yet.
+                if (b_temp.rank == EJRank::MISS) {  // [DONE] Missed starting point.
+                    n.bscore = b_temp;
+                    n.escore = b_temp;
+                    calc_score();
+                }                                   // [WAIT] Still have the time to respond.
+                return;
+            } else if (n.bscore.rank == EJRank::MISS
+                    || n.bscore.rank == EJRank::AUTO) {     // Starting point was scored MISS or AUTO
+                assert(n.bscore.rank == n.escore.rank);     // Starting point and ending points must be equal.
+                if (e_temp.rank == EJRank::MISS)    // [DEAD] Past target time
+                    n.dead = true;
+                return;                             // [DONE] Not past target time
+            } else {                                // Starting point was scored.
+                if (n.escore.rank == EJRank::NONE) {        // Ending point hasn't, so the player was holding this.
+                    if (e_temp.rank == EJRank::NONE)                // [DONE] Release too early
+                        n.escore = JScore( EJRank::MISS, 0, e_temp.delta );
+                    else                                            // [DEAD] Release at the right time
+                        n.escore = e_temp;
+                    calc_score();
+                    return;
+                } else {                                    // Ending point was scored.
+                    if (e_temp.rank == EJRank::MISS)                // [DEAD] Past target time
+                        n.dead = true;
+                    return;                                         // [DONE] Not past target time
+                }
+            }
+
+        case KeyStatus::ON: // Just hit the key or rehit after miss.
+            if (n.bscore.rank == EJRank::NONE) {            // Starting point was not hit
+                emit(Outcome::Type::HIT, n.lane, index);
+                if (b_temp.rank == EJRank::NONE) {                  // [WAIT] Hit too early
+                    return;
+                } else if (b_temp.rank == EJRank::MISS
+                        || b_temp.rank == EJRank::AUTO) {           // [DONE] Rare case of MISS right when the key is hit.
+                    n.bscore = b_temp;
+                    n.escore = b_temp;
+                    calc_score();
+                    return;
+                } else {                                            // [LIVE] Staring point scores!
+                    n.bscore = b_temp;
+                    return;                                     // DO NOT CLEAR FROM ACTIVE QUEUE
+                }
+            } else if (n.escore.rank == EJRank::NONE) {     // Starting point was hit, ending point hasn't
+                if (e_temp.rank == EJRank::MISS) {                  // [DEAD] Past target time
+                    n.escore = e_temp;
+                    calc_score();
+                    n.dead = true;
+                } else {                                            // [DONE] Not past target time
+                    emit(Outcome::Type::HIT, n.lane, index);
+                }
+                return;
+            } else {
+                return;
+            }
+
+        default:
+            return;
+    }
+}
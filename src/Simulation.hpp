@@ -0,0 +1,202 @@
+//  Simulation.hpp :: Note judgement and scoring core
+//  Copyright 2014 Keigen Shu
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ChartData.hpp"
+#include "Judge.hpp"
+#include "KeyStatus.hpp"
+
+/**
+ * Judges the notes of a chart against a stream of lane key presses and
+ * keeps the score.
+ *
+ * The chart is taken as flat chart records (see ChartData). Every note is
+ * timed once on load, in microseconds from the start of the chart, from
+ * the chart's tempo changes and stops. Every update advances the chart
+ * to a time and judges the key presses and releases that came in since
+ * the last one, each at the time it happened at. The judge windows are
+ * real time, so tempo changes near a note do not move them.
+ *
+ * Every lane plays its notes one after another: the earliest note not
+ * yet scored is the lane's focus, which key presses are judged against.
+ * Notes outside the lanes, and every note while autoplay is on, are
+ * played automatically when their time comes.
+ *
+ * This class has no dependency on the UI or the audio engine; what
+ * happens to notes is reported to an optional listener as outcomes.
+ */
+class Simulation
+{
+public:
+    static constexpr uint8_t  kNoLane = 0xFF;           //!< Lane of notes outside every lane
+    static constexpr uint32_t kNoNote = 0xFFFFFFFF;     //!< Index of no note
+
+    //! Judgement state of a note.
+    struct NoteState
+    {
+        long        begin;      //!< Tick of the note, or the start of a long note
+        long        end;        //!< Tick of the end of a long note; same as begin otherwise
+        int64_t     btime;      //!< Time of begin in microseconds
+        int64_t     etime;      //!< Time of end in microseconds
+        JScore      score;      //!< Note score; NONE until the note is done
+        JScore      bscore;     //!< Score of the start of a long note
+        JScore      escore;     //!< Score of the end of a long note
+        uint8_t     key;        //!< ENKey
+        uint8_t     lane;       //!< Lane index or kNoLane
+        bool        held;       //!< Is this a long note?
+        bool        dead;       //!< Is this note done with for good?
+        bool        live;       //!< Is this note on the live list?
+
+        inline bool isScored() const { return score.rank != EJRank::NONE; }
+    };
+
+    //! Lane key press or release.
+    struct Input
+    {
+        int64_t     time;       //!< Microseconds from the start of the chart
+        uint8_t     lane;
+        bool        down;
+    };
+
+    //! Something that happened to a note.
+    struct Outcome
+    {
+        enum class Type : uint8_t
+        {
+            PLAY,   //!< Autoplay played the note's sound
+            HIT,    //!< The player hit the note's sound
+            FOCUS,  //!< The lane moved on to the note; kNoNote if none is left
+            SCORE,  //!< The player's judgement of the note is final
+            AUTO    //!< Autoplay finished a note in a lane
+        };
+
+        Type        type;
+        uint8_t     lane;
+        uint32_t    note;
+    };
+
+    using Listener   = std::function< void(Outcome const &) >;
+    using RankCounts = std::array< uint32_t, EJRank::AUTO + 1 >;
+
+private:
+    struct Lane
+    {
+        uint8_t                 key;    //!< ENKey of the notes in this lane
+        KeyStatus               status; //!< OFF or LOCKED; presses are judged as they come
+        std::vector<uint32_t>   notes;  //!< Notes in order of time
+        size_t                  next;   //!< Focused note in notes
+    };
+
+    //! Stretch of ticks at one tempo, between tempo changes and stops.
+    struct Segment
+    {
+        long        tick;       //!< Ticks after this one are in the segment
+        double      start;      //!< Time of tick in microseconds, after any stop on it
+        double      length;     //!< Microseconds per tick
+    };
+
+    Judge                   mJudge;
+    std::vector<NoteState>  mNotes;
+    std::vector<uint32_t>   mOrder;     //!< Notes in order of time
+    std::vector<Segment>    mSegments;
+    std::vector<Lane>       mLanes;
+
+    std::vector<uint32_t>   mLive;      //!< Notes passed and not dead, or scored early
+    size_t                  mCursor;    //!< Next note in mOrder to pass
+    int64_t                 mTime;      //!< Current time
+    long                    mTick;      //!< Current tick
+
+    bool                    mAutoPlay;
+    RankCounts              mRanks;
+    uint32_t                mCombo, mMaxCombo;
+
+    Listener                mListener;
+
+    inline void emit(Outcome::Type type, uint8_t lane, uint32_t note)
+    {
+        if (mListener)
+            mListener(Outcome { type, lane, note });
+    }
+
+    void judge_single(uint32_t index, KeyStatus status, int64_t time);
+    void judge_long  (uint32_t index, KeyStatus status, int64_t time);
+    void judge       (uint32_t index, KeyStatus status, int64_t time);
+
+    void set_live    (uint32_t index);
+    void score       (Lane &lane);
+    void refocus     (Lane &lane);
+    void catch_up    (Lane &lane, int64_t time);
+
+    void input       (Input const &input);
+
+public:
+    explicit Simulation(Judge const &judge);
+
+    /**
+     * Lays out the notes of a chart and resets the simulation.
+     *
+     * Notes are indexed in the order of the chart's note records. The
+     * lanes are given as the ENKey of their notes, in lane order.
+     */
+    void load(ChartData::View const &chart, std::vector<uint8_t> const &lanes);
+
+    //! Goes back to the start of the chart, keeping the notes.
+    void reset();
+
+    /**
+     * Advances to a time and judges key presses and releases.
+     *
+     * Notes that came up are played by autoplay if need be, then the
+     * inputs are judged in order, then the focus of every lane is judged
+     * against the lane's key status at the time.
+     *
+     * @param time   microseconds from the start of the chart.
+     * @param inputs key changes since the last update, in order of time;
+     *               they should not be after time.
+     */
+    void update(int64_t time, Input const *inputs = nullptr, size_t count = 0);
+
+    inline void update(int64_t time, std::vector<Input> const &inputs)
+    {
+        update(time, inputs.data(), inputs.size());
+    }
+
+    //! @return the time of a tick, in microseconds from the start of the chart.
+    int64_t time_at(long tick) const;
+    //! @return the tick at a time, with the fraction of the tick passed.
+    double  tick_at(int64_t time) const;
+
+    inline void setListener(Listener const &listener) { mListener = listener; }
+    inline void setAutoplay(bool value) { mAutoPlay = value; }
+    inline bool isAutoplay () const { return mAutoPlay; }
+
+    inline Judge const & getJudge() const { return mJudge; }
+    inline int64_t       getTime () const { return mTime; }
+    inline long          getTick () const { return mTick; }
+
+    inline size_t            getNoteCount() const { return mNotes.size(); }
+    inline NoteState const & getNote(uint32_t index) const { return mNotes[index]; }
+
+    inline size_t    getLaneCount() const { return mLanes.size(); }
+    inline KeyStatus getLaneStatus(uint8_t lane) const { return mLanes[lane].status; }
+    //! @return the focused note of a lane, or kNoNote.
+    inline uint32_t  getLaneFocus (uint8_t lane) const
+    {
+        Lane const &l = mLanes[lane];
+        return (l.next < l.notes.size()) ? l.notes[l.next] : kNoNote;
+    }
+
+    inline RankCounts const & getRankCounts() const { return mRanks; }
+    inline uint32_t getRankCount(EJRank rank) const { return mRanks[rank]; }
+    inline uint32_t getCombo   () const { return mCombo; }
+    inline uint32_t getMaxCombo() const { return mMaxCombo; }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "SpectrumAnalyzer.hpp"
+
+inline constexpr double _sinc(double const &x) { return sin(M_PI * x) / (M_PI * x); }
+static constexpr double _lanczos_size = 3.0f;
+inline constexpr double _lanczos_sinc(double const &x)
+{
+    return
+        (x == 0.0)          ? 1.0 : (
+        (x > _lanczos_size) ? 0.0 : (
+            _sinc(x) * _sinc(x / _lanczos_size)
+        )
+        );
+}
+
+constexpr int SpectrumAnalyzer::kMaster;
+
+std::vector<float> SpectrumAnalyzer::generate_window(SpectrumAnalyzer::Window const &type, ulong const &size)
+{
+    std::vector<float> window(size);
+
+    switch (type)
+    {
+        case SpectrumAnalyzer::Window::LANCZOS:
+            for(ulong t = 0; t < size; ++t)
+                window[t] = _lanczos_sinc(static_cast<double>(2 * t) / static_cast<double>(size - 1) - 1.0f);
+            break;
+
+        case SpectrumAnalyzer::Window::HANNING:
+            for(ulong t = 0; t < size; ++t)
+                window[t] = 0.5 * (1.0 - cos( 2.0 * M_PI * static_cast<double>(t) / static_cast<double>(size - 1)));
+            break;
+
+        case SpectrumAnalyzer::Window::RECTANGULAR:
+            for(ulong t = 0; t < size; ++t)
+                window[t] = 1.0f;
+            break;
+
+        case SpectrumAnalyzer::Window::TRIANGULAR:
+            for(ulong t = 0; t < size / 2; ++t)
+                window[t           ] =       static_cast<double>(2 * t) / static_cast<double>(size - 1),
+                window[t + size / 2] = 1.0 - static_cast<double>(2 * t) / static_cast<double>(size - 1);
+            break;
+
+    }
+
+    return window;
+}
+
+
+SpectrumAnalyzer::Source::Source(int _track, size_t frames)
+    : track (_track)
+    , ring  (2, frames)
+    , quiet (frames)
+    , peak  (frames, 0.0f)
+    , seq   (0)
+    , hops  (0)
+    , bins  (new std::atomic<float>[frames])
+{
+    for(size_t i = 0; i < frames; i += 1)
+        bins[i].store(0.0f, std::memory_order_relaxed);
+}
+
+
+SpectrumAnalyzer::SpectrumAnalyzer(size_t frames, size_t hop, Window window)
+    : mFrames   (frames - (frames % 2))
+    , mHop      ((hop > 0 && hop <= mFrames) ? hop : mFrames / 2)
+    , mPos      (0)
+    , mSince    (0)
+    , mWindow   (generate_window(window, mFrames))
+    , mSources  ()
+    , kC        (kiss_fftr_alloc(mFrames, 0, NULL, NULL))
+    , kI        (mFrames)
+    , kO        (mFrames / 2 + 1)
+{
+    // Fold the window gain into the window, so that a full-scale sine
+    // gives a bin power of 1.
+    float sum = 0.0f;
+    for(float const &w : mWindow)
+        sum += w;
+
+    if (sum > 0.0f)
+        for(float &w : mWindow)
+            w *= 2.0f / sum;
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    kiss_fftr_free(kC);
+}
+
+size_t SpectrumAnalyzer::add_source(int track)
+{
+    mSources.emplace_back(new Source(track, mFrames));
+    return mSources.size() - 1;
+}
+
+
+void SpectrumAnalyzer::transform(Source &source)
+{
+    float const * ring = source.ring.cdata();
+
+    for(uchar c = 0; c < 2; c += 1)
+    {
+        // Unroll the ring so the oldest frame comes first.
+        size_t const head = mFrames - mPos;
+        for(size_t t = 0; t < head; t += 1)
+            kI[t] = ring[(mPos + t) * 2 + c] * mWindow[t];
+        for(size_t t = head; t < mFrames; t += 1)
+            kI[t] = ring[(t - head) * 2 + c] * mWindow[t];
+
+        kiss_fftr(kC, kI.data(), kO.data());
+
+        for(size_t b = 0; b < mFrames / 2; b += 1)
+        {
+            float const p = kO[b].r * kO[b].r + kO[b].i * kO[b].i;
+            float &peak = source.peak[b * 2 + c];
+            peak = (p > peak) ? p : peak;
+        }
+    }
+}
+
+void SpectrumAnalyzer::publish(Source &source, ulong hops)
+{
+    ulong const seq = source.seq.load(std::memory_order_relaxed);
+
+    source.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for(size_t i = 0; i < mFrames; i += 1)
+        source.bins[i].store(source.peak[i], std::memory_order_relaxed);
+    source.hops.fetch_add(hops, std::memory_order_relaxed);
+
+    source.seq.store(seq + 2, std::memory_order_release);
+
+    std::fill(source.peak.begin(), source.peak.end(), 0.0f);
+}
+
+void SpectrumAnalyzer::analyze(AudioSnapshot const &snapshot)
+{
+    size_t const frames = snapshot.master.getFrameCount();
+    ulong        taken  = 0;
+
+    for(size_t i = 0; i < frames; )
+    {
+        size_t const n = std::min(frames - i, mHop - mSince);
+
+        for(auto &source : mSources)
+        {
+            awe::AfBuffer const * buffer
+                = (source->track == kMaster)                      ? &snapshot.master
+                : (static_cast<size_t>(source->track) < snapshot.tracks.size())
+                                                                  ? &snapshot.tracks[source->track]
+                                                                  : nullptr;
+
+            float const * in  = (buffer != nullptr) ? buffer->cdata() + i * 2 : nullptr;
+            float       * out = source->ring.data();
+
+            bool silent = true;
+            for(size_t f = 0, p = mPos; f < n; f += 1, p = (p + 1 == mFrames) ? 0 : p + 1)
+            {
+                float const l = (in != nullptr) ? in[f * 2    ] : 0.0f;
+                float const r = (in != nullptr) ? in[f * 2 + 1] : 0.0f;
+
+                out[p * 2    ] = l;
+                out[p * 2 + 1] = r;
+
+                silent = silent && (l == 0.0f) && (r == 0.0f);
+            }
+
+            source->quiet = silent ? std::min(source->quiet + n, mFrames) : 0;
+        }
+
+        mPos   = (mPos + n) % mFrames;
+        mSince = mSince + n;
+        i      = i + n;
+
+        if (mSince == mHop)
+        {
+            mSince = 0;
+            taken += 1;
+
+            // A window of silence has no spectrum to take.
+            for(auto &source : mSources)
+                if (source->quiet < mFrames)
+                    transform(*source);
+        }
+    }
+
+    if (taken > 0)
+        for(auto &source : mSources)
+            publish(*source, taken);
+}
+
+ulong SpectrumAnalyzer::read(size_t index, awe::AfBuffer &bins) const
+{
+    Source const &source = *mSources.at(index);
+
+    if (bins.getSampleCount() != mFrames)
+        bins = awe::AfBuffer(2, mFrames / 2);
+
+    for(;;)
+    {
+        ulong const seq = source.seq.load(std::memory_order_acquire);
+        if (seq % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for(size_t i = 0; i < mFrames; i += 1)
+            bins.data()[i] = source.bins[i].load(std::memory_order_relaxed);
+        ulong const hops = source.hops.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (source.seq.load(std::memory_order_relaxed) == seq)
+            return hops;
+    }
+}
@@ -0,0 +1,111 @@
+//  SpectrumAnalyzer.hpp :: Shared audio spectrum analysis service
+//  Copyright 2014 Keigen Shu
+
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "kiss_fft130/kiss_fftr.h"
+
+#include "AudioManager.hpp"
+
+/**
+ * Computes the power spectra of the mixer output for visualizers.
+ *
+ * Every analyzed source (the master track or a track) keeps a sliding
+ * window of its latest output in a ring buffer. A new FFT is taken each
+ * time a hop's worth of frames has come in, so the windows overlap and
+ * every frame is transformed a fixed number of times no matter how many
+ * visualizers show the source.
+ *
+ * The analysis runs on whichever thread feeds snapshots to \ref analyze.
+ * Results are published per source behind a sequence lock; any number of
+ * renderers may \ref read them without blocking the analysis.
+ */
+class SpectrumAnalyzer
+{
+public:
+    enum class Window : uint8_t
+    {
+        HANNING     = 'H',
+        LANCZOS     = 'L',
+        RECTANGULAR = 'R',
+        TRIANGULAR  = 'T'
+    };
+
+    static std::vector<float> generate_window(Window const &window, ulong const &size);
+
+    static constexpr int kMaster = -1; //!< Source ID of the master track.
+
+private:
+    struct Source
+    {
+        int                 track;  //!< Track to analyze, or kMaster
+        awe::AfBuffer       ring;   //!< Last window of frames
+        size_t              quiet;  //!< Consecutive silent frames in ring
+        std::vector<float>  peak;   //!< Bin powers taken since last publish
+
+        std::atomic<ulong>  seq;    //!< Sequence lock; odd while writing
+        std::atomic<ulong>  hops;   //!< Number of FFTs published so far
+        std::unique_ptr< std::atomic<float>[] > bins;
+
+        Source(int track, size_t frames);
+    };
+
+    size_t  mFrames;    //!< FFT window size
+    size_t  mHop;       //!< Frames between FFTs
+    size_t  mPos;       //!< Ring write position, shared by every source
+    size_t  mSince;     //!< Frames since the last FFT
+
+    std::vector<float>  mWindow;    //!< Window function, scaled for magnitude
+    std::vector< std::unique_ptr<Source> > mSources;
+
+    kiss_fftr_cfg       kC;
+    std::vector<kiss_fft_scalar>    kI;
+    std::vector<kiss_fft_cpx>       kO;
+
+    void transform(Source &source);
+    void publish  (Source &source, ulong hops);
+
+public:
+    /**
+     * @param frames number of frames in every FFT window.
+     * @param hop    number of frames between FFTs; 0 for half a window.
+     */
+    SpectrumAnalyzer(size_t frames, size_t hop = 0, Window window = Window::HANNING);
+    ~SpectrumAnalyzer();
+
+    SpectrumAnalyzer(SpectrumAnalyzer const &) = delete;
+    SpectrumAnalyzer& operator=(SpectrumAnalyzer const &) = delete;
+
+    /**
+     * Adds a source to analyze. Must be called before the first snapshot.
+     * @param track track ID in AudioSnapshot::tracks, or kMaster.
+     * @return source index to read the spectrum with.
+     */
+    size_t add_source(int track);
+
+    //! Feeds a mixer snapshot to every source. Analysis thread only.
+    void analyze(AudioSnapshot const &snapshot);
+
+    /**
+     * Copies the latest spectrum of a source. Safe from any thread.
+     *
+     * The spectrum has half a window of frequency bins as interleaved
+     * left-right powers, with the window gain compensated for. If more
+     * than one FFT was taken since the last publish, the peak of each bin
+     * is given.
+     *
+     * @return number of FFTs taken on the source up to this spectrum.
+     */
+    ulong read(size_t source, awe::AfBuffer &bins) const;
+
+    inline size_t getWindowSize () const { return mFrames; }
+    inline size_t getHopSize    () const { return mHop; }
+    inline size_t getBinCount   () const { return mFrames / 2; }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "CoverArtCache.hpp"
+#include "../Chart_BMS.hpp"
+#include "../Chart_O2Jam.hpp"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+namespace UI {
+
+CoverArtCache::CoverArtCache(vec2i const &thumb_size, size_t budget_bytes, size_t workers, int upload_limit)
+    : mWorkers      ()
+    , mMutex        ()
+    , mWake         ()
+    , mRunning      (true)
+    , mQueue        ()
+    , mInFlight     ()
+    , mDecoded      ()
+    , mDecodedIndex ()
+    , mDecodedBytes (0)
+    , mEntries      ()
+    , mIndex        ()
+    , mBytes        (0)
+    , mBudget       (budget_bytes)
+    , mThumbSize    (thumb_size.x, thumb_size.y)
+    , mUploadLimit  (upload_limit)
+    , mUploads      (0)
+{
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++)
+        mWorkers.push_back(new std::thread(&CoverArtCache::work, this));
+}
+
+CoverArtCache::~CoverArtCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+        mQueue.clear();
+    }
+    mWake.notify_all();
+
+    for (std::thread* worker : mWorkers)
+    {
+        worker->join();
+        delete worker;
+    }
+}
+
+void CoverArtCache::work()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+    pthread_setname_np(pthread_self(), "Art Decoder");
+#endif
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+        mWake.wait(lock, [this] () { return mRunning == false || mQueue.empty() == false; });
+
+        if (mRunning == false)
+            return;
+
+        Job job = mQueue.front();
+        mQueue.pop_front();
+
+        lock.unlock();
+
+        clan::PixelBuffer art;
+        try {
+            art = downscale(read_art(job));
+        } catch (clan::Exception &e) {
+            clan::Console::write_line("Failed to decode cover art for %1.", job.key);
+        } catch (std::exception &e) {
+            // i.e. bad_alloc on a corrupt art size; never let it end the thread.
+            clan::Console::write_line("Failed to read cover art for %1: %2", job.key, e.what());
+        }
+
+        lock.lock();
+
+        mInFlight.erase(job.key);
+        if (art.is_null() == false)
+        {
+            Decoded decoded {
+                job.key, art,
+                static_cast<size_t>(art.get_width() * art.get_height() * 4)
+            };
+
+            mDecoded.push_front(decoded);
+            mDecodedIndex[job.key] = mDecoded.begin();
+            mDecodedBytes += decoded.bytes;
+
+            // Drop least recently requested thumbnails while textures and
+            // thumbnails together are over budget.
+            while (mBytes + mDecodedBytes > mBudget && mDecoded.size() > 1)
+            {
+                Decoded const &last = mDecoded.back();
+                mDecodedBytes -= last.bytes;
+                mDecodedIndex.erase(last.key);
+                mDecoded.pop_back();
+            }
+        }
+    }
+}
+
+clan::PixelBuffer CoverArtCache::read_art(Job const &job) const
+{
+    switch (job.format)
+    {
+        case MusicLibrary::Format::BMS: return Chart_BMS::read_art(job.path);
+        case MusicLibrary::Format::OJN: return O2Jam::readOJNCover(job.path);
+    }
+
+    return clan::PixelBuffer();
+}
+
+// Box-filters the art down to fit within the thumbnail size.
+clan::PixelBuffer CoverArtCache::downscale(clan::PixelBuffer const &art) const
+{
+    if (art.is_null())
+        return art;
+
+    clan::PixelBuffer src = art.to_format(clan::tf_rgba8);
+
+    int const sw = src.get_width ();
+    int const sh = src.get_height();
+
+    float const scale = std::min(
+            static_cast<float>(mThumbSize.width ) / static_cast<float>(sw),
+            static_cast<float>(mThumbSize.height) / static_cast<float>(sh)
+            );
+
+    if (scale >= 1.0f)
+        return src;
+
+    int const dw = std::max(1, static_cast<int>(sw * scale));
+    int const dh = std::max(1, static_cast<int>(sh * scale));
+
+    clan::PixelBuffer dst(dw, dh, clan::tf_rgba8);
+
+    uint8_t const * sp = static_cast<uint8_t const *>(src.get_data());
+    uint8_t       * dp = static_cast<uint8_t       *>(dst.get_data());
+
+    int const spitch = src.get_pitch();
+    int const dpitch = dst.get_pitch();
+
+    for (int y = 0; y < dh; y++)
+    {
+        int const y0 =  y      * sh / dh;
+        int const y1 = std::max(y0 + 1, (y + 1) * sh / dh);
+
+        for (int x = 0; x < dw; x++)
+        {
+            int const x0 =  x      * sw / dw;
+            int const x1 = std::max(x0 + 1, (x + 1) * sw / dw);
+
+            uint32_t sum[4] = { 0, 0, 0, 0 };
+
+            for (int v = y0; v < y1; v++)
+            {
+                uint8_t const * p = sp + v * spitch + x0 * 4;
+                for (int u = x0; u < x1; u++, p += 4)
+                {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                    sum[3] += p[3];
+                }
+            }
+
+            uint32_t const n = (y1 - y0) * (x1 - x0);
+            uint8_t * q = dp + y * dpitch + x * 4;
+
+            q[0] = sum[0] / n;
+            q[1] = sum[1] / n;
+            q[2] = sum[2] / n;
+            q[3] = sum[3] / n;
+        }
+    }
+
+    return dst;
+}
+
+void CoverArtCache::request(std::string const &key, std::string const &path, MusicLibrary::Format format, bool urgent)
+{
+    if (path.empty())
+        return;
+
+    // Already uploaded? Touch it.
+    auto i = mIndex.find(key);
+    if (i != mIndex.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, i->second);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Already decoded? Touch it.
+        auto d = mDecodedIndex.find(key);
+        if (d != mDecodedIndex.end()) {
+            mDecoded.splice(mDecoded.begin(), mDecoded, d->second);
+            return;
+        }
+
+        auto f = mInFlight.find(key);
+        if (f != mInFlight.end())
+        {
+            // Move queued urgent requests to the front.
+            if (urgent)
+            {
+                for (auto it = mQueue.begin(); it != mQueue.end(); it++)
+                {
+                    if (it->key == key) {
+                        Job job = *it;
+                        mQueue.erase(it);
+                        mQueue.push_front(job);
+                        break;
+                    }
+                }
+            }
+            return;
+        }
+
+        mInFlight[key] = true;
+
+        if (urgent)
+            mQueue.push_front(Job { key, path, format });
+        else
+            mQueue.push_back (Job { key, path, format });
+    }
+
+    mWake.notify_one();
+}
+
+void CoverArtCache::cancel_pending()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (Job const &job : mQueue)
+        mInFlight.erase(job.key);
+
+    mQueue.clear();
+}
+
+clan::Image CoverArtCache::get(clan::Canvas &canvas, std::string const &key)
+{
+    auto i = mIndex.find(key);
+    if (i != mIndex.end())
+        return i->second->image;
+
+    if (mUploads >= mUploadLimit)
+        return clan::Image();
+
+    clan::PixelBuffer art;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto d = mDecodedIndex.find(key);
+        if (d == mDecodedIndex.end())
+            return clan::Image();
+
+        art = d->second->art;
+        mDecodedBytes -= d->second->bytes;
+        mDecoded.erase(d->second);
+        mDecodedIndex.erase(d);
+    }
+
+    mUploads += 1;
+
+    Entry entry {
+        key,
+        clan::Image(canvas, art, recti(0, 0, art.get_width(), art.get_height())),
+        static_cast<size_t>(art.get_width() * art.get_height() * 4)
+    };
+
+    mEntries.push_front(entry);
+    mIndex[key] = mEntries.begin();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBytes += entry.bytes;
+
+        // Evict least recently used textures over budget, counting thumbnails
+        // still waiting to be uploaded; keep the new one.
+        while (mBytes + mDecodedBytes > mBudget && mEntries.size() > 1)
+        {
+            Entry const &last = mEntries.back();
+            mBytes -= last.bytes;
+            mIndex.erase(last.key);
+            mEntries.pop_back();
+        }
+    }
+
+    return mEntries.front().image;
+}
+
+}
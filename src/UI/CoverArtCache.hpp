@@ -0,0 +1,122 @@
+//  UI/CoverArtCache.hpp :: Background cover art decoder and texture cache
+//  Copyright 2014 Keigen Shu
+
+#ifndef UI_COVER_ART_CACHE_H
+#define UI_COVER_ART_CACHE_H
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../__zzCore.hpp"
+#include "../MusicLibrary.hpp"
+
+namespace UI {
+
+/**
+ * Decodes cover art on a pool of worker threads and keeps the resulting
+ * images in a least-recently-used texture cache.
+ *
+ * Art is requested by key (the music's path) and read straight from the
+ * chart file, without creating a Chart, into a thumbnail no larger than
+ * the given size. Decoded thumbnails are uploaded to the
+ * GPU by get() on the UI thread, a few per frame at most. Thumbnails that
+ * are waiting to be uploaded count towards the memory budget as well;
+ * the least recently requested ones are dropped first, then textures.
+ *
+ * Requests are queued; urgent requests jump the queue while prefetches go
+ * to the back. cancel_pending() drops every request that has not been
+ * picked up by a worker yet, so fast scrolling never piles up work.
+ */
+class CoverArtCache
+{
+private:
+    struct Job {
+        std::string             key;
+        std::string             path;   //!< Chart file to read the art from
+        MusicLibrary::Format    format;
+    };
+
+    struct Entry {
+        std::string     key;
+        clan::Image     image;
+        size_t          bytes;
+    };
+
+    struct Decoded {
+        std::string         key;
+        clan::PixelBuffer   art;
+        size_t              bytes;
+    };
+
+    using EntryList   = std::list< Entry >;
+    using DecodedList = std::list< Decoded >;
+
+    ////    Worker side    /////////////////////////////////////////////
+    std::vector< std::thread* > mWorkers;
+    std::mutex                  mMutex;     //!< Guards everything in this section
+    std::condition_variable     mWake;
+    bool                        mRunning;
+
+    std::deque< Job >           mQueue;     //!< Pending decode requests
+    std::unordered_map< std::string, bool >
+                                mInFlight;  //!< Keys queued or being decoded
+    DecodedList                 mDecoded;   //!< Decoded thumbnails to upload, most recent first
+    std::unordered_map< std::string, DecodedList::iterator >
+                                mDecodedIndex;
+    size_t                      mDecodedBytes; //!< Memory held by decoded thumbnails
+
+    ////    UI side    /////////////////////////////////////////////////
+    EntryList                   mEntries;   //!< Uploaded images, most recent first
+    std::unordered_map< std::string, EntryList::iterator >
+                                mIndex;
+
+    size_t          mBytes;         //!< Texture memory in use; guarded by mMutex
+    size_t const    mBudget;        //!< Texture memory budget
+    sizei  const    mThumbSize;     //!< Maximum thumbnail size
+    int    const    mUploadLimit;   //!< Maximum uploads per frame
+    int             mUploads;       //!< Uploads done this frame
+
+    void work();
+    clan::PixelBuffer read_art (Job const &job) const;
+    clan::PixelBuffer downscale(clan::PixelBuffer const &art) const;
+
+public:
+    CoverArtCache(
+            vec2i  const &thumb_size,
+            size_t budget_bytes = 64 << 20,
+            size_t workers      = 2,
+            int    upload_limit = 2
+            );
+    ~CoverArtCache();
+
+    CoverArtCache(CoverArtCache const &) = delete;
+    CoverArtCache& operator= (CoverArtCache const &) = delete;
+
+    /** Queues a chart file's cover art for decoding if it is not cached. */
+    void request(std::string const &key, std::string const &path, MusicLibrary::Format format, bool urgent = false);
+
+    /**
+     * Drops every request that has not been picked up yet. Thumbnails that
+     * have already been decoded are kept, within the memory budget.
+     */
+    void cancel_pending();
+
+    /** Resets the per-frame upload limit. Call once per frame. */
+    inline void begin_frame() { mUploads = 0; }
+
+    /**
+     * Gets the image for the given key, uploading it if it has just been
+     * decoded.
+     * @return the image, or a null image if it is not available yet.
+     */
+    clan::Image get(clan::Canvas &canvas, std::string const &key);
+};
+
+}
+
+#endif
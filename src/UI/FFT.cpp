@@ -2,107 +2,83 @@
 
 namespace UI {
 
-inline constexpr double _sinc(double const &x) { return sin(M_PI * x) / (M_PI * x); }
-static constexpr double _lanczos_size = 3.0f;
-inline constexpr double _lanczos_sinc(double const &x)
+/* 10 log10(x), accurate to about 0.001 dB for normal numbers. */
+static constexpr float _dB_per_log2 = 3.01029995664f;
+static constexpr float _log2_c0 = -2.49684590f;
+static constexpr float _log2_c1 =  4.02854750f;
+static constexpr float _log2_c2 = -2.08121371f;
+static constexpr float _log2_c3 =  0.62887341f;
+static constexpr float _log2_c4 = -0.07915813f;
+
+inline float _fast_dB(float x)
 {
-    return
-        (x == 0.0)          ? 1.0 : (
-        (x > _lanczos_size) ? 0.0 : (
-            _sinc(x) * _sinc(x / _lanczos_size)
-        )
-        );
+    union { float f; uint32_t i; } v { x };
+
+    float const e = static_cast<float>(static_cast<int32_t>(v.i >> 23) - 127);
+    v.i = (v.i & 0x007FFFFF) | 0x3F800000;
+
+    float const m = v.f;
+    return _dB_per_log2 * (e + _log2_c0 + m * (_log2_c1 + m * (_log2_c2 + m * (_log2_c3 + m * _log2_c4))));
 }
 
-std::vector<float> FFT::generate_window(FFT::IEWindowType const &type, ulong const &size)
+#ifdef AWE_USE_SSE
+inline __m128 _fast_dB(__m128 x)
 {
-    std::vector<float> window(size);
+    __m128i const i = _mm_castps_si128(x);
 
-    switch (type)
-    {
-        case FFT::IEWindowType::LANCZOS:
-            for(ulong t = 0; t < size; ++t)
-                window[t] = _lanczos_sinc(static_cast<double>(2 * t) / static_cast<double>(size - 1) - 1.0f);
-            break;
-
-        case FFT::IEWindowType::HANNING:
-            for(ulong t = 0; t < size; ++t)
-                window[t] = 0.5 * (1.0 - cos( 2.0 * M_PI * static_cast<double>(t) / static_cast<double>(size - 1)));
-            break;
-
-        case FFT::IEWindowType::RECTANGULAR:
-            for(ulong t = 0; t < size; ++t)
-                window[t] = 1.0f;
-            break;
-
-        case FFT::IEWindowType::TRIANGULAR:
-            for(ulong t = 0; t < size / 2; ++t)
-                window[t           ] =       static_cast<double>(2 * t) / static_cast<double>(size - 1),
-                window[t + size / 2] = 1.0 - static_cast<double>(2 * t) / static_cast<double>(size - 1);
-            break;
+    __m128 const e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(i, 23), _mm_set1_epi32(127)));
+    __m128 const m = _mm_castsi128_ps(_mm_or_si128(
+                _mm_and_si128(i, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)
+                ));
 
-    }
+    __m128 p = _mm_set1_ps(_log2_c4);
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(_log2_c3));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(_log2_c2));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(_log2_c1));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(_log2_c0));
 
-    return window;
+    return _mm_mul_ps(_mm_add_ps(e, p), _mm_set1_ps(_dB_per_log2));
 }
-
+#endif
 
 FFT::FFT(
     clan::GUIComponent *parent,
     recti area,
-    ulong frames,
+    SpectrumAnalyzer const &analyzer,
+    size_t source,
     ulong sample_rate,
     ulong bands,
     float fade,
-    IEWindowType window,
     IEScaleType  scale
 )   : clan::GUIComponent(parent, "FFT")
-    , mFrames       (frames - (frames % 2))
+    , mAnalyzer     (analyzer)
+    , mSource       (source)
+    , mFrames       (analyzer.getWindowSize())
     , mFade         (fade)
-    , mWindowType   (window)
     , mScaleType    (scale)
     , mScale        (1.0f)
     , mRange        (-awe::dBFS_limit / mScale)
-    , mOutput       (2, mFrames)
+    , mHops         (0)
+    , mOutput       (2, mFrames / 2)
     , mSpectrum     (2, 0)
-    , mPrevious     (2, mFrames)
     , mVector       (1, mFrames)
 {
     set_geometry(area);
 
     setBands(bands);
-    setWindow(window);
     setSampleRate(sample_rate);
 
-    kCl = kiss_fftr_alloc(mFrames, 0, NULL, NULL);
-    kCr = kiss_fftr_alloc(mFrames, 0, NULL, NULL);
-
-    kIl = (kiss_fft_scalar*)calloc(mFrames, sizeof(kiss_fft_scalar));
-    kIr = (kiss_fft_scalar*)calloc(mFrames, sizeof(kiss_fft_scalar));
-
-    kOl = (kiss_fft_cpx*)calloc(mFrames, sizeof(kiss_fft_cpx));
-    kOr = (kiss_fft_cpx*)calloc(mFrames, sizeof(kiss_fft_cpx));
-
     set_focus_policy(clan::GUIComponent::FocusPolicy::focus_refuse);
+    set_constant_repaint(true);
 
     func_render().set(this, &FFT::render);
 }
 
-FFT::~FFT ()
-{
-    kiss_fftr_free(kCl);
-    kiss_fftr_free(kCr);
-
-    free(kIl);
-    free(kIr);
-    free(kOl);
-    free(kOr);
-}
-
 void FFT::setSampleRate(ulong rate)
 {
+    // Decay per analyzer hop.
     mDecay =
-        mFade * (static_cast<float>(mFrames) / static_cast<float>(rate));
+        mFade * (static_cast<float>(2 * mAnalyzer.getHopSize()) / static_cast<float>(rate));
 }
 
 void FFT::setBands(ulong n)
@@ -117,208 +93,234 @@ void FFT::setBands(ulong n)
     mSpectrum.vector().reserve(2*mBands);
     mSpectrum.vector().resize (2*mBands);
 
+    mPower.assign(2*mBands, 0.0f);
+
+    // Metering lines, then a bar and a direction triangle per band.
+    mMesh     .assign(9*6 + 9*mBands, vec2f { 0.0f, 0.0f });
+    mMeshColor.assign(9*6 + 9*mBands, clan::Colorf { 1.0f, 1.0f, 1.0f, 0.2f });
+    mMeshSize = vec2f { 0.0f, 0.0f };
+
+    mBandColor.clear();
+    mBandColor.reserve(mBands);
+
+    clan::ColorHSVf color(0.0f, 1.0f, 1.0f, 0.1f);
+    float inc = 270.0f / mBands;
+
+    for(ulong i = 0; i < mBands; ++i)
+    {
+        color.h += inc;
+        mBandColor.push_back(clan::Colorf(color));
+    }
+
     for(ulong i = 0; i <= mBands; ++i)
         mBandX[i] = pow(
             static_cast<float>(mFrames / 2),
             static_cast<float>(i) / static_cast<float>(mBands)
             ) - 0.5f;
-}
 
-void FFT::setWindow(FFT::IEWindowType type)
-{
-    std::vector<awe::Afloat> window = generate_window(type, mFrames);
-    mWindow.swap(window);
+    /* Transform frequency axis from linear scale to logarithmic scale */
+    ulong const bins = mFrames / 2;
 
-    // Calculate window scaling
-    for (ulong t = 0; t < mFrames; ++t)
-        mWindowScale += mWindow[t];
+    mBandRow   .clear();
+    mBandBin   .clear();
+    mBandWeight.clear();
 
-    mWindowScale = (mWindowScale > 0.0f) ? 4.0f / (mWindowScale * mWindowScale) : 1.0f;
-}
+    mBandRow.reserve(1+mBands);
+    mBandRow.push_back(0);
 
+    auto add = [this] (ulong bin, float weight) {
+        mBandBin   .push_back(bin);
+        mBandWeight.push_back(weight);
+    };
 
-void FFT::calc_FFT(const awe::AfBuffer& buffer)
-{
-    /* Read input and apply window */
-    for (ulong t = 0; t < mFrames; t++)
+    for(ulong i = 0; i < mBands; ++i)
     {
-        kIl[t] = buffer.getSample(t*2)   * mWindow[t];
-        kIr[t] = buffer.getSample(t*2+1) * mWindow[t];
-    }
-
-    kiss_fftr( kCl , kIl , kOl );
-    kiss_fftr( kCr , kIr , kOr );
-
-    ulong const n = mFrames / 2; /* Look for: Nyquist Theorem */
+        unsigned a = ceil (mBandX[i  ]);
+        unsigned b = floor(mBandX[i+1]);
+        unsigned c = a - 1;
 
-    /* Get magnitude of FFT */
-    for (ulong t = 0; t < n; ++t)
-    {
-        float rl, il, rr, ir;
+        // where x = 0 .. b
+        if (b < a) { // log(x) / log(b) < 1.0;
+            add(b, mBandX[i+1] - mBandX[i]);
+        } else {     // log(x) / log(b) > 1.0;
+            if (a > 0)
+                add(c, a - mBandX[i]);
 
-        rl = kOl[t].r;
-        il = kOl[t].i;
+            for (; a < b; a++)
+                add(a, 1.0f);
 
-        rr = kOr[t].r;
-        ir = kOr[t].i;
+            if (b < bins)
+                add(b, mBandX[i+1] - b);
+        }
 
-        mOutput.data()[t*2  ] = rl*rl + il*il;
-        mOutput.data()[t*2+1] = rr*rr + ir*ir;
+        mBandRow.push_back(mBandBin.size());
     }
 }
 
-
-void FFT::update(awe::AfBuffer const& buffer)
+bool FFT::update()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-
-    if (is_enabled() == false)
-        return;
+    ulong const hops = mAnalyzer.read(mSource, mOutput);
+    if (hops == mHops)
+        return false;
 
-    calc_FFT(buffer);
+    // Decay as much as the number of spectra skipped over.
+    float const decay = mRange * mDecay * static_cast<float>(hops - mHops);
+    mHops = hops;
 
+    /* Sum bins into bands */
+    float const * bin = mOutput.cdata();
     for(ulong i = 0; i < mBands; i++)
     {
-        unsigned a = ceil (mBandX[i  ]);
-        unsigned b = floor(mBandX[i+1]);
-        unsigned c = a - 1;
+        float l = 0.0f, r = 0.0f;
 
-        awe::Asfloatf n({ 0.0f, 0.0f });
-        awe::Asfloatf o(mSpectrum.getFrame(i));
+        for(ulong j = mBandRow[i]; j < mBandRow[i+1]; j++)
+            l += bin[mBandBin[j]*2  ] * mBandWeight[j],
+            r += bin[mBandBin[j]*2+1] * mBandWeight[j];
 
-        /* Transform frequency axis from linear scale to logarithmic scale */
+        mPower[i*2  ] = l;
+        mPower[i*2+1] = r;
+    }
 
-        // where x = 0 .. b
-        if (b < a) { // log(x) / log(b) < 1.0;
-            n[0] += mOutput.getSample(b*2  ) * (mBandX[i+1] - mBandX[i]),
-            n[1] += mOutput.getSample(b*2+1) * (mBandX[i+1] - mBandX[i]);
-        } else {     // log(x) / log(b) > 1.0;
-            if (a > 0)
-                n[0] += mOutput.getSample(c*2  ) * (a - mBandX[i]),
-                n[1] += mOutput.getSample(c*2+1) * (a - mBandX[i]);
+    /* Apply magnitude scaling on spectra value, and peaking and decay on the
+     * old peak, to both channels of every band at once. */
+    float       * p = mPower.data();
+    float       * o = mSpectrum.data();
+    ulong const   n = 2*mBands;
+    ulong         i = 0;
 
-            for (; a < b; a++)
-                n[0] += mOutput.getSample(a*2  ),
-                n[1] += mOutput.getSample(a*2+1);
+#ifdef AWE_USE_SSE
+    __m128 const vRange = _mm_set1_ps(mRange);
+    __m128 const vDecay = _mm_set1_ps(decay);
+    __m128 const vZero  = _mm_setzero_ps();
 
-            if (b < mBands)
-                n[0] += mOutput.getSample(b*2  ) * (mBandX[i+1] - b),
-                n[1] += mOutput.getSample(b*2+1) * (mBandX[i+1] - b);
-        }
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(p + i);
 
-        /* Apply magnitude scaling on spectra value. */
         switch (mScaleType)
         {
             case FFT::IEScaleType::DBFS:
-                n( [this] (float &x) {
-                        x = 10.0f * log10(x * mWindowScale);
-                        x = (x == x) ? ( (x > -mRange) ? (x + mRange) : 0.0f ) : 0.0f;
-                        } );
+                x = _mm_max_ps(_mm_add_ps(_fast_dB(x), vRange), vZero);
                 break;
 
             case FFT::IEScaleType::CUBIC:
-                n( [] (float &x) { x = powf(x, 1.0f/3.0f); });
-                n *= mRange;
+                _mm_storeu_ps(p + i, x);
+                for(ulong k = i; k < i + 4; k++)
+                    p[k] = cbrtf(p[k]);
+                x = _mm_mul_ps(_mm_loadu_ps(p + i), vRange);
                 break;
 
             case FFT::IEScaleType::LINEAR:
-                n( [] (float &x) { x = sqrt(x); });
-                n *= mRange * 2.0f;
+                x = _mm_mul_ps(_mm_sqrt_ps(x), _mm_add_ps(vRange, vRange));
                 break;
         }
 
-        // Apply peaking and decay on Old Peak
-        o[0] -= mRange * mDecay,
-        o[1] -= mRange * mDecay;
-
-        // Old Peak value clipping
-        o[0] = o[0] > 0.0f ? o[0] : 0.0f,
-        o[1] = o[1] > 0.0f ? o[1] : 0.0f;
-
-        // Use New Peak if it is louder
-        n[0] = n[0] > o[0] ? n[0] : o[0],
-        n[1] = n[1] > o[1] ? n[1] : o[1];
-
-        mSpectrum.setFrame(i, n.data.data());
+        __m128 const old = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(o + i), vDecay), vZero);
+        _mm_storeu_ps(o + i, _mm_max_ps(x, old));
     }
-}
+#endif
 
-void FFT::update_2(awe::AfBuffer const &buffer) {
-    auto pvec = mPrevious.vector();
-    auto nvec = buffer.cvector();
+    for(; i < n; i++)
+    {
+        float x = p[i];
 
-    uint s = buffer.getSampleCount() / 2;
+        switch (mScaleType)
+        {
+            case FFT::IEScaleType::DBFS:
+                x = _fast_dB(x) + mRange;
+                x = (x > 0.0f) ? x : 0.0f;
+                break;
 
-    std::copy(pvec.cbegin() + s, pvec.cend(), pvec.begin());
-    std::copy(nvec.cbegin(), nvec.cbegin() + s, pvec.begin() + s);
+            case FFT::IEScaleType::CUBIC:
+                x = cbrtf(x) * mRange;
+                break;
 
-    update(mPrevious);
-    update(buffer);
+            case FFT::IEScaleType::LINEAR:
+                x = sqrtf(x) * mRange * 2.0f;
+                break;
+        }
 
-    mPrevious = buffer;
+        float const old = (o[i] - decay > 0.0f) ? o[i] - decay : 0.0f;
+        o[i] = (x > old) ? x : old;
+    }
 
-    request_repaint();
+    return true;
 }
 
-////    GUI Component Callbacks    ////////////////////////////////////
-void FFT::render(clan::Canvas &canvas, recti const &clip_rect)
+void FFT::build_mesh()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-
-    if (is_enabled() == false)
-        return;
+    float const h = static_cast<float>(get_height());
+    float const w = static_cast<float>(get_width ());
 
-    float bandw = static_cast<float>(get_height()) / static_cast<float>(mBands);
-    float midpt = static_cast<float>(get_width ()) / 2.0f;
+    float bandw = h / static_cast<float>(mBands);
+    float midpt = w / 2.0f;
 
-    // Draw metering lines
-    canvas.draw_line(
-        midpt, 0, midpt, get_height(),
-        clan::Colorf(1.0f, 1.0f, 1.0f, 0.05f)
-        );
+    vec2f        * v = mMesh.data();
+    clan::Colorf * c = mMeshColor.data();
 
-    const uchar n = 4;
-    const float l = awe::dBFS_limit / n;
+    auto quad = [&v, &c] (float x0, float y0, float x1, float y1, clan::Colorf const &color) {
+        *v++ = vec2f { x0, y0 }; *v++ = vec2f { x1, y0 }; *v++ = vec2f { x0, y1 };
+        *v++ = vec2f { x1, y0 }; *v++ = vec2f { x1, y1 }; *v++ = vec2f { x0, y1 };
+        for(uchar k = 0; k < 6; k++)
+            *c++ = color;
+    };
 
-    for (int i = 1; i <= 4; ++i)
+    if (mMeshSize.x != w || mMeshSize.y != h)
     {
-        float j = static_cast<float>(i) * l;
-        canvas.draw_line(
-            midpt - j, 0, midpt - j, get_height(),
-            clan::Colorf(1.0f, 1.0f, 1.0f, 0.01f)
-            );
-        canvas.draw_line(
-            midpt + j, 0, midpt + j, get_height(),
-            clan::Colorf(1.0f, 1.0f, 1.0f, 0.01f)
-            );
+        // Draw metering lines
+        quad(midpt - 0.5f, 0, midpt + 0.5f, h, clan::Colorf(1.0f, 1.0f, 1.0f, 0.05f));
+
+        const uchar n = 4;
+        const float l = awe::dBFS_limit / n;
+
+        for (int i = 1; i <= 4; ++i)
+        {
+            float j = static_cast<float>(i) * l;
+            quad(midpt - j - 0.5f, 0, midpt - j + 0.5f, h, clan::Colorf(1.0f, 1.0f, 1.0f, 0.01f));
+            quad(midpt + j - 0.5f, 0, midpt + j + 0.5f, h, clan::Colorf(1.0f, 1.0f, 1.0f, 0.01f));
+        }
+
+        mMeshSize = vec2f { w, h };
+    } else {
+        v += 9*6;
+        c += 9*6;
     }
 
     // Draw spectrum
-    clan::ColorHSVf color(0.0f, 1.0f, 1.0f, 0.1f);
-    float inc = 270.0f / mBands;
-
     for(ulong i = 0; i < mBands; ++i)
     {
-        color.h += inc;
-
-        rectf out {
+        quad(
             midpt - mSpectrum.getSample(i*2  ), bandw * (mBands-i  ),
-            midpt + mSpectrum.getSample(i*2+1), bandw * (mBands-i+1)
-        };
-
-        canvas.fill_rect(out, color);
+            midpt + mSpectrum.getSample(i*2+1), bandw * (mBands-i+1),
+            mBandColor[i]
+            );
 
+        // Direction triangle colors never change.
         const float vec = 3.0f * ( mSpectrum.getSample(i*2+1) - mSpectrum.getSample(i*2  ) );
-        canvas.fill_triangle(
-                point2f{ midpt + vec                  , bandw * (mBands-i+2) },
-                point2f{ midpt + mVector.get0Sample(i), bandw * (mBands-i+1) },
-                point2f{ midpt + vec                  , bandw * (mBands-i  ) },
-                clan::Colorf { 1.0f, 1.0f, 1.0f, 0.2f }
-                );
+        *v++ = vec2f { midpt + vec                  , bandw * (mBands-i+2) };
+        *v++ = vec2f { midpt + mVector.get0Sample(i), bandw * (mBands-i+1) };
+        *v++ = vec2f { midpt + vec                  , bandw * (mBands-i  ) };
+        c += 3;
 
         mVector.vector()[i] = vec;
     }
 }
 
+////    GUI Component Callbacks    ////////////////////////////////////
+void FFT::render(clan::Canvas &canvas, recti const &clip_rect)
+{
+    if (is_enabled() == false)
+        return;
+
+    bool const fresh = update();
+
+    if (fresh
+        || mMeshSize.x != static_cast<float>(get_width ())
+        || mMeshSize.y != static_cast<float>(get_height()))
+        build_mesh();
+
+    canvas.fill_triangles(mMesh.data(), mMeshColor.data(), static_cast<int>(mMesh.size()));
+}
+
 
 }
@@ -6,25 +6,20 @@
 
 #include "../__zzCore.hpp"
 #include "../libawe/aweBuffer.h"
-
-#include "../kiss_fft130/kiss_fft.h"
-#include "../kiss_fft130/kiss_fftr.h"
-
-#include <mutex>
+#include "../SpectrumAnalyzer.hpp"
 
 namespace UI {
 
+/**
+ * Spectrum visualizer.
+ *
+ * Shows the spectrum of one SpectrumAnalyzer source. The spectrum is
+ * picked up when the component is rendered, so it has no cost on the
+ * analysis thread.
+ */
 class FFT : public clan::GUIComponent
 {
 public:
-    enum class IEWindowType : uint8_t
-    {
-        HANNING     = 'H',
-        LANCZOS     = 'L',
-        RECTANGULAR = 'R',
-        TRIANGULAR  = 'T'
-    };
-
     enum class IEScaleType : uint8_t
     {
         LINEAR = 'L',
@@ -32,19 +27,15 @@ public:
         CUBIC  = 'C'
     };
 
-    static std::vector<float> generate_window(IEWindowType const &window, ulong const &size);
-
-private:
-    std::mutex      mMutex;     //! Master mutex
-
 protected:
     ////    Class behaviour    /////////////////////////////
+    SpectrumAnalyzer const &mAnalyzer;
+    size_t  mSource;    //! analyzer source to show
     ulong   mFrames;    //! number of frames to process
     ulong   mBands;     //! number of bands to show
     float   mFade;      //! decay strength
     float   mDecay;     //! decay over time
 
-    IEWindowType    mWindowType;
     IEScaleType     mScaleType;
 
     float   mScale; // range of values to display (for log scale from 0db to x)
@@ -52,41 +43,48 @@ protected:
 
 
     ////    Class state    /////////////////////////////////
-    kiss_fftr_cfg    kCl,  kCr; // KISSFFT config
-    kiss_fft_scalar *kIl, *kIr; // input
-    kiss_fft_cpx    *kOl, *kOr; // output
+    ulong               mHops;          // Analyzer hop count of the shown spectrum
 
     std::vector<float>  mBandX;         // Plot scale conversion table
-    std::vector<float>  mWindow;        // FFT window function coefficients
-    float               mWindowScale;   // FFT window magnitude adjustment
-    awe::AfBuffer       mOutput;        // Squares of the real and imaginary parts of the FFT output
+
+    // Bin to band weights, as a sparse matrix in compressed rows.
+    std::vector<ulong>  mBandRow;       // First entry of every band; mBands + 1 long
+    std::vector<ulong>  mBandBin;       // Bin of every entry
+    std::vector<float>  mBandWeight;    // Weight of every entry
+
+    awe::AfBuffer       mOutput;        // Bin powers read from the analyzer
+    std::vector<float>  mPower;         // Band powers, interleaved like mSpectrum
     awe::AfBuffer       mSpectrum;      // Output spectrum values adjusted to scale for drawing
 
-    awe::AfBuffer       mPrevious;      // Half-buffer of previous run.
     awe::AfBuffer       mVector;        // Spectra direction buffer.
 
+    // Everything is drawn as one batch of triangles; the mesh is rebuilt
+    // only when a new spectrum comes in or the component is resized.
+    std::vector<clan::Colorf>   mBandColor; // Bar color of every band
+    std::vector<vec2f>          mMesh;      // Triangle vertices
+    std::vector<clan::Colorf>   mMeshColor; // Triangle vertex colors
+    vec2f                       mMeshSize;  // Component size the mesh was built for
+
     void setBands (ulong);
-    void setWindow(IEWindowType);
+    void build_mesh();
 
 public:
     FFT(clan::GUIComponent *parent,
         recti area,
-        ulong frames,
+        SpectrumAnalyzer const &analyzer,
+        size_t source,
         ulong sample_rate,
         ulong bands,
         float fade = 0.1f,
-        IEWindowType window = IEWindowType::HANNING,
         IEScaleType  scale  = IEScaleType::DBFS
        );
-    ~FFT();
-
-    inline std::mutex &getMutex() { return mMutex; }
 
     void setSampleRate(ulong rate);
 
-    void calc_FFT(awe::AfBuffer const &buffer);
-    void update  (awe::AfBuffer const &buffer);
-    void update_2(awe::AfBuffer const &buffer); // Double-buffered update.
+    /*! Picks up the latest spectrum from the analyzer, if there is one.
+     *  \return true if the spectrum has changed.
+     */
+    bool update();
 
     ////    GUI Component Callbacks    ////////////////////////////////
     void render(clan::Canvas &canvas, recti const &clip_rect);
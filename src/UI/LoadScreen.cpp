@@ -0,0 +1,130 @@
+#include "LoadScreen.hpp"
+#include "../ChartLoader.hpp"
+#include "../Chart.hpp"
+
+namespace UI {
+
+LoadScreen::LoadScreen(clan::GUIComponent *parent, JSONReader &skin, ChartLoader &loader) :
+    clan::GUIComponent(parent, "load_screen"),
+    mLoader(loader),
+
+    mHo(skin.get_or_set(
+                &JSONReader::getVec2i, "theme.load-screen.head-offset",
+                vec2i(32, 64))),
+    mBo(skin.get_or_set(
+                &JSONReader::getVec2i, "theme.load-screen.body-offset",
+                vec2i(32, 96))),
+    mPb(skin.get_or_set(
+                &JSONReader::getRecti, "theme.load-screen.progress-bar",
+                recti(32, 128, 352, 136))),
+
+    mCover(),
+    mCoverTried(false)
+{
+    clan::Canvas canvas = get_canvas();
+
+    mHf = clan::Font(canvas, skin.getFontDesc("theme.load-screen.head-font"));
+    mBf = clan::Font(canvas, skin.getFontDesc("theme.load-screen.body-font"));
+
+    set_constant_repaint(true);
+    set_focus(true);    // Grab keyboard focus.
+    set_geometry(recti{0, 0, parent->get_size()});
+
+    func_render().set(this, &LoadScreen::render);
+    func_input ().set(this, &LoadScreen::process_input);
+}
+
+////    GUI Component Callbacks    ////////////////////////////////
+bool LoadScreen::process_input(const clan::InputEvent& event)
+{
+    if (debug)
+        dump_event(event, "LoadScreen");
+
+    if (event.device.get_type() == clan::InputDevice::Type::keyboard &&
+        event.type == clan::InputEvent::Type::released)
+    {
+        switch (event.id)
+        {
+            case clan::InputCode::keycode_escape:
+                mLoader.cancel();
+                exit_with_code(1);
+                return true;
+
+            case clan::InputCode::keycode_enter:
+                if (mLoader.getState() == ChartLoader::State::FAILED) {
+                    exit_with_code(1);
+                    return true;
+                }
+                break;
+        }
+    }
+
+    return false;
+}
+
+void LoadScreen::render(clan::Canvas &canvas, recti const &clip_rect)
+{
+    ChartLoader::State const state = mLoader.getState();
+    Chart const * chart = mLoader.getChart();
+
+    if (state == ChartLoader::State::DONE) {
+        exit_with_code(0);
+    } else if (state == ChartLoader::State::CANCELLED) {
+        exit_with_code(1);
+    }
+
+    // Upload the cover art on this thread once the loader is done with it.
+    if (mCoverTried == false && mLoader.isCoverReady())
+    {
+        clan::PixelBuffer const &cvrart = mLoader.getChart()->getCoverArt();
+        if (cvrart.is_null() == false) {
+            mCover = clan::Image(canvas, cvrart, recti(0, 0, cvrart.get_width(), cvrart.get_height()));
+            mCover.set_alpha(0.333f);
+        }
+        mCoverTried = true;
+    }
+
+    if (mCover.is_null() == false)
+    {
+        float scale = std::min(
+            static_cast<float>(get_width ()) / static_cast<float>(mCover.get_width ()),
+            static_cast<float>(get_height()) / static_cast<float>(mCover.get_height())
+        );
+
+        mCover.draw( canvas, alignCC(
+            static_cast<sizef>(get_size()),
+            static_cast<sizef>(mCover.get_size()) * scale
+        ) );
+    }
+
+    mHf.draw_text(canvas, mHo, chart->getName());
+
+    std::string status;
+    switch (state)
+    {
+        case ChartLoader::State::IDLE:
+        case ChartLoader::State::LOADING_CHART:
+            status = "Loading chart...";
+            break;
+        case ChartLoader::State::LOADING_SAMPLES:
+            status = clan::string_format("Level %1 - Loading samples... ", chart->getLevel())
+                   + std::to_string(static_cast<int>(mLoader.getProgress() * 100.0f)) + "%";
+            break;
+        case ChartLoader::State::FAILED:
+            status = "Failed to load chart: " + mLoader.getError();
+            break;
+        default:
+            status = clan::string_format("Level %1 - Ready", chart->getLevel());
+            break;
+    }
+
+    mBf.draw_text(canvas, mBo, status);
+
+    // Progress bar
+    rectf bar = mPb;
+    canvas.fill_rect(bar, clan::Colorf { 1.0f, 1.0f, 1.0f, 0.2f });
+    bar.right = bar.left + bar.get_width() * mLoader.getProgress();
+    canvas.fill_rect(bar, clan::Colorf { 1.0f, 1.0f, 1.0f, 0.8f });
+}
+
+}
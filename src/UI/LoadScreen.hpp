@@ -0,0 +1,49 @@
+//  UI/LoadScreen.hpp :: Chart loading / ready screen UI component
+//  Copyright 2014 Keigen Shu
+
+#ifndef UI_LOAD_SCREEN_H
+#define UI_LOAD_SCREEN_H
+
+#include "../__zzCore.hpp"
+#include "../clanExt_JSONReader.hpp"
+
+class ChartLoader;
+
+namespace UI {
+
+/**
+ * Ready screen shown while a chart is being loaded by a ChartLoader.
+ *
+ * The screen polls the loader every frame; the cover art and chart
+ * information are shown as soon as they are available, followed by a
+ * progress bar while the samples are streamed in.
+ *
+ * exec() returns 0 once the chart is ready to be played, or 1 if the
+ * player backed out (the load is cancelled) or the load failed.
+ */
+class LoadScreen : public clan::GUIComponent
+{
+private:
+    ChartLoader   & mLoader;
+
+    point2f const   mHo;    // Head (chart name) text offset
+    point2f const   mBo;    // Body (chart info) text offset
+    rectf   const   mPb;    // Progress bar area
+
+    clan::Font      mHf;    // Head font
+    clan::Font      mBf;    // Body font
+
+    clan::Image     mCover; // Cover art, created once the loader has it.
+    bool            mCoverTried;
+
+public:
+    LoadScreen(clan::GUIComponent *parent, JSONReader &skin, ChartLoader &loader);
+
+    ////    GUI Component Callbacks    ////////////////////////////////
+    bool process_input(clan::InputEvent const &event);
+    void render(clan::Canvas &canvas, recti const &clip_rect);
+};
+
+}
+
+#endif
@@ -1,11 +1,19 @@
+#include <algorithm>
 #include "MusicSelector.hpp"
+#include "../Chart.hpp"
+#include "../ChartPreloader.hpp"
 
 namespace UI {
 
 // Constructor
-MusicSelector::MusicSelector(clan::GUIComponent *parent, JSONReader &skin, MusicList const &list) :
+MusicSelector::MusicSelector(clan::GUIComponent *parent, JSONReader &skin, MusicLibrary &library, ChartPreloader &preloader) :
     clan::GUIComponent(parent, "music_selector"),
-    mMusicList(list),
+    mLibrary(library),
+    mOrder  (MusicLibrary::Order::ARTIST),
+    mView   (library.order(mOrder)),
+    mSearch (library),
+    mQuery  (),
+    mPreloader(preloader),
 
     // List element starting offset
     mso (skin.get_or_set(
@@ -55,6 +63,9 @@ MusicSelector::MusicSelector(clan::GUIComponent *parent, JSONReader &skin, Music
     mSbo(skin.get_or_set(
                 &JSONReader::getVec2i, "theme.music-selector.selected-tempo-offset",
                 vec2i(0, 20))),
+    mSqo(skin.get_or_set(
+                &JSONReader::getVec2i, "theme.music-selector.search-offset",
+                vec2i(0, 20))),
 
     mLdelay(skin.get_if_else_set(
                 &JSONReader::getInteger, "player.scroll-delay", 0,
@@ -69,7 +80,21 @@ MusicSelector::MusicSelector(clan::GUIComponent *parent, JSONReader &skin, Music
     mVptr(0),
     mVprv  (-1),
     mVstore(-1),
-    mCindex(0)
+    mCindex(0),
+    mBGImg (),
+    mArt   (
+            skin.get_or_set(
+                &JSONReader::getVec2i, "theme.music-selector.art-size",
+                vec2i(800, 600)),
+            static_cast<size_t>(skin.get_if_else_set(
+                &JSONReader::getInteger, "theme.music-selector.art-budget", 64,
+                [] (int const &value) -> bool { return value >= 8 && value <= 1024; }
+                )) << 20 // Texture budget in MiB
+            ),
+    mArtPrefetch(skin.get_if_else_set(
+                &JSONReader::getInteger, "theme.music-selector.art-prefetch", 4,
+                [] (int const &value) -> bool { return value >= 0 && value <= 20; }
+                ))
     {
         clan::Canvas canvas = get_canvas();
 
@@ -89,25 +114,62 @@ MusicSelector::MusicSelector(clan::GUIComponent *parent, JSONReader &skin, Music
         func_input ().set(this, &MusicSelector::process_input);
     }
 
-Chart* MusicSelector::get() const
+MusicLibrary::MusicRecord const * MusicSelector::at(int position) const
 {
-    if (mVptr < 0)
+    if (position < 0 || position >= static_cast<int>(mView.size()))
         return nullptr;
 
-    MusicList::const_iterator ip = mMusicList.begin(); // Selected music
-    for(int i=0; i<mVptr; ip++, i++);
+    return &mLibrary.music(mView[position]);
+}
 
-    ChartMap::const_iterator ic = (*ip)->charts.begin(); // Selected chart
-    for (int i = 0; i<mCindex; ic++, i++)
-    {
-        if (ic == (*ip)->charts.end())
-        {
-            ic--;
-            break;
-        }
+void MusicSelector::search()
+{
+    // An empty query lists the whole library; there is nothing to wait for.
+    if (mQuery.find_first_not_of(' ') == std::string::npos)
+        set_view(mLibrary.order(mOrder));
+
+    mSearch.submit(mQuery, mOrder);
+}
+
+void MusicSelector::set_view(std::vector< uint32_t > const &view)
+{
+    // Keep the selected music selected if it is still listed.
+    MusicLibrary::MusicRecord const * music = at(mVptr);
+
+    mView = view;
+    mVptr = 0;
+
+    if (music != nullptr) {
+        uint32_t const index = music - &mLibrary.music(0);
+        auto const it = std::find(mView.cbegin(), mView.cend(), index);
+        if (it != mView.cend())
+            mVptr = it - mView.cbegin();
     }
 
-    return ic->second;
+    mVprv = -1;
+    mVtop = std::max(0, std::min(mVtop, mVptr));
+    if ((mVptr - mVtop) > (mVcount - 1))
+        mVtop = mVptr - (mVcount - 1);
+}
+
+void MusicSelector::request_art(MusicLibrary::MusicRecord const &music, bool urgent)
+{
+    if (music.charts == 0)
+        return;
+
+    // Read the art straight from the first chart's file; creating the Chart
+    // itself would pre-parse it on the UI thread.
+    MusicLibrary::ChartRecord const &chart = mLibrary.chart(music.chart);
+    mArt.request(mLibrary.str(music.path), mLibrary.str(chart.path), chart.format, urgent);
+}
+
+Chart* MusicSelector::get() const
+{
+    MusicLibrary::MusicRecord const * music = at(mVptr);
+    if (music == nullptr)
+        return nullptr;
+
+    return mLibrary.getChart(*music, static_cast<uint32_t>(mCindex));
 }
 
 ////    GUI Component Callbacks    ////////////////////////////////
@@ -136,7 +198,7 @@ bool MusicSelector::process_input(const clan::InputEvent& event)
 
                 case clan::InputCode::keycode_down:
                     if (mLcounter <= 0) {
-                        mVptr = (mVptr < static_cast<int>(mMusicList.size())) ? (mVptr + 1) : mMusicList.size();
+                        mVptr = (mVptr < static_cast<int>(mView.size())) ? (mVptr + 1) : mView.size();
                         mLcounter = mLdelay;
                     } else {
                         mLcounter -= 1;
@@ -151,8 +213,34 @@ bool MusicSelector::process_input(const clan::InputEvent& event)
                     mCindex += (mCindex >= 2) ? 0 : 1; // TODO Improve me
                     break;
 
+                case clan::InputCode::keycode_tab:
+                    // Cycle sort order, keeping the selected music selected.
+                    mOrder = static_cast<MusicLibrary::Order>(
+                            (static_cast<int>(mOrder) + 1) % static_cast<int>(MusicLibrary::Order::COUNT)
+                            );
+                    search();
+                    break;
+
+                case clan::InputCode::keycode_backspace:
+                    if (mQuery.empty())
+                        return false;
+
+                    // Remove the last (UTF-8) character.
+                    do {
+                        mQuery.pop_back();
+                    } while (mQuery.empty() == false && (static_cast<uint8_t>(mQuery.back()) & 0xC0) == 0x80);
+
+                    search();
+                    break;
+
                 default:
-                    return false;
+                    // Type to search.
+                    if (event.str.empty() || static_cast<uint8_t>(event.str[0]) < 0x20 || event.str[0] == 0x7F)
+                        return false;
+
+                    mQuery += event.str;
+                    search();
+                    break;
             }
 
             if((mVptr - mVtop) > (mVcount - 1))
@@ -165,6 +253,12 @@ bool MusicSelector::process_input(const clan::InputEvent& event)
             switch (event.id)
             {
                 case clan::InputCode::keycode_escape:
+                    if (mQuery.empty() == false) {
+                        mQuery.clear();
+                        search();
+                        return true;
+                    }
+
                     mVptr = mVstore;
                     exit_with_code(1);
                     return true;
@@ -186,31 +280,48 @@ bool MusicSelector::process_input(const clan::InputEvent& event)
 
 void MusicSelector::render(clan::Canvas& canvas, const recti& clip_rect)
 {
-    // Top-of-screen and currently-pointed iterators
-    MusicList::const_iterator it = mMusicList.cbegin(); // Top / current iteration
-    MusicList::const_iterator ip = mMusicList.cbegin(); // Selected item
-    MusicList::const_iterator il = mVprv == -1 ? mMusicList.cend() : mMusicList.cbegin(); // Previous item
+    // Pick up search results.
+    MusicSearch::Result result;
+    if (mSearch.poll(result))
+        set_view(result);
+
+    MusicLibrary::MusicRecord const * ip = at(mVptr); // Selected item
+
+    mArt.begin_frame();
 
-    for(int i=0; i<mVtop; it++, i++);
-    for(int i=0; i<mVptr; ip++, i++);
-    for(int i=0; i<mVprv; il++, i++);
+    // Start preloading the selected chart once the selection rests on it.
+    mPreloader.focus(ip == nullptr ? nullptr : this->get());
 
-    if (ip == mMusicList.cend()) {
+    if (ip == nullptr) {
         // TODO Add random selection background image
         mBGImg = clan::Image();
-    } else if (ip != il) {
-        if (il != mMusicList.cend())
-            (*il)->charts.begin()->second->setCoverArt();
-        (*ip)->charts.begin()->second->load_art();
+        mVprv  = -1;
+    } else {
+        if (mVptr != mVprv) {
+            // Drop art requests for elements we scrolled past, then ask for
+            // the selected element first and its neighbours in the direction
+            // the player is scrolling.
+            mArt.cancel_pending();
+            request_art(*ip, true);
+
+            int const step = (mVprv != -1 && mVptr < mVprv) ? -1 : 1;
+            for (int i = 1; i <= mArtPrefetch; i++)
+            {
+                MusicLibrary::MusicRecord const * in = at(mVptr + i * step);
+                if (in == nullptr)
+                    break;
 
-        mVprv = mVptr;
+                request_art(*in, false);
+            }
 
-        clan::PixelBuffer &cvrart = (*ip)->charts.begin()->second->getCoverArt();
-        if (cvrart.is_null()) {
+            mVprv  = mVptr;
             mBGImg = clan::Image();
-        } else {
-            mBGImg = clan::Image(canvas, cvrart, recti(0,0,800,600));
-            mBGImg.set_alpha(0.333f);
+        }
+
+        if (mBGImg.is_null()) {
+            mBGImg = mArt.get(canvas, mLibrary.str(ip->path));
+            if (mBGImg.is_null() == false)
+                mBGImg.set_alpha(0.333f);
         }
     }
 
@@ -227,29 +338,34 @@ void MusicSelector::render(clan::Canvas& canvas, const recti& clip_rect)
         ) );
     }
 
+    if (mQuery.empty() == false)
+        mSbf.draw_text(canvas, mSqo, clan::string_format("Search: %1", mQuery));
+
     point2f pos = mso;
 
-    for(int i=0; i<mVcount; it++, i++)
+    for(int i=0, it=mVtop; i<mVcount; it++, i++)
     {
-        if (it == mMusicList.end())
+        MusicLibrary::MusicRecord const * im = at(it);
+
+        if (im == nullptr)
         {
-            if (it == ip)
+            if (it == mVptr)
                 mAtf.draw_text(canvas, pos + mAto, "RANDOM");
             else
                 mItf.draw_text(canvas, pos + mIto, "Random");
 
             break;
-        } else if (it == ip) {
-            mAaf.draw_text(canvas, pos + mAao, (*ip)->artist);
-            mAtf.draw_text(canvas, pos + mAto, (*ip)->title);
+        } else if (it == mVptr) {
+            mAaf.draw_text(canvas, pos + mAao, mLibrary.str(ip->artist));
+            mAtf.draw_text(canvas, pos + mAto, mLibrary.str(ip->title));
             pos += mAeo;
 
             // Draw information about selected music/chart
             Chart* chart = this->get();
 
-            mSbf.draw_text(canvas, mSgo, (*ip)->genre);
-            mSbf.draw_text(canvas, mSao, (*ip)->artist);
-            mShf.draw_text(canvas, mSto, (*ip)->title);
+            mSbf.draw_text(canvas, mSgo, mLibrary.str(ip->genre));
+            mSbf.draw_text(canvas, mSao, mLibrary.str(ip->artist));
+            mShf.draw_text(canvas, mSto, mLibrary.str(ip->title));
 
             if (chart != nullptr)
             { // TODO guarantee chart is not nullptr
@@ -268,8 +384,8 @@ void MusicSelector::render(clan::Canvas& canvas, const recti& clip_rect)
                 mSbf.draw_text(canvas, mSbo, f.get_result());
             }
         } else {
-            mIaf.draw_text(canvas, pos + mIao, (*it)->artist);
-            mItf.draw_text(canvas, pos + mIto, (*it)->title);
+            mIaf.draw_text(canvas, pos + mIao, mLibrary.str(im->artist));
+            mItf.draw_text(canvas, pos + mIto, mLibrary.str(im->title));
             pos += mIeo;
         }
     }
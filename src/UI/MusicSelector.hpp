@@ -6,7 +6,11 @@
 
 #include "../__zzCore.hpp"
 #include "../clanExt_JSONReader.hpp"
-#include "../Music.hpp"
+#include "../MusicLibrary.hpp"
+#include "../MusicSearch.hpp"
+#include "CoverArtCache.hpp"
+
+class ChartPreloader;
 
 namespace UI {
 
@@ -17,7 +21,14 @@ namespace UI {
 class MusicSelector : public clan::GUIComponent
 {
 private:
-    MusicList   mMusicList;
+    MusicLibrary        &mLibrary;
+    MusicLibrary::Order  mOrder;    // Current sort order
+    std::vector<uint32_t> mView;    // Listed music indices, in display order
+
+    MusicSearch mSearch;    // Evaluates search queries in the background.
+    std::string mQuery;     // Search query typed by the player
+
+    ChartPreloader &mPreloader; // Preloads the chart the player rests on.
 
     ////    Style elements    /////////////////////////////////////////
 
@@ -32,6 +43,7 @@ private:
     point2f const mSno; // Selected element notecharter text offset
     point2f const mSdo; // Selected element difficulty text offset
     point2f const mSbo; // Selected element tempo(BPM) text offset
+    point2f const mSqo; // Search query text offset
 
     clan::Font mAaf, mIaf;  // List artist font
     clan::Font mAtf, mItf;  // List title font
@@ -54,11 +66,26 @@ private:
 
     int mCindex;    // Selected chart level/index
 
+    /** Gets the music record at a list position; nullptr for the random element. */
+    MusicLibrary::MusicRecord const * at(int position) const;
+
+    /** Submits the search query; lists the whole library if it is empty. */
+    void search();
+
+    /** Replaces the listed music, keeping the selection where possible. */
+    void set_view(std::vector<uint32_t> const &view);
+
+    /** Requests the cover art of a music record from the art cache. */
+    void request_art(MusicLibrary::MusicRecord const &music, bool urgent);
+
     clan::Image mBGImg; // Current background image.
 
+    CoverArtCache mArt;         // Decodes and caches cover art off the UI thread.
+    int const     mArtPrefetch; // Number of elements to prefetch art for in the scroll direction.
+
 public:
     // Constructor
-    MusicSelector(clan::GUIComponent *owner, JSONReader &skin, MusicList const &list);
+    MusicSelector(clan::GUIComponent *owner, JSONReader &skin, MusicLibrary &library, ChartPreloader &preloader);
 
     Chart* get() const;
 
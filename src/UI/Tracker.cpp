@@ -1,8 +1,15 @@
 #define nothing {} while (false)
 
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
 #include "Tracker.hpp"
 #include "../Chrono.hpp"
 #include "../Chart.hpp"
+#include "../ChartCache.hpp"
+#include "../ChartData.hpp"
+#include "../AudioManager.hpp"
 #include "../Game.hpp" // Access to game config options
 
 namespace UI {
@@ -16,17 +23,11 @@ Tracker::Tracker
     , std::string const & ref_label
     , TClock            * ref_clock
 ) : clan::GUIComponent(reinterpret_cast<clan::GUIComponent *>(game), "Tracker")
-    , mJudge(judge)
-    , mRankScores(
-            { { EJRank::PERFECT, 0 }
-            , { EJRank::COOL, 0 }
-            , { EJRank::GOOD, 0 }
-            , { EJRank::BAD , 0 }
-            , { EJRank::MISS, 0 }
-            })
-    , mCombo(0), mMaxCombo(0)
+    , mSim(judge)
 
     , mChart(chart)
+    , mNotes()
+    , mMeasureNotes()
 
     , mClock(ref_clock == nullptr ? new TClock(mChart->getTempo()) : ref_clock) // #TODO Fix mClock memory leak.
     , mTime (mClock->getTTime())
@@ -37,6 +38,23 @@ Tracker::Tracker
     , mChannelList()
 
     , mIM(&game->im)
+    , mAM(&game->am)
+    , mInputs()
+
+    , mStart(sysClock::now())
+    , mFrame(0)
+    , mInputFloor(0)
+    , mRecord(nullptr)
+    , mReplay(nullptr)
+    , mReplayPos(0)
+
+    , mSimRate  (game->conf.get_if_else_set(
+            &JSONReader::getInteger, "player.sim-rate", 1000,
+            [] (long const &value) -> bool { return value == 0 || (value >= 100 && value <= 8000); }
+            ))
+    , mSimThread(nullptr)
+    , mSimRunning(false)
+    , mSimLock()
 
     , mT_Hit(   // #TODO Add this functionality into JSONReader
             this->get_canvas().get_gc(),
@@ -54,10 +72,16 @@ Tracker::Tracker
                 ))
 
     , mRenderList()
+    , mEffects()
+
+    , mDrawNotes()
+    , mDrawMarks()
+    , mDrawLanes(channels.size(), KeyStatus::OFF)
+    , mDrawWindows()
+    , mDrawTick(0)
+    , mDrawTPM(192)
+    , mDrawStopped(false)
 
-    , mAutoPlay (game->conf.get_or_set(
-            &JSONReader::getBoolean, "player.P1.autoplay", false
-            ))
     , mSpeedX   (game->conf.get_if_else_set(
             &JSONReader::getInteger, "player.P1.speedx", 1.0,
             [] (long const &value) -> bool { return value > 0.25; }
@@ -84,16 +108,18 @@ Tracker::Tracker
     //  Safely initialize channel list
     for(auto const &elem : channels)
         mChannelList.push_back( Channel
-                { elem.key, elem.code
-                , nullptr, clan::Sprite { canvas }
+                { elem.key, elem.codes
+                , clan::Sprite { canvas }
                 , clan::Colorf { 1.0f, 1.0f, 1.0f, 0.1f }
                 });
 
-    for(auto &elem : mChannelList)
+    for(size_t i = 0; i < mChannelList.size(); i++)
     {
-        //  #HACK Bind mapping
-        mIM->try_lock    (elem.code);
-        mIM->try_unlock  (elem.code);
+        Channel &elem = mChannelList[i];
+
+        //  Bind keys to the channel's lane
+        for(KeyCode const &code : elem.codes)
+            mIM->bind_lane(code, i);
 
         //  Create sprites
         elem.sprHit.add_gridclipped_frames(canvas, mT_Hit, 0, 0, 256, 256, 4, 3, 0, 0, 0);
@@ -129,13 +155,27 @@ Tracker::Tracker
 
     ////    Setup note chart
 
-    //  Calculate judgement timing
-    mJudge.calculateTiming(mClock->getTempo_mspt());
-
-    //  Initialize notes :: Calculate tick values for notes.
+    //  Index notes in the order the chart compiles them.
     for(Measure* measure : mChart->getSequence())
+    {
+        mMeasureNotes.push_back(mNotes.size());
         for(Note* note : measure->getNotes())
-            note->init(*this);
+            mNotes.push_back(note);
+    }
+    mMeasureNotes.push_back(mNotes.size());
+
+    std::vector<uint8_t> lanes;
+    for(Channel const &elem : mChannelList)
+        lanes.push_back(static_cast<uint8_t>(elem.key));
+
+    ChartData::Data data;
+    mChart->compile(data);
+
+    mSim.setListener([this] (Simulation::Outcome const &outcome) { on_outcome(outcome); });
+    mSim.setAutoplay(game->conf.get_or_set(
+            &JSONReader::getBoolean, "player.P1.autoplay", false
+            ));
+    mSim.load(data.view(), lanes);
 }
 
 
@@ -147,7 +187,7 @@ long Tracker::compare_ticks(TTime const &a, TTime const &z) const
 point2i Tracker::translate(ENKey const &ref, long const &time) const
 {
     int x = -1;
-    int y = time - mCurrentTick;
+    int y = time - mDrawTick;
 
     ChannelList::const_iterator it = mChannelList.cbegin();
     for(int i=0; it != mChannelList.cend(); it++, i++)
@@ -187,13 +227,33 @@ inline float gfx_pop_func(float x) { return sin( powf(2.0f * M_PI * x, 1.0f / 2.
 
 void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
 {
-    update();
+    sysTimeP const now = sysClock::now();
+    bool ended;
+
+    {
+        std::lock_guard<std::mutex> lock(mSimLock);
+
+        // Step once every frame if there is no thread to do it.
+        if (mSimThread == nullptr)
+            update(now);
+
+        snapshot(now);
+        ended = mChartEnded;
+    }
+
+    if (ended) {
+        // Wait for all sounds to stop
+        // Wait for other players to finish playing
+        stop();
+        exit_with_code(0);
+        return;
+    }
 
     float z = get_height();
-    float p = z - mSpeedX * (mJudge.cgetTP());
-    float c = z - mSpeedX * (mJudge.cgetTP() + mJudge.cgetTC());
-    float g = z - mSpeedX * (mJudge.cgetTP() + mJudge.cgetTC() + mJudge.cgetTG());
-    float b = z - mSpeedX * (mJudge.cgetTP() + mJudge.cgetTC() + mJudge.cgetTG() + mJudge.cgetTB());
+    float p = z - mSpeedX * mDrawWindows[0];
+    float c = z - mSpeedX * mDrawWindows[1];
+    float g = z - mSpeedX * mDrawWindows[2];
+    float b = z - mSpeedX * mDrawWindows[3];
 
     //  Draw background.
     canvas.fill_rect({0, 0, 168, z}, { 1.0f, 1.0f, 1.0f, 0.1f });
@@ -204,7 +264,7 @@ void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
     canvas.fill_rect({0, g, 168, c}, { 0.5f, 1.0f, 0.0f, 0.1f });
     canvas.fill_rect({0, b, 168, g}, { 1.0f, 0.5f, 0.0f, 0.1f });
 
-    if (mClock->isTStopped())
+    if (mDrawStopped)
     {   //  Invert chart area.
         canvas.mult_scale       (1.f, -1.f, 1.f);
         canvas.push_translate   (0.f, -static_cast<float>(get_height()), 0.f);
@@ -217,25 +277,23 @@ void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
     canvas.push_cliprect( recti { 0, get_geometry().top, get_geometry().get_size() } );
 
     //  Render beat markers
-    for(TTime const &mark : mBeatMarks)
+    for(DrawMark const &mark : mDrawMarks)
     {
-        int p = mChart->compare_ticks(mTime, mark) * mSpeedX;
+        int p = (mark.tick - mDrawTick) * mSpeedX;
         p = get_height() - p;
 
         if (p < 0 || p > get_height()) continue;
 
         canvas.draw_line(
-                0, p, 168, p, (mark.beat == 0)
+                0, p, 168, p, mark.measure
                 ? clan::Colorf(.8f, .8f, .8f) // Measure mark
                 : clan::Colorf(.4f, .4f, .4f) // Beat mark
                 );
     }
 
     //  Render notes
-    for(Note *note : mRenderList)
-        note->render(*this, canvas);
-
-    mRenderList.clear();
+    for(DrawNote const &draw : mDrawNotes)
+        draw.note->render(*this, canvas, draw.state);
 
     //  Stop clipping
     canvas.pop_cliprect();
@@ -255,7 +313,7 @@ void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
 
             point2f pos (pair.first.x, pair.first.y);
 
-            float z = static_cast<float>(mCurrentTick - pos.y) / static_cast<float>(mClock->getTicksPerMeasure() / 2);
+            float z = static_cast<float>(mDrawTick - pos.y) / static_cast<float>(mDrawTPM / 2);
             if (z > 1.0f) { //  Remove if pop-up finished
                 cl_NRL.push_back(pair.first);
                 continue;
@@ -279,7 +337,7 @@ void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
         rLane.top       = 0;
         rLane.bottom    = get_height();
 
-        if (mIM->isOn(elem.code))
+        if (mDrawLanes[&elem - mChannelList.data()] != KeyStatus::OFF)
             canvas.fill_rect(rLane, elem.clrLaneKeyOn);
 
         rLane.top       = get_height();
@@ -293,21 +351,323 @@ void Tracker::render(clan::Canvas& canvas, const recti& clip_rect)
 }
 
 
-void Tracker::start() { mClock->start(); }
+void Tracker::snapshot(sysTimeP const &now)
+{
+    // Move the latest step forward to the time of the frame.
+    mDrawTick    = mChartEnded ? mCurrentTick : tick_at(now);
+    mDrawTPM     = mClock->getTicksPerMeasure();
+    mDrawStopped = mClock->isTStopped();
+
+    // The judge windows are real time; find how far ahead they reach.
+    Judge   const &judge = mSim.getJudge();
+    int64_t const  time  = mChartEnded ? mSim.getTime() : elapsed(now);
+    double  const  tick  = mSim.tick_at(time);
+    long    const  edges[4] = {
+        judge.cgetTP(),
+        judge.cgetTP() + judge.cgetTC(),
+        judge.cgetTP() + judge.cgetTC() + judge.cgetTG(),
+        judge.cgetTP() + judge.cgetTC() + judge.cgetTG() + judge.cgetTB()
+    };
+
+    for(int i = 0; i < 4; i++)
+        mDrawWindows[i] = mSim.tick_at(time + edges[i]) - tick;
+
+    mDrawNotes.clear();
+    for(uint32_t const &index : mRenderList)
+        mDrawNotes.push_back(DrawNote { mNotes[index], mSim.getNote(index) });
+
+    mDrawMarks.clear();
+    for(TTime const &mark : mBeatMarks)
+        mDrawMarks.push_back(DrawMark { mChart->compare_ticks(TTime(), mark), mark.beat == 0 });
+
+    for(size_t i = 0; i < mDrawLanes.size(); i++)
+        mDrawLanes[i] = mSim.getLaneStatus(i);
+
+    for(Effect const &effect : mEffects)
+    {
+        Channel &elem = mChannelList[effect.lane];
+        mNoteRankList[ point2i(getNotePoint(elem.key, 0).x, effect.tick) ] = effect.rank;
+
+        if (effect.rank != MISS && effect.rank != BAD)
+            elem.sprHit.restart();
+    }
+    mEffects.clear();
+}
+
+
+Tracker::~Tracker()
+{
+    stop();
+    mIM->unbind_lanes();
+}
+
+void Tracker::setRecord(Replay *replay)
+{
+    mRecord = replay;
+}
 
-void Tracker::update()
+void Tracker::setReplay(Replay const *replay)
 {
-    mClock->update();
-    mCurrentTick = mChart->compare_ticks(TTime(), mTime);
+    mReplay = replay;
+
+    if (mReplay != nullptr) {
+        mSim.setAutoplay(mReplay->getInfo().autoplay);
+        mSpeedX = mReplay->getInfo().speedx;
+    }
+}
+
+void Tracker::start(sysTimeP const &now)
+{
+    stop();
+
+    // Drop whatever was pressed before the chart started.
+    mIM->clear_events();
+    mInputs.clear();
+    mSim.reset();
+
+    mStart      = now;
+    mFrame      = 0;
+    mInputFloor = 0;
+    mReplayPos  = 0;
+
+    if (mRecord != nullptr)
+    {
+        Replay::Info &info = mRecord->getInfo();
+        info.source   = mChart->getSourcePath();
+        info.index    = mChart->getSourceIndex();
+        info.judge[0] = mSim.getJudge().cgetRP();
+        info.judge[1] = mSim.getJudge().cgetRC();
+        info.judge[2] = mSim.getJudge().cgetRG();
+        info.judge[3] = mSim.getJudge().cgetRB();
+        info.speedx   = mSpeedX;
+        info.autoplay = mSim.isAutoplay();
+
+        if (ChartCache::hash(*mChart, info.hash) == false)
+            info.hash = 0;
+
+        mRecord->clear();
+    }
+
+    mClock->start(now);
+
+    if (mSimRate > 0)
+    {
+        mSimRunning.store(true);
+        mSimThread = new std::thread(&Tracker::run, this);
+    }
+}
+
+void Tracker::stop()
+{
+    if (mSimThread == nullptr)
+        return;
+
+    mSimRunning.store(false);
+    mSimThread->join();
+    delete mSimThread;
+    mSimThread = nullptr;
+}
+
+void Tracker::run()
+{
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), "Tracker");
+#endif
+
+    sysClock::duration const step = std::chrono::duration_cast<sysClock::duration>(
+            std::chrono::microseconds(1000000 / mSimRate)
+            );
+
+    sysTimeP next = sysClock::now();
+
+    while(mSimRunning.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSimLock);
+
+            if (mChartEnded)
+                return;
+
+            update(sysClock::now());
+        }
+
+        // Skip the steps that were missed rather than rush through them.
+        next += step;
+        sysTimeP const now = sysClock::now();
+        if (next < now)
+            next = now;
+
+        std::this_thread::sleep_until(next);
+    }
+}
+
+uint64_t Tracker::elapsed(sysTimeP const &time) const
+{
+    if (time <= mStart)
+        return 0;
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - mStart).count();
+}
+
+sysTimeP Tracker::stamp(uint64_t const &time) const
+{
+    return mStart + std::chrono::duration_cast<sysClock::duration>(std::chrono::microseconds(time));
+}
+
+long Tracker::tick_at(sysTimeP const &time) const
+{
+    return lround(mSim.tick_at(elapsed(time)));
+}
 
+void Tracker::on_outcome(Simulation::Outcome const &outcome)
+{
+    Note const *note = (outcome.note != Simulation::kNoNote) ? mNotes[outcome.note] : nullptr;
+
+    InputManager::KeySound sound;
+    if (note != nullptr)
+        note->getHitSound(sound.sample, sound.vol, sound.pan);
+
+    switch(outcome.type)
+    {
+        case Simulation::Outcome::Type::PLAY:
+            mAM->play(sound.sample, ENKey_toInteger(note->getKey()), sound.vol, sound.pan);
+            break;
+
+        case Simulation::Outcome::Type::HIT:
+            if (Note::hitsounds)
+                mAM->play(sound.sample, ENKey_isPlayer1(note->getKey()) ? 1 : 2, sound.vol, sound.pan);
+            break;
+
+        case Simulation::Outcome::Type::FOCUS:
+            // Let the input poller play the note's sound on a hit.
+            if (note != nullptr) {
+                sound.track = ENKey_isPlayer1(note->getKey()) ? 1 : 2;
+                mIM->set_sound(outcome.lane, sound);
+            } else {
+                mIM->clear_sound(outcome.lane);
+            }
+            break;
+
+        case Simulation::Outcome::Type::SCORE:
+        case Simulation::Outcome::Type::AUTO:
+            {
+                EJRank const rank = (outcome.type == Simulation::Outcome::Type::AUTO)
+                    ? EJRank::AUTO : mSim.getNote(outcome.note).score.rank;
+
+                // Shown by the next frame.
+                mEffects.push_back(Effect { outcome.lane, rank, mSim.getTick() });
+            }
+            break;
+    }
+}
+
+KeyStatus Tracker::getStatus(Channel const &elem) const
+{
+    return mSim.getLaneStatus(&elem - mChannelList.data());
+}
+
+bool Tracker::isHeld(Channel const &elem) const
+{
+    for(KeyCode const &code : elem.codes)
+        if (mIM->isOn(code))
+            return true;
+
+    return false;
+}
+
+void Tracker::process_events(sysTimeP const &now)
+{
+    InputManager::KeyEvent event;
+
+    if (mReplay != nullptr)
+    {
+        // Player input is ignored while a replay plays.
+        while(mIM->pop_event(event))
+            continue;
+
+        play_events(now);
+        return;
+    }
+
+    while(mIM->pop_event(event))
+    {
+        uint8_t const lane = mIM->getLane(event.code);
+        if (lane >= mChannelList.size())
+            continue;
+
+        // Releasing one key does not release the channel while another
+        // of its keys is held down.
+        if (event.down == false && isHeld(mChannelList[lane]))
+            continue;
+
+        // Judge at the time stamp as recorded, so that the replay
+        // judges the same. Events that arrive late, or from another
+        // device, are kept between the last frame and this one so that
+        // they stay in order.
+        uint64_t const time = std::min(std::max(elapsed(event.time), mInputFloor), mFrame);
+        mInputFloor = time;
+
+        if (mRecord != nullptr)
+            mRecord->push(event.down ? Replay::Type::PRESS : Replay::Type::RELEASE, time, lane);
+
+        mInputs.push_back(Simulation::Input { static_cast<int64_t>(time), lane, event.down });
+
+        if (event.down)
+            mIM->try_lock(event.code);
+    }
+}
+
+void Tracker::play_events(sysTimeP const &now)
+{
+    std::vector<Replay::Event> const &events = mReplay->getEvents();
+    uint64_t const until = elapsed(now);
+
+    while(mReplayPos < events.size())
+    {
+        Replay::Event const &event = events[mReplayPos];
+
+        if (event.time > until)
+            break;
+
+        mReplayPos += 1;
+
+        switch(event.type)
+        {
+            case Replay::Type::PRESS:
+            case Replay::Type::RELEASE:
+                if (event.lane < mChannelList.size())
+                    mInputs.push_back(Simulation::Input {
+                            static_cast<int64_t>(event.time), event.lane, event.type == Replay::Type::PRESS
+                            });
+                break;
+
+            case Replay::Type::FRAME:
+                // Step at the recorded frame times, so that the notes are
+                // judged as they were while recording.
+                mSim.update(static_cast<int64_t>(event.time), mInputs);
+                mInputs.clear();
+                break;
+
+            case Replay::Type::AUTOPLAY:
+                // Recorded right after the frame it was toggled on.
+                mSim.setAutoplay(!mSim.isAutoplay());
+                break;
+        }
+    }
+}
+
+void Tracker::update(sysTimeP const &time)
+{
+    // Round the frame time to the time stamps a replay keeps.
+    mFrame = elapsed(time);
+    sysTimeP const now = stamp(mFrame);
+
+    mClock->update(now);
+
+    // The frame that sees this ends the chart.
     if (mTime.measure > mChart->getMeasures()) {
         mChartEnded = true;
-        if (true && true) {
-            // Wait for all sounds to stop
-            // Wait for other players to finish playing
-            exit_with_code(0);
-            return;
-        }
+        return;
     }
 
     if (mChartEnded == false)
@@ -341,7 +701,7 @@ void Tracker::update()
 
 
             loop_Params(measure->getParams());
-            loop_Notes (measure->getNotes (), cache);
+            loop_Notes (index, cache);
 
             index += 1;
         } while (count <= (192 * 2));
@@ -349,41 +709,23 @@ void Tracker::update()
         mMeasureIterStart = cache;
     }
 
-    //  Update notes with player input
-    for(auto &elem : mChannelList)
-    {
-        // No note in focus.
-        if (elem.note == nullptr) continue;
+    //  Judge notes against player input, in the order it came in
+    process_events(now);
 
-        // Update note.
-        elem.note->update(*this, mIM->getKey(elem.code));
-        if (elem.note->isScored())
-        {
-            // Update scoring statistics
-            JScore score = elem.note->getScore();
-            mRankScores  [ score.rank ] += 1;
-            mNoteRankList[ point2i(getNotePoint(elem.note->getKey(), 0).x, mCurrentTick) ] = score.rank;
-
-            if (score.rank != MISS && score.rank != BAD) {
-                mCombo += 1;
-                elem.sprHit.restart();
-            } else {
-                mCombo  = 0;
-            }
+    // The frame is recorded after the key events it takes in, which are
+    // never stamped later than it.
+    if (mRecord != nullptr)
+        mRecord->push(Replay::Type::FRAME, mFrame);
 
-            // Remove from focus.
-            elem.note = nullptr;
-        }
-    }
+    mInputFloor = mFrame;
 
-    // Lock pressed keys whether or not the player hit a note.
-    for(auto &elem : mChannelList) {
-        if (mIM->isOn(elem.code))
-            mIM->try_lock(elem.code);
+    // Replays step the simulation at their own frames.
+    if (mReplay == nullptr) {
+        mSim.update(mFrame, mInputs);
+        mInputs.clear();
     }
 
-    // Calculate max combo
-    mMaxCombo = std::max(mCombo, mMaxCombo);
+    mCurrentTick = mSim.getTick();
 
     // Process auxiliary input commands
     process_input();
@@ -400,14 +742,17 @@ void Tracker::loop_Params(ParamEventList &params)
             switch(param->param)
             {
                 case EParam::EP_C_TEMPO :
-                    // Update tempo
+                    // Update tempo; the simulation times notes from the tempo map itself.
                     mClock->setTempo(param->value.asFloat);
-                    mJudge.calculateTiming(mClock->getTempo_mspt());
                     break;
                 case EParam::EP_C_STOP_T :
                     // Set tick-time pause
                     mClock->setTStop(param->value.asInt);
                     break;
+                case EParam::EP_C_STOP_R :
+                    // Set real-time pause; the value is in seconds.
+                    mClock->setRStop(param->value.asFloat * 1000.0);
+                    break;
                 default:
                     printf("[warn] param event type not handled.\n");
                     break;
@@ -424,58 +769,31 @@ void Tracker::loop_Params(ParamEventList &params)
     }
 }
 
-void Tracker::loop_Notes(NoteList &notes, uint &cache)
+void Tracker::loop_Notes(uint measure, uint &cache)
 {
-    for(Note* note : notes)
+    if (measure + 1 >= mMeasureNotes.size())
+        return;
+
+    for(uint32_t i = mMeasureNotes[measure]; i < mMeasureNotes[measure + 1]; i++)
     {
-        if (note->isDead() == false)
+        if (mSim.getNote(i).dead == false)
         {
             // Keep measure active
-            if (cache > note->getTime().measure)
-                cache = note->getTime().measure;
+            if (cache > measure)
+                cache = measure;
 
             // Render it.
-            mRenderList.push_back(note);
-
-            if (note->isScored() == false)
-            {
-                ChannelList::iterator chIter = std::find_if(
-                        mChannelList.begin(), mChannelList.end(),
-                        [&] (Channel const &ch) -> bool {
-                            return ch.key == note->getKey();
-                        });
-
-                if (
-                // It's in autoplay channel or background channel.
-                    ENKey_isAutoPlay(note->getKey())
-                // It's not on the list of selected keys.
-                    ||  chIter == mChannelList.end()
-                // AutoPlay is turned on
-                    ||  mAutoPlay
-                ) {
-                    if (note->getTime() <= mTime) {
-                        note->update(*this, KeyStatus::AUTO);
-
-                        // Show note hit effect
-                        if (chIter != mChannelList.end() && note->isDead()) {
-                            mNoteRankList[ point2i(getNotePoint(note->getKey(), 0).x, mCurrentTick) ] = EJRank::AUTO;
-                            chIter->sprHit.restart();
-                        }
-                    }
-                } else if ( chIter->note == nullptr ) {
-                    chIter->note = note;
-                }
-            } else {
-                // Make note do whatever it needs to die.
-                note->update(*this, KeyStatus::OFF);
-            }
+            mRenderList.push_back(i);
         } // ELSE IGNORE THE DEAD
     }
 }
 
 void Tracker::process_input() {
-    if (mIM->try_lock(clan::InputCode::keycode_f11)) {
-        mAutoPlay = !mAutoPlay;
+    if (mIM->try_lock(clan::InputCode::keycode_f11) && mReplay == nullptr) {
+        mSim.setAutoplay(!mSim.isAutoplay());
+
+        if (mRecord != nullptr)
+            mRecord->push(Replay::Type::AUTOPLAY, mFrame);
     }
 }
 
@@ -4,9 +4,15 @@
 #ifndef NOTE_TRACKER_H
 #define NOTE_TRACKER_H
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 #include "../__zzCore.hpp"
 #include "../InputManager.hpp"
 #include "../Judge.hpp"
+#include "../Replay.hpp"
+#include "../Simulation.hpp"
 
 #include "../Note.hh"
 #include "../ParamEvent.hpp"
@@ -14,29 +20,32 @@
 class TClock;
 class Chart;
 class Game;
+class AudioManager;
 
 namespace UI {
 
-/** Game <-> Note interaction interface */
+/** Game <-> Note interaction interface
+ *
+ * The tracker steps the chart clock and the simulation at a fixed rate on
+ * a thread of its own, driven by the song clock, so that judgement and
+ * autoplay sounds do not wait for frames. Every frame draws a snapshot of
+ * the latest step, moved forward to the time of the frame.
+ */
 
 class Tracker : public clan::GUIComponent
 {
 public:
-    using RankScoreMap  = std::map< EJRank, int >;
     using KeyCode       = InputManager::KeyCode;
 
     /** Operational context for note lanes / keys.
      *
-     * #TODO Allow multiple input codes.
      * #TODO Put KeyStatus here and ditch InputManager.
      * #TODO Allow indiviudal key theming. (maybe put this into a separate model?)
      */
     struct Channel
     {
-        ENKey       key;    //! Note channel key
-        KeyCode     code;   //! Player input key code
-
-        Note      * note;   //! Currently focused note.
+        ENKey                   key;    //! Note channel key
+        std::vector<KeyCode>    codes;  //! Player input key codes
 
         ////    Graphical state variables    ///////////////////////////
         clan::Sprite    sprHit;         //! Note hit effect sprite
@@ -44,7 +53,7 @@ public:
     };
 
     //! Channel object container type
-    using ChannelList   = std::list < Channel >;
+    using ChannelList   = std::vector < Channel >;
 
     //! Channel popping ranking
     using I_NoteRank    = std::map  < point2i, EJRank >;
@@ -54,15 +63,15 @@ public:
 
 private:
     ////    Judgement and Scoring    ///////////////////////////////////
-    Judge           mJudge;
-
-    RankScoreMap    mRankScores;
-    uint            mCombo, mMaxCombo;
+    Simulation      mSim;
 
 
     ////    Chart    ///////////////////////////////////////////////////
     Chart*          mChart;
 
+    std::vector<Note*>      mNotes;         //! Notes in the order the simulation knows them
+    std::vector<uint32_t>   mMeasureNotes;  //! Index of the first note of every measure
+
 
     ////    Clocks and Timing    ///////////////////////////////////////
     TClock      *   mClock;
@@ -76,8 +85,28 @@ private:
     ////    Note Lane Channeling    ////////////////////////////////////
     ChannelList     mChannelList;
 
-    ////    Input Manager    ///////////////////////////////////////////
+    ////    Input and Audio    /////////////////////////////////////////
     InputManager*   mIM;
+    AudioManager*   mAM;
+
+    std::vector<Simulation::Input>  mInputs;    //! Key changes for the next simulation update
+
+
+    ////    Replays    /////////////////////////////////////////////////
+    sysTimeP        mStart;         //! Time the chart was started at
+    uint64_t        mFrame;         //! Microseconds from start to the current frame
+    uint64_t        mInputFloor;    //! Earliest time the next key event is judged at
+
+    Replay        * mRecord;        //! Replay to record to; null if not recording
+    Replay const  * mReplay;        //! Replay to play back; null if playing live
+    size_t          mReplayPos;     //! Next replay event to play back
+
+
+    ////    Simulation Thread    ///////////////////////////////////////
+    unsigned            mSimRate;       //! Steps per second; 0 to step once every frame
+    std::thread       * mSimThread;
+    std::atomic<bool>   mSimRunning;
+    std::mutex          mSimLock;       //! Guards the stepped state against the renderer
 
 
     ////    Graphics    ///////////////////////////////////////////////
@@ -85,14 +114,53 @@ private:
     clan::Texture2D     mT_Hit_Rank;
     clan::Image         mI_Hit_Rank[5];
 
-    NoteList            mRenderList;
+    std::vector<uint32_t>   mRenderList;    //! Indices of notes to draw
     I_NoteRank          mNoteRankList;
     I_BeatMark          mBeatMarks;
 
+    //! Hit effect waiting to be shown.
+    struct Effect
+    {
+        uint8_t lane;
+        EJRank  rank;
+        long    tick;
+    };
+
+    std::vector<Effect> mEffects;       //! Hit effects since the last snapshot
+
+    ////    Render Snapshot    /////////////////////////////////////////
+    struct DrawNote
+    {
+        Note const            * note;
+        Simulation::NoteState   state;
+    };
+
+    struct DrawMark
+    {
+        long    tick;
+        bool    measure;    //! Is this the first beat of a measure?
+    };
+
+    std::vector<DrawNote>   mDrawNotes;
+    std::vector<DrawMark>   mDrawMarks;
+    std::vector<KeyStatus>  mDrawLanes;     //! Key status of every channel
+    float                   mDrawWindows[4];    //! Ticks ahead to the far edge of every judge window
+    long                    mDrawTick;      //! Tick at the time of the frame
+    unsigned                mDrawTPM;       //! Ticks per measure
+    bool                    mDrawStopped;   //! Is the chart clock stopped?
+
+    //! Copies what the frame draws from the latest step.
+    void snapshot(sysTimeP const &now);
+
+    //! Steps the chart at a fixed rate until stopped.
+    void run();
+
     ////    Modifiers    ///////////////////////////////////////////////
-    bool            mAutoPlay;
     float           mSpeedX;
 
+    //! Plays sounds and effects of what happened to notes.
+    void on_outcome(Simulation::Outcome const &outcome);
+
 
 
 public:
@@ -105,9 +173,10 @@ public:
         , std::string const & ref_label = ""
         , TClock            * ref_clock = nullptr
         );
+    ~Tracker();
 
-    inline Judge   const &cgetJudge() const { return mJudge; }
-    inline Judge         & getJudge()       { return mJudge; }
+    inline Judge   const &cgetJudge() const { return mSim.getJudge(); }
+    inline Simulation const & getSimulation() const { return mSim; }
     inline TClock  const *cgetClock() const { return mClock; }
     inline TClock        * getClock()       { return mClock; }
     inline long    const & getCurrentTick() const { return mCurrentTick; }
@@ -115,7 +184,16 @@ public:
     inline float   const & getSpeedX() const { return mSpeedX; }
 
     inline void setSpeedX(float value = 1.0f) { mSpeedX = value; } // #TODO validation checks
-    inline void setAutoplay(bool value = true) { mAutoPlay = value; }
+    inline void setAutoplay(bool value = true) { mSim.setAutoplay(value); }
+
+    inline bool isEnded() const { return mChartEnded; }
+
+    //! Records the session to a replay, from the next start.
+    void setRecord(Replay *replay);
+
+    /** Plays a replay back instead of player input. Its autoplay and
+     *  speed settings are taken; the judge must be set up by the caller. */
+    void setReplay(Replay const *replay);
 
     point2i translate(ENKey const &key, long const &time) const;
 
@@ -123,11 +201,36 @@ public:
 
     // TODO Add ability to start from a different time point
 
-    void start();
-    void update();
+    /** Starts the chart, and the simulation thread unless the steps
+     *  are taken by the frames. */
+    void start(sysTimeP const &now = sysClock::now());
+    //! Stops the simulation thread; the chart stays where it is.
+    void stop();
+
+    //! Steps the chart clock and the simulation to a time point.
+    inline void update() { update(sysClock::now()); }
+    void update(sysTimeP const &now);
 
     void loop_Params(ParamEventList &params);
-    void loop_Notes (NoteList &notes, uint &cache);
+    void loop_Notes (uint measure, uint &cache);
+
+    //! Converts a time point to the chart tick it falls on.
+    long tick_at(sysTimeP const &time) const;
+
+    //! Microseconds from the start of the chart to a time point; 0 if before.
+    uint64_t elapsed(sysTimeP const &time) const;
+    //! Time point a number of microseconds after the start of the chart.
+    sysTimeP stamp  (uint64_t const &time) const;
+
+    //! Queues key events for the simulation.
+    void process_events(sysTimeP const &now);
+    //! Steps the simulation through the replay's frames and key events up to the current time.
+    void play_events   (sysTimeP const &now);
+
+    //! Status of a channel's keys, as judged.
+    KeyStatus getStatus(Channel const &elem) const;
+    //! Whether any key of a channel is being pressed down.
+    bool isHeld(Channel const &elem) const;
 
     void process_input();
 
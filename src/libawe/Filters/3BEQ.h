@@ -14,6 +14,8 @@
 
 #include "../aweFilter.h"
 #include "IIR.h"
+#include "Rack.h"
+#include <algorithm>
 #include <cassert>
 
 namespace awe {
@@ -28,9 +30,28 @@ private:
     IIR::IIR< Channels > mLP;
     IIR::IIR< Channels > mHP;
 
-    double mLG, mMG, mHG;
+    double mLG, mMG, mHG;       //  Current band gains
+    double mtLG, mtMG, mtHG;    //  Target band gains, ramped to on the next buffer
+
+    double mdLG, mdMG, mdHG;    //  Per-frame gain steps for the current buffer
+
+    bool   mqFreq;              //  Are the crossover frequencies waiting to be ramped?
+
+#ifdef AWE_USE_SSE
+    IIR::Stereo mLPs, mHPs;     //  Single precision stereo kernels, used when Channels == 2
+#endif
 
 public:
+    //! Parameters accepted by \ref set_parameter.
+    enum Param : uint32_t
+    {
+        LO_GAIN = 0,
+        MI_GAIN,
+        HI_GAIN,
+        LO_FREQ,
+        HI_FREQ
+    };
+
     TBEQ(
         double mixfreq,
         double lo_freq = 880.0,
@@ -46,6 +67,11 @@ public:
         , mLG(lo_gain)
         , mMG(mi_gain)
         , mHG(hi_gain)
+        , mtLG(lo_gain)
+        , mtMG(mi_gain)
+        , mtHG(hi_gain)
+        , mdLG(0), mdMG(0), mdHG(0)
+        , mqFreq(false)
     { }
 
 
@@ -53,6 +79,10 @@ public:
     {
         mLP.reset();
         mHP.reset();
+#ifdef AWE_USE_SSE
+        mLPs.reset();
+        mHPs.reset();
+#endif
     }
 
     inline void get_freq(double &lo_freq, double &hi_freq) const
@@ -66,6 +96,10 @@ public:
         mSF = mixfreq;
         mLP = IIR::newLPF(mSF, mLF);
         mHP = IIR::newHPF(mSF, mHF);
+#ifdef AWE_USE_SSE
+        mLPs.reset();
+        mHPs.reset();
+#endif
     }
 
     inline void set_freq(double lo_freq, double hi_freq)
@@ -84,18 +118,109 @@ public:
 
     inline void set_gain(double lo_gain, double mi_gain, double hi_gain)
     {
-        mLG = lo_gain;
-        mMG = mi_gain;
-        mHG = hi_gain;
+        mLG = mtLG = lo_gain;
+        mMG = mtMG = mi_gain;
+        mHG = mtHG = hi_gain;
+    }
+
+    /*! Smoothed parameter change. Gains ramp linearly and the crossover
+     *  filter coefficients are interpolated over the next buffer.
+     */
+    void set_parameter(uint32_t id, double value) override
+    {
+        switch(id)
+        {
+            case LO_GAIN: mtLG = value; break;
+            case MI_GAIN: mtMG = value; break;
+            case HI_GAIN: mtHG = value; break;
+            case LO_FREQ: mLF  = value; mqFreq = true; break;
+            case HI_FREQ: mHF  = value; mqFreq = true; break;
+            default: break;
+        }
+    }
+
+    //! Skips silent buffers once gain ramps are done and filter tails have decayed.
+    bool doSilence(AfBuffer &buffer) override
+    {
+        if (mqFreq == false && mLG == mtLG && mMG == mtMG && mHG == mtHG && settle())
+            return true;
+
+        doBuffer(buffer);
+        return false;
     }
 
     inline void doBuffer(AfBuffer &buffer)
     {
         assert(buffer.getChannelCount() == Channels);
 
-        for(size_t i = 0; i < buffer.getFrameCount(); i += 1)
+        //  Run tile by tile, like a fused rack does, so that the crossover
+        //  coefficients ramp across the buffer instead of jumping.
+        size_t const frames = buffer.getFrameCount();
+        size_t const tile   = AscRack::kTileFrames;
+
+        doBegin(frames);
+        for(size_t i = 0; i < frames; i += tile)
+            doFrames(buffer.data() + i * Channels, std::min(tile, frames - i));
+        doEnd();
+    }
+
+    bool is_fusable() const override { return true; }
+
+    void doBegin(size_t frames) override
+    {
+        if (mqFreq) {
+            mLP.ramp_to(IIR::newLPF(mSF, mLF), frames);
+            mHP.ramp_to(IIR::newHPF(mSF, mHF), frames);
+            mqFreq = false;
+        }
+
+        double const n = frames > 0 ? 1.0 / static_cast<double>(frames) : 0.0;
+        mdLG = (mtLG - mLG) * n;
+        mdMG = (mtMG - mMG) * n;
+        mdHG = (mtHG - mHG) * n;
+    }
+
+    void doFrames(Afloat* frames, size_t count) override
+    {
+#ifdef AWE_USE_SSE
+        if (Channels == 2)
         {
-            Afloat* f = buffer.getFrame(i);
+            mLPs.set(mLP.mB, mLP.mA);
+            mHPs.set(mHP.mB, mHP.mA);
+
+            for(size_t i = 0; i < count; i += 1)
+            {
+                Afloat* f = frames + i * 2;
+
+                mLG += mdLG;
+                mMG += mdMG;
+                mHG += mdHG;
+
+                __m128 const x = IIR::load_frame(f);
+                __m128 const L = mLPs.process(x);
+                __m128 const H = mHPs.process(x);
+                __m128 const M = _mm_sub_ps(x, _mm_add_ps(L, H));
+
+                __m128 y =            _mm_mul_ps(L, _mm_set1_ps(static_cast<float>(mLG)));
+                y = _mm_add_ps(y, _mm_mul_ps(M, _mm_set1_ps(static_cast<float>(mMG))));
+                y = _mm_add_ps(y, _mm_mul_ps(H, _mm_set1_ps(static_cast<float>(mHG))));
+
+                IIR::store_frame(f, y);
+            }
+
+            step(count);
+            return;
+        }
+#endif
+
+        for(size_t i = 0; i < count; i += 1)
+        {
+            Afloat* f = frames + i * Channels;
+
+            mLG += mdLG;
+            mMG += mdMG;
+            mHG += mdHG;
+
             for(Achan c = 0; c < Channels; c += 1)
             {
                 double L = f[c];
@@ -114,6 +239,34 @@ public:
             }
 
         }
+
+        step(count);
+    }
+
+    void doEnd() override
+    {
+        //  Land exactly on the targets.
+        mLG = mtLG;
+        mMG = mtMG;
+        mHG = mtHG;
+    }
+
+private:
+    //! Advances the crossover coefficients past a processed piece.
+    inline void step(size_t count)
+    {
+        mLP.step(count);
+        mHP.step(count);
+    }
+
+    //! Checks whether both crossover filters have decayed to silence.
+    inline bool settle()
+    {
+#ifdef AWE_USE_SSE
+        if (Channels == 2)
+            return mLP.mRamp == 0 && mHP.mRamp == 0 && mLPs.settle(1.0e-9f) && mHPs.settle(1.0e-9f);
+#endif
+        return mLP.settle() && mHP.settle();
     }
 
 };
@@ -47,11 +47,79 @@ namespace IIR
         PartialCoeffs                   mA, mB;
         std::array<DelayLine, Channels> mZ;
 
+        PartialCoeffs                   mdA, mdB;   //<! Per-frame coefficient ramp step
+        Coeffs                          mK;         //<! Ramp target coefficients
+        size_t                          mRamp;      //<! Frames left on the ramp
+
         IIR(Coeffs k) noexcept
             : mB ( { k[0], k[1], k[2] } )
             , mA ( { k[3], k[4], k[5] } )
+            , mdA( { 0, 0, 0 } )
+            , mdB( { 0, 0, 0 } )
+            , mK ( k )
+            , mRamp( 0 )
         { reset(); }
 
+        /** Moves the coefficients linearly towards a new set over the
+         *  given number of frames while keeping the delay lines intact.
+         *  Call \ref step once per frame to advance the ramp.
+         */
+        inline void ramp_to(Coeffs const & k, size_t frames) noexcept
+        {
+            mK = k;
+
+            if (frames == 0) {
+                mB = { k[0], k[1], k[2] };
+                mA = { k[3], k[4], k[5] };
+                mRamp = 0;
+                return;
+            }
+
+            for(size_t i = 0; i < 3; i += 1) {
+                mdB[i] = (k[i    ] - mB[i]) / static_cast<double>(frames);
+                mdA[i] = (k[i + 3] - mA[i]) / static_cast<double>(frames);
+            }
+
+            mRamp = frames;
+        }
+
+        /** Checks whether the filter would output silence on silent input.
+         *  Delay lines below the threshold are flushed to zero.
+         */
+        inline bool settle(double threshold = 1.0e-9) noexcept
+        {
+            if (mRamp != 0)
+                return false;
+
+            for(DelayLine const & z : mZ)
+                for(double const & v : z)
+                    if (v > threshold || v < -threshold)
+                        return false;
+
+            reset();
+            return true;
+        }
+
+        /// Advances the coefficient ramp by the given number of frames.
+        inline void step(size_t frames = 1) noexcept
+        {
+            if (mRamp == 0)
+                return;
+
+            if (frames >= mRamp) {
+                mB = { mK[0], mK[1], mK[2] };
+                mA = { mK[3], mK[4], mK[5] };
+                mRamp = 0;
+            } else {
+                double const n = static_cast<double>(frames);
+                for(size_t i = 0; i < 3; i += 1) {
+                    mB[i] += mdB[i] * n;
+                    mA[i] += mdA[i] * n;
+                }
+                mRamp -= frames;
+            }
+        }
+
         /// Resets the filter's processing state.
         inline void reset() noexcept
         {
@@ -81,6 +149,69 @@ namespace IIR
 
     };
 
+#ifdef AWE_USE_SSE
+    /**
+     * Stereo biquad kernel in single precision.
+     *
+     * Both channels are kept in the lower half of one SSE vector so a
+     * stereo frame is filtered with a single set of vector operations.
+     * Uses the same transposed direct form II as process_one().
+     */
+    struct Stereo
+    {
+        __m128 b0, b1, b2, a1, a2;  //<! Broadcast coefficients
+        __m128 z0, z1;              //<! Delay line, one channel per lane
+
+        Stereo() noexcept { reset(); set(PartialCoeffs{{ 1, 0, 0 }}, PartialCoeffs{{ 1, 0, 0 }}); }
+
+        inline void reset() noexcept { z0 = z1 = _mm_setzero_ps(); }
+
+        /// Loads coefficients from a (possibly ramping) double-precision filter.
+        inline void set(PartialCoeffs const & b, PartialCoeffs const & a) noexcept
+        {
+            b0 = _mm_set1_ps(static_cast<float>(b[0]));
+            b1 = _mm_set1_ps(static_cast<float>(b[1]));
+            b2 = _mm_set1_ps(static_cast<float>(b[2]));
+            a1 = _mm_set1_ps(static_cast<float>(a[1]));
+            a2 = _mm_set1_ps(static_cast<float>(a[2]));
+        }
+
+        /// Checks whether the delay line has decayed below the threshold, flushing it if so.
+        inline bool settle(float threshold) noexcept
+        {
+            __m128 const t = _mm_set1_ps(threshold);
+            __m128 const m = _mm_set1_ps(-0.0f);
+            __m128 const z = _mm_max_ps(_mm_andnot_ps(m, z0), _mm_andnot_ps(m, z1));
+
+            if (_mm_movemask_ps(_mm_cmpgt_ps(z, t)) != 0)
+                return false;
+
+            reset();
+            return true;
+        }
+
+        inline __m128 process(__m128 const x) noexcept
+        {
+            __m128 const y = _mm_add_ps(_mm_mul_ps(b0, x), z0);
+            z0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z1);
+            z1 =            _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            return y;
+        }
+    };
+
+    /// Loads a stereo frame into the lower half of a vector.
+    inline __m128 load_frame(Afloat const * f) noexcept
+    {
+        return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<double const *>(f)));
+    }
+
+    /// Stores the lower half of a vector as a stereo frame.
+    inline void store_frame(Afloat * f, __m128 const v) noexcept
+    {
+        _mm_store_sd(reinterpret_cast<double *>(f), _mm_castps_pd(v));
+    }
+#endif
+
 };
 
 }
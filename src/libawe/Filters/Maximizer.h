@@ -5,6 +5,7 @@
 #define AWE_FILTER_MAXIMIZER_H
 
 #include "../aweFilter.h"
+#include <vector>
 
 namespace awe {
 namespace Filter {
@@ -15,6 +16,18 @@ namespace Filter {
  *  limiter, which limits the audio signal to the specified loudness threshold.
  *  The limiter release is softened as it falls back under the threshold to
  *  reduce the harsh-sounding effect on plain hard-clipping filters.
+ *
+ *  In look-ahead mode (see \ref setLookAhead) the signal is delayed so the
+ *  gain can be brought down before a peak arrives instead of clipping it:
+ *
+ *   - the gain needed for each frame is passed through a sliding-window
+ *     minimum spanning the delay, kept in a monotonic deque;
+ *   - gain recovery follows an exponential release;
+ *   - a moving average over the attack time smooths the gain reduction,
+ *     which is guaranteed to have reached the needed gain by the time the
+ *     peak leaves the delay line;
+ *   - peaks may optionally be measured between samples by a 4x
+ *     oversampling interpolator (true-peak detection).
  */
 template< const Achan Channels >
 class Maximizer : public Afilter< Channels >
@@ -34,6 +47,44 @@ private:
     ////    Metering attributes    ////
     Afloat      mPeakSample;    //<! Peak sample on last update
 
+    ////    Look-ahead mode    ////
+    static constexpr size_t kTPTaps   = 8;  //!< True-peak interpolator taps
+    static constexpr size_t kTPPhases = 4;  //!< True-peak oversampling factor
+    static constexpr double kReleaseSnap = 1.0e-6;  //!< Release gap snapped shut; the envelope stalls short of it
+
+    //! Gain request with the frame it was made on, for the sliding minimum.
+    struct Request
+    {
+        Afloat  gain;
+        size_t  frame;
+    };
+
+    bool                mLookAhead;     //!< Is look-ahead mode enabled?
+    bool                mTruePeak;      //!< Detect inter-sample peaks?
+
+    size_t              mDelay;         //!< Delay line length in frames
+    size_t              mAttack;        //!< Attack smoothing length in frames
+    double              mReleaseCoef;   //!< Per-frame release coefficient
+
+    size_t              mFrame;         //!< Frames processed so far
+    size_t              mQuiet;         //!< Consecutive silent input frames
+
+    std::vector<Afloat> mDelayLine;     //!< Delayed frames, mDelay * Channels
+    size_t              mDelayPos;
+
+    std::vector<Request> mWindow;       //!< Monotonic deque for the sliding minimum
+    size_t              mWindowHead, mWindowSize;
+
+    std::vector<Afloat> mSmooth;        //!< Attack moving-average ring
+    size_t              mSmoothPos;
+    double              mSmoothSum;
+
+    double              mRelease;       //!< Released gain, before smoothing
+
+    std::array<std::array<Afloat, kTPTaps>, kTPPhases>  mTPKernel;
+    std::vector<Afloat> mTPHistory;     //!< Last kTPTaps samples of every channel
+    size_t              mTPPos;
+
 private:
     /** Decay rate calculator.
      *
@@ -62,6 +113,20 @@ public:
         , mDecayRate    (0.0f)
         , mGain         (1.0f)
         , mPeakSample   (0.0f)
+        , mLookAhead    (false)
+        , mTruePeak     (false)
+        , mDelay        (0)
+        , mAttack       (0)
+        , mReleaseCoef  (0.0)
+        , mFrame        (0)
+        , mQuiet        (0)
+        , mDelayPos     (0)
+        , mWindowHead   (0)
+        , mWindowSize   (0)
+        , mSmoothPos    (0)
+        , mSmoothSum    (0.0)
+        , mRelease      (1.0)
+        , mTPPos        (0)
     { }
 
     //! Resets the limiter state in the maximizer.
@@ -69,8 +134,82 @@ public:
         mDecayRate  = 0.0f;
         mGain       = 1.0f;
         mPeakSample = 0.0f;
+
+        mFrame      = 0;
+        mQuiet      = 0;
+        mDelayPos   = 0;
+        mWindowHead = 0;
+        mWindowSize = 0;
+        mSmoothPos  = 0;
+        mSmoothSum  = static_cast<double>(mSmooth.size());
+        mRelease    = 1.0;
+        mTPPos      = 0;
+
+        std::fill(mDelayLine.begin(), mDelayLine.end(), 0.0f);
+        std::fill(mSmooth   .begin(), mSmooth   .end(), 1.0f);
+        std::fill(mTPHistory.begin(), mTPHistory.end(), 0.0f);
+    }
+
+    /** Switches the maximizer to look-ahead mode.
+     *
+     *  Allocates the delay lines; call this before the filter is put on a
+     *  rack. The output is delayed by the look-ahead time, plus half the
+     *  interpolator length if true-peak detection is enabled.
+     *
+     *  \param sample_rate  sampling rate of the processed signal
+     *  \param lookahead_ms look-ahead (delay) time in milliseconds
+     *  \param attack_ms    attack smoothing time, clamped to the look-ahead
+     *  \param release_ms   time for the gain to recover by ~63%
+     *  \param true_peak    measure peaks between samples
+     */
+    void setLookAhead(
+            unsigned sample_rate,
+            Afloat   lookahead_ms,
+            Afloat   attack_ms,
+            Afloat   release_ms,
+            bool     true_peak
+    ) {
+        Afloat const f = static_cast<Afloat>(sample_rate) / 1000.0f;
+
+        mLookAhead  = true;
+        mTruePeak   = true_peak;
+
+        size_t const lookahead = std::max<size_t>(1, static_cast<size_t>(lookahead_ms * f));
+        mAttack     = std::min(lookahead, std::max<size_t>(1, static_cast<size_t>(attack_ms * f)));
+        mDelay      = lookahead + (true_peak ? kTPTaps / 2 : 0);
+        mReleaseCoef= 1.0 - std::exp(-1.0 / std::max(1.0, static_cast<double>(release_ms * f)));
+
+        mDelayLine.assign(mDelay * Channels, 0.0f);
+        mWindow   .assign(mDelay + 2, Request { 1.0f, 0 });
+        mSmooth   .assign(mAttack, 1.0f);
+        mTPHistory.assign(kTPTaps * Channels, 0.0f);
+
+        //  Windowed-sinc interpolator; phase p estimates the signal p/4 of a
+        //  frame after the centre of the history.
+        for(size_t p = 0; p < kTPPhases; p += 1)
+        {
+            Afloat sum = 0.0f;
+            for(size_t k = 0; k < kTPTaps; k += 1)
+            {
+                double const d = static_cast<double>(k) - (kTPTaps / 2 - 1) - static_cast<double>(p) / kTPPhases;
+                double const s = (d == 0.0) ? 1.0 : std::sin(M_PI * d) / (M_PI * d);
+                double const w = 0.5 + 0.5 * std::cos(M_PI * d / (kTPTaps / 2 + 1));
+                mTPKernel[p][k] = static_cast<Afloat>(s * w);
+                sum += mTPKernel[p][k];
+            }
+            for(Afloat &k : mTPKernel[p])
+                k /= sum;
+        }
+
+        reset_state();
     }
 
+    //! Switches the maximizer back to its classic instant-attack mode.
+    inline void setClassic() { mLookAhead = false; reset_state(); }
+
+    inline bool   isLookAhead   () const { return mLookAhead; }
+    inline size_t getLatency    () const { return mLookAhead ? mDelay : 0; }
+
     inline void setBoost        (Afloat const &value) { mBoost       = value; }
     inline void setThreshold    (Afloat const &value) { mThreshold   = value; reset_state(); }
     inline void setSlowRelease  (Afloat const &value) { mSlowRelease = value; reset_state(); }
@@ -83,9 +222,33 @@ public:
     inline Afloat getPeakRelease() const { return mPeakRelease; }
     inline Afloat getCeiling    () const { return mCeiling; }
 
-    inline Afloat getCurrentGain() const { return mGain; }
+    //! Current gain reduction factor; 1 when not limiting.
+    inline Afloat getCurrentGain() const { return mLookAhead ? static_cast<Afloat>(1.0 / mRelease) : mGain; }
     inline Afloat getPeakSample () const { return mPeakSample; }
 
+    /** Skips a silent buffer unless the limiter is still releasing.
+     */
+    bool doSilence(AfBuffer &buffer) override
+    {
+        if (mLookAhead) {
+            //  The running sum drifts by rounding; allow for it, and settle
+            //  it back to exact while skipping.
+            double const settled = static_cast<double>(mSmooth.size());
+            if (mQuiet > mDelay + mAttack && mRelease >= 1.0 && mSmoothSum >= settled - kReleaseSnap * settled) {
+                mSmoothSum  = settled;
+                mPeakSample = 0.0f;
+                return true;
+            }
+        } else if (mGain <= 1.0f) {
+            mGain       = 1.0f;
+            mPeakSample = 0.0f;
+            return true;
+        }
+
+        doBuffer(buffer);
+        return false;
+    }
+
     /** Performs maximization on the audio buffer.
      *  \param buffer The audio buffer to filter.
      */
@@ -93,11 +256,116 @@ public:
     {
         assert(buffer.getChannelCount() == Channels);
 
-        mPeakSample = 0.0f;
+        doBegin(buffer.getFrameCount());
+        doFrames(buffer.data(), buffer.getFrameCount());
+    }
+
+    bool is_fusable() const override { return true; }
 
-        for(size_t i = 0; i < buffer.getFrameCount(); i += 1)
+    void doBegin(size_t) override { mPeakSample = 0.0f; }
+
+    void doFrames(Afloat* frames, size_t count) override
+    {
+        if (mLookAhead)
+            doLookAhead(frames, count);
+        else
+            doClassic(frames, count);
+    }
+
+private:
+    //! Peak of the signal between the last samples of a channel, from the interpolator.
+    inline Afloat true_peak(Achan c) const
+    {
+        Afloat const * h = &mTPHistory[c * kTPTaps];
+        Afloat peak = 0.0f;
+
+        for(size_t p = 1; p < kTPPhases; p += 1)
+        {
+            Afloat v = 0.0f;
+            for(size_t k = 0; k < kTPTaps; k += 1)
+                v += h[(mTPPos + k) % kTPTaps] * mTPKernel[p][k];
+            peak = std::max(peak, std::abs(v));
+        }
+        return peak;
+    }
+
+    void doLookAhead(Afloat* frames, size_t count)
+    {
+        size_t const W = mWindow.size();
+
+        for(size_t i = 0; i < count; i += 1, mFrame += 1)
+        {
+            Afloat* frame = frames + i * Channels;
+            Afloat  framePeak = 0.0f;
+
+            //  Boost, measure and push into the delay line.
+            Afloat* delayed = &mDelayLine[mDelayPos * Channels];
+            for(Achan c = 0; c < Channels; c += 1)
+            {
+                Afloat const x = frame[c] * mBoost;
+                framePeak = std::max(framePeak, std::abs(x));
+
+                if (mTruePeak)
+                    mTPHistory[c * kTPTaps + mTPPos] = x;
+
+                frame[c]   = delayed[c];
+                delayed[c] = x;
+            }
+
+            if (mTruePeak) {
+                mTPPos = (mTPPos + 1) % kTPTaps;
+                for(Achan c = 0; c < Channels; c += 1)
+                    framePeak = std::max(framePeak, true_peak(c));
+            }
+
+            mDelayPos = (mDelayPos + 1) % mDelay;
+            mPeakSample = std::max(mPeakSample, framePeak);
+            mQuiet = (framePeak > 0.0f) ? 0 : mQuiet + 1;
+
+            //  Sliding minimum of the needed gain over the delay line.
+            Afloat const need = (framePeak > mThreshold) ? mThreshold / framePeak : 1.0f;
+
+            while(mWindowSize > 0 && mWindow[(mWindowHead + mWindowSize - 1) % W].gain >= need)
+                mWindowSize -= 1;
+
+            mWindow[(mWindowHead + mWindowSize) % W] = Request { need, mFrame };
+            mWindowSize += 1;
+
+            if (mWindow[mWindowHead].frame + (W - 1) <= mFrame) {
+                mWindowHead = (mWindowHead + 1) % W;
+                mWindowSize -= 1;
+            }
+
+            Afloat const held = mWindow[mWindowHead].gain;
+
+            //  Instant attack towards the held minimum, exponential release.
+            //  The release runs in double precision, as float steps round to
+            //  nothing short of 1.0 at long release times.
+            if (held < mRelease)
+                mRelease = held;
+            else if (held - mRelease < kReleaseSnap)
+                mRelease = held;
+            else
+                mRelease += (held - mRelease) * mReleaseCoef;
+
+            //  Smooth the attack over the attack time.
+            Afloat const released = static_cast<Afloat>(mRelease);
+            mSmoothSum += released - mSmooth[mSmoothPos];
+            mSmooth[mSmoothPos] = released;
+            mSmoothPos = (mSmoothPos + 1) % mSmooth.size();
+
+            Afloat const gain = static_cast<Afloat>(mSmoothSum / mSmooth.size());
+
+            for(Achan c = 0; c < Channels; c += 1)
+                frame[c] *= mCeiling * std::min(gain, 1.0f);
+        }
+    }
+
+    void doClassic(Afloat* frames, size_t count)
+    {
+        for(size_t i = 0; i < count; i += 1)
         {
-            Afloat* frame = buffer.getFrame(i);
+            Afloat* frame = frames + i * Channels;
             Afloat  framePeak = 0.0f;
 
             //  Get peak value in frame.
@@ -11,6 +11,8 @@ AscMetering::AscMetering(Afloat freq, Afloat decay)
     , mDecay(decay)
     , mPeak ({0.0f, 0.0f})
     , mRMS  ({0.0f, 0.0f})
+    , mSum  ({0.0f, 0.0f})
+    , mCount(0)
     , mdOCI ({int16_t{0}, int16_t{0}})
     , mdRMS ({0.0f, 0.0f})
 {
@@ -19,32 +21,64 @@ AscMetering::AscMetering(Afloat freq, Afloat decay)
 
 void AscMetering::doBuffer(AfBuffer &buffer)
 {
-    mPeak *= 0;
-    mRMS  *= 0;
-
     /****/ if (buffer.getChannelCount() == 0) {
         return;
     } else if (buffer.getChannelCount() == 1) {
+        doBegin(0);
     } else {
-        Asfloatf mSum({0.0f, 0.0f});
-        for(size_t i = 0; i < buffer.getFrameCount(); i += 1)
-        {
-            Afloat * f = buffer.getFrame(i);
-            Asfloatf m ({std::abs(f[0]), std::abs(f[1])});
+        doBegin(buffer.getFrameCount());
+        doFrames(buffer.data(), buffer.getFrameCount());
+    }
 
-            mPeak[0] = std::max(mPeak[0], m[0]);
-            mPeak[1] = std::max(mPeak[1], m[1]);
+    doEnd();
+}
 
-            mSum[0] += m[0] * m[0];
-            mSum[1] += m[1] * m[1];
-        }
+void AscMetering::doBegin(size_t)
+{
+    mPeak *= 0;
+    mRMS  *= 0;
+    mSum  *= 0;
+    mCount = 0;
+}
+
+void AscMetering::doFrames(Afloat* frames, size_t count)
+{
+    for(size_t i = 0; i < count; i += 1)
+    {
+        Afloat * f = frames + i * 2;
+        Asfloatf m ({std::abs(f[0]), std::abs(f[1])});
 
-        mSum /= buffer.getFrameCount();
+        mPeak[0] = std::max(mPeak[0], m[0]);
+        mPeak[1] = std::max(mPeak[1], m[1]);
 
-        mRMS[0] = sqrt(mSum[0]);
-        mRMS[1] = sqrt(mSum[1]);
+        mSum[0] += m[0] * m[0];
+        mSum[1] += m[1] * m[1];
     }
 
+    mCount += count;
+}
+
+void AscMetering::doEnd()
+{
+    if (mCount > 0) {
+        mRMS[0] = sqrt(mSum[0] / mCount);
+        mRMS[1] = sqrt(mSum[1] / mCount);
+    }
+
+    decay();
+}
+
+bool AscMetering::doSilence(AfBuffer &)
+{
+    mPeak *= 0;
+    mRMS  *= 0;
+
+    decay();
+    return true;
+}
+
+void AscMetering::decay()
+{
     mdRMS = mdRMS * mdRMS + mRMS * mRMS;
     mdRMS /= 2.0f;
 
@@ -24,6 +24,8 @@ private:
     // Per buffer parameters
     Asfloatf    mPeak;  //!< Buffer peak
     Asfloatf    mRMS;   //!< Buffer root mean square
+    Asfloatf    mSum;   //!< Sum of squares over the current buffer
+    size_t      mCount; //!< Frames summed over the current buffer
 
     // Decaying parameters
     Asintf      mdOCI;  //!< Overclip indicator
@@ -44,6 +46,16 @@ public:
         mdRMS  *= 0;
     }
     void doBuffer(AfBuffer &buffer) override;
+    bool doSilence(AfBuffer &buffer) override;
+
+    bool is_fusable() const override { return true; }
+    void doBegin(size_t frames) override;
+    void doFrames(Afloat* frames, size_t count) override;
+    void doEnd() override;
+
+private:
+    //! Updates the decaying parameters from the last buffer's peak and RMS.
+    void decay();
 };
 }
 }
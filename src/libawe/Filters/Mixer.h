@@ -25,8 +25,18 @@ private:
     Afloat      vol;    //!< Output volume
     Afloat      pan;    //!< Output panning factor
     Asfloatf    chgain; //!< Calculated gain applied on each channel
+    Asfloatf    tggain; //!< Target channel gain, ramped to by \ref doBuffer
+    Afloat      cuvol;  //!< Mono gain applied at the end of the last buffer
+    Asfloatf    dtgain; //!< Per-frame channel gain step for the current buffer
 
 public:
+    //! Parameters accepted by \ref set_parameter.
+    enum Param : uint32_t
+    {
+        VOL = 0,
+        PAN
+    };
+
     //! Mixer panning law enumerator.
     enum class IEType : std::uint8_t
     {
@@ -43,6 +53,9 @@ public:
         , vol(_vol)
         , pan(_pan)
         , chgain(law(_vol, _pan))
+        , tggain(chgain)
+        , cuvol (_vol)
+        , dtgain({ 0.0f, 0.0f })
     { }
 
     inline void reset(Afloat _vol, Afloat _pan)
@@ -50,6 +63,8 @@ public:
         vol     = _vol;
         pan     = _pan;
         chgain  = law(_vol, _pan);
+        tggain  = chgain;
+        cuvol   = _vol;
     }
 
     inline Afloat getVol() const { return vol; }
@@ -60,24 +75,82 @@ public:
 
     void reset_state() override { reset(vol, pan); }
 
+    /*! Smoothed parameter change. The new gains are ramped to linearly
+     *  over the next buffer; the apply-on-sample operations below keep
+     *  using the previous gains until then.
+     */
+    void set_parameter(uint32_t id, double value) override
+    {
+        switch(id)
+        {
+            case VOL: vol = static_cast<Afloat>(value); break;
+            case PAN: pan = static_cast<Afloat>(value); break;
+            default: return;
+        }
+
+        tggain = law(vol, pan);
+    }
+
     void doBuffer(AfBuffer &buffer) override {
+        size_t const frames = buffer.getFrameCount();
+        Afloat const n = frames > 0 ? 1.0f / static_cast<Afloat>(frames) : 0.0f;
+
         /****/ if (buffer.getChannelCount() == 0) {
             return;
         } else if (buffer.getChannelCount() == 1) {
+            Afloat       g = cuvol;
+            Afloat const d = (vol - g) * n;
             std::for_each(
                     buffer.begin(), buffer.end(),
-                    [this](Afloat &value) {
-                        value *= vol;
+                    [&g, d](Afloat &value) {
+                        g += d;
+                        value *= g;
                     });
         } else {
-            for(size_t i = 0; i < buffer.getFrameCount(); i += 1)
-            {
-                Afloat* f = buffer.getFrame(i);
-                f[0] *= chgain[0];
-                f[1] *= chgain[1];
-            }
+            doBegin(frames);
+            doFrames(buffer.data(), frames);
+        }
+
+        doEnd();
+    }
+
+    bool is_fusable() const override { return true; }
+
+    void doBegin(size_t frames) override
+    {
+        Afloat const n = frames > 0 ? 1.0f / static_cast<Afloat>(frames) : 0.0f;
+        dtgain[0] = (tggain[0] - chgain[0]) * n;
+        dtgain[1] = (tggain[1] - chgain[1]) * n;
+    }
+
+    void doFrames(Afloat* frames, size_t count) override
+    {
+        Afloat g0 = chgain[0], g1 = chgain[1];
+        Afloat const d0 = dtgain[0], d1 = dtgain[1];
+
+        for(size_t i = 0; i < count; i += 1)
+        {
+            Afloat* f = frames + i * 2;
+            g0 += d0; f[0] *= g0;
+            g1 += d1; f[1] *= g1;
         }
 
+        chgain[0] = g0;
+        chgain[1] = g1;
+    }
+
+    void doEnd() override
+    {
+        chgain = tggain;
+        cuvol  = vol;
+    }
+
+    //! Silence stays silent; only finish any pending gain ramp.
+    bool doSilence(AfBuffer &) override
+    {
+        chgain = tggain;
+        cuvol  = vol;
+        return true;
     }
 
     //!@name Apply-on-sample operations
@@ -0,0 +1,103 @@
+//  Filters/Rack.cpp :: Mixer filter rack
+//  Copyright 2014 Keigen Shu
+
+#include <chrono>
+#include "Rack.h"
+
+namespace awe {
+namespace Filter {
+
+constexpr size_t AscRack::kTileFrames;
+
+using Clock = std::chrono::steady_clock;
+
+static inline uint64_t nanos_since(Clock::time_point const &t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+}
+
+void AscRack::run(size_t filter, AfBuffer &buffer)
+{
+    if (mProfile == false) {
+        filters[filter]->doBuffer(buffer);
+        return;
+    }
+
+    Clock::time_point const t = Clock::now();
+    filters[filter]->doBuffer(buffer);
+    costs[filter].nanos  += nanos_since(t);
+    costs[filter].blocks += 1;
+}
+
+void AscRack::run_fused(size_t first, size_t last, AfBuffer &buffer)
+{
+    size_t const frames = buffer.getFrameCount();
+
+    for(size_t f = first; f < last; f += 1)
+        filters[f]->doBegin(frames);
+
+    for(size_t i = 0; i < frames; i += kTileFrames)
+    {
+        Afloat* tile  = buffer.getFrame(i);
+        size_t  count = std::min(kTileFrames, frames - i);
+
+        if (mProfile) {
+            for(size_t f = first; f < last; f += 1) {
+                Clock::time_point const t = Clock::now();
+                filters[f]->doFrames(tile, count);
+                costs[f].nanos += nanos_since(t);
+            }
+        } else {
+            for(size_t f = first; f < last; f += 1)
+                filters[f]->doFrames(tile, count);
+        }
+    }
+
+    for(size_t f = first; f < last; f += 1) {
+        filters[f]->doEnd();
+        costs[f].blocks += 1;
+    }
+}
+
+void AscRack::doBuffer(AfBuffer &buffer)
+{
+    if (mFused == false || buffer.getChannelCount() != 2)
+    {
+        for(size_t f = 0; f < filters.size(); f += 1)
+            run(f, buffer);
+        return;
+    }
+
+    size_t f = 0;
+    while(f < filters.size())
+    {
+        if (filters[f]->is_fusable() == false) {
+            run(f, buffer);
+            f += 1;
+            continue;
+        }
+
+        size_t last = f + 1;
+        while(last < filters.size() && filters[last]->is_fusable())
+            last += 1;
+
+        run_fused(f, last, buffer);
+        f = last;
+    }
+}
+
+bool AscRack::doSilence(AfBuffer &buffer)
+{
+    bool silent = true;
+    for(size_t f = 0; f < filters.size(); f += 1)
+    {
+        if (silent)
+            silent = filters[f]->doSilence(buffer);
+        else
+            run(f, buffer);
+    }
+    return silent;
+}
+
+}
+}
@@ -6,33 +6,90 @@
 
 #include <cassert>
 #include <cstdint>
+#include <vector>
 #include "../aweFilter.h"
 
 namespace awe {
 namespace Filter {
 
+/*! Chain of filters applied one after another.
+ *
+ *  In fused mode, consecutive filters that support the frame-range
+ *  interface (see \ref Afilter::is_fusable) are run tile by tile, so
+ *  each piece of the buffer passes through the whole chain while it is
+ *  still in cache. Other filters still get the whole buffer.
+ *
+ *  The rack can also measure how long each filter takes per buffer.
+ */
 class AscRack : public AscFilter
 {
+public:
+    static constexpr size_t kTileFrames = 64;   //!< Frames per tile in fused mode
+
+    //! Accumulated processing cost of one filter.
+    struct Cost
+    {
+        uint64_t    nanos;  //!< Total time spent in the filter
+        uint64_t    blocks; //!< Number of buffers processed
+
+        //! Average time per buffer in microseconds.
+        inline double average() const { return blocks ? nanos / 1000.0 / blocks : 0.0; }
+    };
+
 private:
     std::vector<AscFilter*> filters;
+    std::vector<Cost>       costs;
+
+    bool    mFused;     //!< Run fusable filters tile by tile?
+    bool    mProfile;   //!< Measure filter costs?
+
+    //! Runs one filter over the whole buffer.
+    void run(size_t filter, AfBuffer &buffer);
+
+    //! Runs filters [first, last), all fusable, tile by tile.
+    void run_fused(size_t first, size_t last, AfBuffer &buffer);
 
 public:
-    AscRack() {}
+    AscRack() : mFused(true), mProfile(false) {}
 
     inline void reset_state() { for(AscFilter* filter : filters) filter->reset_state(); }
-    inline void attach_filter(AscFilter* filter) { filters.push_back(filter); }
+    inline void attach_filter(AscFilter* filter)
+    {
+        filters.push_back(filter);
+        costs.push_back(Cost { 0, 0 });
+    }
     inline void detach_filter(size_t     filter)
     {
-        auto it = filters.begin();
-        while (it != filters.end() || --filter > 0)
-            it++;
-        filters.erase(it);
+        if (filter >= filters.size())
+            return;
+
+        filters.erase(filters.begin() + filter);
+        costs  .erase(costs  .begin() + filter);
     }
 
+    inline size_t            getFilterCount()        const { return filters.size(); }
     inline AscFilter       *  getFilter(size_t filter)       { return filters[filter]; }
     inline AscFilter const * cgetFilter(size_t filter) const { return filters[filter]; }
 
-    inline void doBuffer(AfBuffer &buffer) { for(AscFilter* filter : filters) filter->doBuffer(buffer); }
+    //!@name Execution mode and profiling
+    //!@{
+    inline void setFused    (bool fused)  { mFused   = fused;  }
+    inline void setProfiling(bool enable) { mProfile = enable; }
+    inline bool isFused     () const { return mFused;   }
+    inline bool isProfiling () const { return mProfile; }
+
+    //! Processing cost of a filter, if profiling is enabled.
+    inline Cost const & getCost(size_t filter) const { return costs[filter]; }
+    inline void reset_costs() { for(Cost &c : costs) c = Cost { 0, 0 }; }
+    //!@}
+
+    void doBuffer(AfBuffer &buffer) override;
+
+    /*! Runs a silent buffer through the rack. Filters are skipped for as
+     *  long as the signal stays silent; the first one to produce sound
+     *  hands a regular buffer to the rest of the chain.
+     */
+    bool doSilence(AfBuffer &buffer) override;
 };
 
 }
@@ -8,8 +8,10 @@ namespace Source {
 
 void Atrack::fpull(Asource* src)
 {
-    if (src->is_active() == true)
+    if (src->is_active() == true) {
         src->render(mPbuffer, mPconfig);
+        mPsilent = false;
+    }
 }
 
 void Atrack::fpull()
@@ -20,13 +22,46 @@ void Atrack::fpull()
 
 void Atrack::fflip()
 {
-    mObuffer.reset();
     mObuffer.swap(mPbuffer);
+    std::swap(mOsilent, mPsilent);
+
+    // The pool now holds the previous output; clear it if it had sound.
+    if (mPsilent == false)
+        mPbuffer.zero();
+
+    mPsilent = true;
 }
 
 void Atrack::ffilter()
 {
-    mOfilter.doBuffer(mObuffer);
+    if (mOsilent)
+        mOsilent = mOfilter.doSilence(mObuffer);
+    else
+        mOfilter.doBuffer(mObuffer);
+}
+
+void Atrack::fapply()
+{
+    Amessage m;
+    while(mMqueue.pop(m))
+    {
+        if (m.filter != nullptr) {
+            m.filter->set_parameter(m.id, m.value);
+            continue;
+        }
+
+        switch(m.id)
+        {
+            case MUTE:
+                mPconfig.quality = (m.value != 0.0)
+                    ? ArenderConfig::Quality::MUTE
+                    : ArenderConfig::Quality::DEFAULT;
+                break;
+
+            default:
+                break;
+        }
+    }
 }
 
 
@@ -39,6 +74,8 @@ Atrack::Atrack(
     , mPbuffer(2, frames)
     , mObuffer(2, frames)
     , mqActive(true)
+    , mPsilent(true)
+    , mOsilent(true)
 { }
 
 void Atrack::render(AfBuffer &targetBuffer, const ArenderConfig &targetConfig)
@@ -52,12 +89,16 @@ void Atrack::render(AfBuffer &targetBuffer, const ArenderConfig &targetConfig)
     {
         // Unlock pool mutex immediately after mixing.
         MutexLockGuard p_lock(mPmutex, std::adopt_lock);
+        fapply();
         fpull();
         fflip();
     }
 
     ffilter();
 
+    if (mOsilent)
+        return;
+
     AfBuffer::const_pointer src = mObuffer.data();
     AfBuffer::      pointer dst = targetBuffer.data();
 
@@ -10,9 +10,13 @@
 #include "../aweDefine.h"
 #include "../aweBuffer.h"
 #include "../aweSource.h"
+#include "../aweQueue.h"
 #include "../Filters/Rack.h"
 
 namespace awe {
+
+class Agraph;
+
 namespace Source {
 
 
@@ -28,11 +32,38 @@ namespace Source {
  *  Every track has two mutexes; one is used to lock the pool buffer,
  *  source list and pool config and the other is used to to lock the
  *  output buffer and filter rack.
+ *
+ *  Both buffers carry a silence flag. Silent pool buffers are flipped
+ *  without being cleared and skip the filter rack once the filters
+ *  have settled (see \ref Filter::Afilter::doSilence), and silent
+ *  output buffers are not summed into their target.
+ *
+ *  Parameter changes coming from a control thread should be sent with
+ *  \ref post instead of taking these mutexes; they are queued without
+ *  locking and applied by the mixing thread between buffers.
  */
 class Atrack : public Asource
 {
     using AscRack = Filter::AscRack;
 
+    friend class awe::Agraph;
+
+public:
+    //! Track parameters, posted with a null filter pointer.
+    enum Param : uint32_t
+    {
+        MUTE = 0    //!< Non-zero mutes the source pool.
+    };
+
+private:
+    //! Queued parameter change.
+    struct Amessage
+    {
+        AscFilter*  filter; //!< Target filter, or nullptr for the track itself
+        uint32_t    id;     //!< Parameter identifier
+        double      value;  //!< New parameter value
+    };
+
 private:
     mutable std::mutex  mPmutex;    //!< Track pool mutex
     mutable std::mutex  mOmutex;    //!< Track output mutex
@@ -46,6 +77,10 @@ private:
     AscRack     mOfilter;   //!< Post-mixing filter rack
 
     bool        mqActive;   //!< Is this source active?
+    bool        mPsilent;   //!< Has nothing been mixed into the pool buffer yet?
+    bool        mOsilent;   //!< Is the output buffer all zeroes?
+
+    Aqueue<Amessage, 256>   mMqueue;    //!< Pending parameter changes
 
 private:
     //!\name Non-thread-safe methods
@@ -63,6 +98,9 @@ private:
     //! Apply filter rack onto output buffer, without mutex lock.
     void ffilter();
 
+    //! Apply queued parameter changes, with both mutexes held.
+    void fapply();
+
     //!\}
 
 public:
@@ -115,6 +153,19 @@ public:
         mPconfig = new_config;
     }
 
+    /*! Queues a parameter change without blocking the mixing thread.
+     *
+     *  The change is applied at the start of the next buffer through
+     *  \ref Filter::Afilter::set_parameter, or onto the track itself if
+     *  \p filter is null. Only one thread may post to a track.
+     *
+     *  \return false if the queue is full and the change was dropped.
+     */
+    inline bool post(AscFilter* filter, uint32_t id, double value)
+    {
+        return mMqueue.push(Amessage { filter, id, value });
+    }
+
     /*! Retrieves the output mutex object which controls the output
      *  buffer and the rack.
      *  \return a reference to the output mutex of this track.
@@ -139,6 +190,11 @@ public:
      */
     inline const AfBuffer  & getOutput () const { return mObuffer; }
 
+    /*! Checks whether the last output buffer was silent.
+     *  \warning Ownership of this flag is defined by the output mutex.
+     */
+    inline bool isSilent() const { return mOsilent; }
+
     /*! Retrieves the track filter rack.
      *  \warning Ownership of this object is defined by the output
      *           mutex obtainable through the \ref getMutex() call.
@@ -217,6 +273,7 @@ public:
         {
             // Unlock pool mutex after flipping.
             MutexLockGuard p_lock(mPmutex, std::adopt_lock);
+            fapply();
             fflip();
         }
 
@@ -106,7 +106,7 @@ public:
      *  \param[in] _begin, _end  the range of elements to copy from
      */
     template< class InputIterator >
-    Abuffer(unsigned char _channels, InputIterator &_begin, InputIterator &_end)
+    Abuffer(unsigned char _channels, InputIterator _begin, InputIterator _end)
         : channels(_channels)
         , pcm_data(_begin, _end)
     {
@@ -144,12 +144,15 @@ public:
     {
         size_type samples = pcm_data.size();
         size_type new_size = (samples / channels) * channels;
-        pcm_data.clear  ( );
-        pcm_data.reserve(new_size);
         pcm_data.resize (new_size);
+        zero();
         return samples;
     }
 
+    /*! Sets every sample in the buffer to zero without reallocating.
+     */
+    inline void zero() { std::fill(pcm_data.begin(), pcm_data.end(), T(0)); }
+
     /*! \return number of channels in the buffer             */
     inline  unsigned char      getChannelCount() const { return channels;                    }
     /*! \return size of the entire buffer       (in bytes)   */
@@ -31,6 +31,55 @@ public:
      *  @param[in,out] buffer buffer to filter through
      */
     virtual void doBuffer(AfBuffer &buffer) = 0;
+
+    /*! Filters a buffer known to contain only silence.
+     *
+     *  Filters whose output would also be silent once their internal
+     *  state (i.e. IIR tails, ramps) has settled should update whatever
+     *  state a silent buffer would change and leave the buffer alone.
+     *  The default implementation processes the buffer normally.
+     *
+     *  @param[in,out] buffer silent buffer to filter through
+     *  @return true if the buffer is still silent afterwards
+     */
+    virtual bool doSilence(AfBuffer &buffer) { doBuffer(buffer); return false; }
+
+    /*! Changes a filter parameter from the audio thread.
+     *
+     *  Called between buffers with messages posted to the owning track
+     *  (see \ref Source::Atrack::post). Filters should smooth the change
+     *  over the next \ref doBuffer call instead of jumping to the new
+     *  value. Parameters are identified by filter-specific enumerators.
+     *
+     *  @param id    filter-specific parameter identifier
+     *  @param value new parameter value
+     */
+    virtual void set_parameter(uint32_t id, double value) { (void)id; (void)value; }
+
+    //!@name Fused processing
+    //!@{
+
+    /*! Checks whether this filter implements \ref doFrames, which lets
+     *  a rack run it tile by tile together with its neighbours instead
+     *  of making a separate pass over the whole buffer.
+     */
+    virtual bool is_fusable() const { return false; }
+
+    /*! Starts a buffer of \p frames frames which will be passed through
+     *  \ref doFrames in consecutive pieces, i.e. to set up ramps.
+     */
+    virtual void doBegin(size_t frames) { (void)frames; }
+
+    /*! Filters a piece of the buffer started with \ref doBegin.
+     *  @param[in,out] frames interleaved frames of Channels samples
+     *  @param[in]     count  number of frames
+     */
+    virtual void doFrames(Afloat* frames, size_t count) { (void)frames; (void)count; }
+
+    //! Ends the buffer started with \ref doBegin.
+    virtual void doEnd() { }
+
+    //!@}
 };
 
 using AscFilter = Afilter<2>;
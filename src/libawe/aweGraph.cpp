@@ -0,0 +1,162 @@
+//  aweGraph.cpp :: Audio routing graph
+//  Copyright 2014 Keigen Shu
+
+#include <cstdio>
+#include "aweGraph.h"
+
+namespace awe {
+
+Agraph::Agraph()
+    : mNodes ()
+    , mEdges ()
+    , mOutput(kNone)
+    , mDirty (false)
+    , mFeed  (nullptr)
+    , mLevel (0)
+{
+    mJob = [this] (size_t i) { fprocess(mOrder[mLevels[mLevel] + i]); };
+}
+
+Agraph::NodeID Agraph::add_node(Source::Atrack* track)
+{
+    mNodes.push_back(track);
+    mDirty = true;
+    return mNodes.size() - 1;
+}
+
+Agraph::EdgeID Agraph::connect(NodeID from, NodeID to, Afloat gain)
+{
+    mEdges.emplace_back(from, to, gain);
+    mDirty = true;
+    return mEdges.size() - 1;
+}
+
+bool Agraph::compile()
+{
+    size_t const N = mNodes.size();
+
+    // Group incoming edges by destination
+    std::vector<size_t> begin(N + 1, 0);
+    for(Edge const &e : mEdges)
+        begin[e.to + 1] += 1;
+    for(size_t n = 0; n < N; n += 1)
+        begin[n + 1] += begin[n];
+
+    std::vector<EdgeID> inputs(mEdges.size());
+    {
+        std::vector<size_t> fill(begin.begin(), begin.end() - 1);
+        for(EdgeID e = 0; e < mEdges.size(); e += 1)
+            inputs[fill[mEdges[e].to]++] = e;
+    }
+
+    // Longest-path levels, Kahn style
+    std::vector<size_t> pending(N, 0), level(N, 0);
+    for(Edge const &e : mEdges)
+        pending[e.to] += 1;
+
+    std::vector<NodeID> ready, order;
+    for(NodeID n = 0; n < N; n += 1)
+        if (pending[n] == 0)
+            ready.push_back(n);
+
+    while(ready.empty() == false)
+    {
+        NodeID const n = ready.back();
+        ready.pop_back();
+        order.push_back(n);
+
+        for(Edge const &e : mEdges)
+        {
+            if (e.from != n)
+                continue;
+
+            level[e.to] = std::max(level[e.to], level[n] + 1);
+            if (--pending[e.to] == 0)
+                ready.push_back(e.to);
+        }
+    }
+
+    if (order.size() != N) {
+        fprintf(stderr, "[warn] libawe: audio graph contains a cycle; keeping previous routing.\n");
+        mDirty = false;
+        return false;
+    }
+
+    // Flatten into levels; stable within a level so summation order is fixed.
+    std::stable_sort(order.begin(), order.end(),
+            [&level](NodeID a, NodeID b) { return level[a] < level[b]; });
+
+    mLevels.clear();
+    for(size_t i = 0; i < N; i += 1)
+        if (i == 0 || level[order[i]] != level[order[i - 1]])
+            mLevels.push_back(i);
+    mLevels.push_back(N);
+
+    mOrder      .swap(order);
+    mInputs     .swap(inputs);
+    mInputBegin .swap(begin);
+    mDirty = false;
+    return true;
+}
+
+void Agraph::fprocess(NodeID node)
+{
+    if (mFeed != nullptr)
+        (*mFeed)(node);
+
+    Source::Atrack &t = *mNodes[node];
+
+    std::lock(t.mPmutex, t.mOmutex);
+
+    MutexLockGuard o_lock(t.mOmutex, std::adopt_lock);
+    {
+        MutexLockGuard p_lock(t.mPmutex, std::adopt_lock);
+        t.fapply();
+        t.fpull();
+
+        ArenderConfig::Quality const q = t.mPconfig.quality;
+        if (q != ArenderConfig::Quality::MUTE && q != ArenderConfig::Quality::SKIP)
+        {
+            AfBuffer::pointer dst = t.mPbuffer.data();
+
+            for(size_t i = mInputBegin[node]; i < mInputBegin[node + 1]; i += 1)
+            {
+                Edge const &e = mEdges[mInputs[i]];
+                Afloat const g = e.gain.load(std::memory_order_relaxed);
+
+                // Upstream nodes finished on an earlier level.
+                Source::Atrack const &from = *mNodes[e.from];
+                if (from.mOsilent || g == 0.0f)
+                    continue;
+
+                t.mPsilent = false;
+
+                AfBuffer const &src = from.mObuffer;
+                size_t const n = std::min(src.getSampleCount(), t.mPbuffer.getSampleCount());
+
+                AfBuffer::const_pointer s = src.cdata();
+                for(size_t k = 0; k < n; k += 1)
+                    dst[k] += s[k] * g;
+            }
+        }
+
+        t.fflip();
+    }
+
+    t.ffilter();
+}
+
+void Agraph::process(Aworkers &workers, Feed const &feed)
+{
+    if (mDirty)
+        compile();
+
+    mFeed = &feed;
+
+    for(mLevel = 0; mLevel + 1 < mLevels.size(); mLevel += 1)
+        workers.run(mLevels[mLevel + 1] - mLevels[mLevel], mJob);
+
+    mFeed = nullptr;
+}
+
+}
@@ -0,0 +1,116 @@
+//  aweGraph.h :: Audio routing graph
+//  Copyright 2014 Keigen Shu
+
+#ifndef AWE_GRAPH_H
+#define AWE_GRAPH_H
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "aweDefine.h"
+#include "aweWorkers.h"
+#include "Sources/Track.h"
+
+namespace awe {
+
+/*! Audio routing graph.
+ *
+ *  Every node is a track: it mixes its own sources and the outputs
+ *  routed into it, then runs its filter rack. Tracks fed directly by
+ *  sound sources act as channels, tracks only fed by other tracks act
+ *  as buses. Edges carry a gain, so an edge alongside a track's main
+ *  output acts as a post-fader send.
+ *
+ *  The graph is sorted into levels of independent nodes whenever it
+ *  changes; every block is then mixed by walking this flat schedule,
+ *  locking each track once and summing inputs straight out of the
+ *  upstream output buffers. Nodes on the same level are processed in
+ *  parallel.
+ *
+ *  Topology changes (\ref add_node, \ref connect) are not thread-safe
+ *  and must not overlap \ref process. Edge gains may be changed at
+ *  any time through \ref set_gain.
+ */
+class Agraph
+{
+public:
+    using NodeID = size_t;
+    using EdgeID = size_t;
+
+    //! Called on the processing thread before a node is mixed, i.e. to pull voices into it.
+    using Feed   = std::function< void(NodeID) >;
+
+    static constexpr NodeID kNone = static_cast<NodeID>(-1);
+
+private:
+    struct Edge
+    {
+        NodeID              from;
+        NodeID              to;
+        std::atomic<Afloat> gain;
+
+        Edge(NodeID _from, NodeID _to, Afloat _gain) : from(_from), to(_to), gain(_gain) { }
+        Edge(Edge const &o) : from(o.from), to(o.to), gain(o.gain.load()) { }
+    };
+
+    std::vector<Source::Atrack*>    mNodes;
+    std::vector<Edge>               mEdges;
+    NodeID                          mOutput;
+
+    //!\name Compiled schedule
+    //!\{
+    bool                    mDirty;
+    std::vector<NodeID>     mOrder;         //!< Nodes in topological order
+    std::vector<size_t>     mLevels;        //!< Start of each level in mOrder, plus end
+    std::vector<EdgeID>     mInputs;        //!< Incoming edges grouped by destination node
+    std::vector<size_t>     mInputBegin;    //!< Start of each node's edges in mInputs, plus end
+    //!\}
+
+    //!\name Per-block state
+    //!\{
+    Feed const *            mFeed;
+    size_t                  mLevel;
+    Aworkers::Job           mJob;
+    //!\}
+
+    void fprocess(NodeID node);
+
+public:
+    Agraph();
+
+    /*! Adds a track to the graph.
+     *  The graph does not take ownership of the track.
+     */
+    NodeID add_node(Source::Atrack* track);
+
+    /*! Routes the output of one node into another.
+     *  \return identifier of the new edge, for \ref set_gain.
+     */
+    EdgeID connect(NodeID from, NodeID to, Afloat gain = 1.0f);
+
+    //! Changes the gain of an edge. Safe to call from any thread.
+    inline void set_gain(EdgeID edge, Afloat gain) { mEdges[edge].gain.store(gain, std::memory_order_relaxed); }
+
+    //! Marks a node as the graph output. Nodes that cannot reach it are still processed.
+    inline void set_output(NodeID node) { mOutput = node; }
+
+    inline NodeID          getOutput()          const { return mOutput; }
+    inline size_t          getNodeCount()       const { return mNodes.size(); }
+    inline Source::Atrack* getNode(NodeID node) const { return mNodes[node]; }
+
+    /*! Sorts the graph into its processing schedule.
+     *  \return false if the graph contains a cycle; the previous
+     *          schedule is kept in that case.
+     */
+    bool compile();
+
+    /*! Mixes one block through the whole graph.
+     *  \param workers pool to process independent nodes on.
+     *  \param feed    called for every node before it is mixed.
+     */
+    void process(Aworkers &workers, Feed const &feed);
+};
+
+}
+#endif
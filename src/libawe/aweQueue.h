@@ -0,0 +1,234 @@
+//  aweQueue.h :: Lock-free message queues and buffers
+//  Copyright 2014 Keigen Shu
+
+#ifndef AWE_QUEUE_H
+#define AWE_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace awe {
+
+/*! Size of a cache line. Queue counters owned by different threads are
+ *  kept at least this far apart with padding rather than alignas(), which
+ *  operator new does not honour before C++17 and queues are often members
+ *  of heap-allocated objects.
+ */
+static constexpr size_t kCacheLine = 64;
+
+/*! Wait-free single-producer, single-consumer ring buffer.
+ *
+ *  Used to hand messages from a control thread (i.e. the UI) to the
+ *  audio thread without either side ever taking a lock. Exactly one
+ *  thread may call \ref push and exactly one other thread may call
+ *  \ref pop.
+ *
+ *  \tparam T    message type; must be trivially copyable.
+ *  \tparam Size capacity of the queue; must be a power of two.
+ */
+template< typename T, size_t Size >
+class Aqueue
+{
+    static_assert((Size & (Size - 1)) == 0, "Aqueue size must be a power of two.");
+
+private:
+    static constexpr size_t kMask = Size - 1;
+
+    std::array<T, Size>             mData;
+    char                            mPad0[kCacheLine];
+    std::atomic<size_t>             mHead;  //!< Next slot to read  (consumer-owned)
+    char                            mPad1[kCacheLine];
+    std::atomic<size_t>             mTail;  //!< Next slot to write (producer-owned)
+    char                            mPad2[kCacheLine];
+
+public:
+    Aqueue() : mData(), mHead(0), mTail(0) { }
+
+    Aqueue(Aqueue const &) = delete;
+    Aqueue& operator=(Aqueue const &) = delete;
+
+    /*! Appends a message to the queue. Producer side only.
+     *  \return false if the queue is full and the message was dropped.
+     */
+    inline bool push(T const &value)
+    {
+        size_t const tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == Size)
+            return false;
+
+        mData[tail & kMask] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*! Removes the oldest message from the queue. Consumer side only.
+     *  \return false if the queue was empty.
+     */
+    inline bool pop(T &value)
+    {
+        size_t const head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+            return false;
+
+        value = mData[head & kMask];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Checks whether the queue is empty. Only exact on the consumer side.
+    inline bool empty() const
+    {
+        return mHead.load(std::memory_order_relaxed) == mTail.load(std::memory_order_acquire);
+    }
+};
+
+/*! Bounded multiple-producer, single-consumer queue.
+ *
+ *  Every slot carries a sequence number which tells producers whether
+ *  it is free and the consumer whether it has been filled. A producer
+ *  only retries when it loses a slot to another producer, so a push by
+ *  a lone producer always completes in a constant number of steps.
+ *
+ *  \tparam T    message type; must be trivially copyable.
+ *  \tparam Size capacity of the queue; must be a power of two.
+ */
+template< typename T, size_t Size >
+class AqueueMPSC
+{
+    static_assert((Size & (Size - 1)) == 0, "AqueueMPSC size must be a power of two.");
+
+private:
+    static constexpr size_t kMask = Size - 1;
+
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T                   data;
+    };
+
+    std::array<Cell, Size>          mCells;
+    char                            mPad0[kCacheLine];
+    std::atomic<size_t>             mTail;  //!< Next slot to claim (shared by producers)
+    char                            mPad1[kCacheLine];
+    size_t                          mHead;  //!< Next slot to read  (consumer-owned)
+    char                            mPad2[kCacheLine];
+
+public:
+    AqueueMPSC() : mTail(0), mHead(0)
+    {
+        for(size_t i = 0; i < Size; i += 1)
+            mCells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    AqueueMPSC(AqueueMPSC const &) = delete;
+    AqueueMPSC& operator=(AqueueMPSC const &) = delete;
+
+    /*! Appends a message to the queue. Safe to call from any thread.
+     *  \return false if the queue is full and the message was dropped.
+     */
+    inline bool push(T const &value)
+    {
+        Cell*  cell;
+        size_t pos = mTail.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            cell = &mCells[pos & kMask];
+
+            size_t   const seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t const dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            /**/ if (dif == 0) {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*! Removes the oldest message from the queue. Consumer side only.
+     *  \return false if the queue was empty.
+     */
+    inline bool pop(T &value)
+    {
+        Cell &cell = mCells[mHead & kMask];
+
+        size_t   const seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t const dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(mHead + 1);
+
+        if (dif < 0)
+            return false;
+
+        value = cell.data;
+        cell.seq.store(mHead + Size, std::memory_order_release);
+        mHead += 1;
+        return true;
+    }
+};
+
+/*! Single-writer, single-reader triple buffer.
+ *
+ *  The writer fills the back slot and publishes it; the reader picks up
+ *  the most recently published slot. Neither side waits for the other
+ *  and the reader never sees a half-written value. Intermediate values
+ *  are skipped if the reader is slower than the writer.
+ */
+template< typename T >
+class AtripleBuffer
+{
+private:
+    static constexpr uint8_t kIndex = 0x3;
+    static constexpr uint8_t kFresh = 0x4;  //!< Set when the middle slot holds unread data
+
+    std::array<T, 3>        mSlots;
+    std::atomic<uint8_t>    mMiddle;
+    uint8_t                 mBack;      //!< Writer-owned slot
+    uint8_t                 mFront;     //!< Reader-owned slot
+
+public:
+    explicit AtripleBuffer(T const &init = T())
+        : mSlots {{ init, init, init }}
+        , mMiddle(1)
+        , mBack  (0)
+        , mFront (2)
+    { }
+
+    AtripleBuffer(AtripleBuffer const &) = delete;
+    AtripleBuffer& operator=(AtripleBuffer const &) = delete;
+
+    //! Slot to write the next value into. Writer side only.
+    inline T& back() { return mSlots[mBack]; }
+
+    //! Publishes the back slot to the reader. Writer side only.
+    inline void publish()
+    {
+        mBack = mMiddle.exchange(mBack | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    /*! Takes the latest published value, if any. Reader side only.
+     *  \return true if \ref front now holds a value not read before.
+     */
+    inline bool update()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0)
+            return false;
+
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+
+    //! Last value taken by \ref update. Reader side only.
+    inline T const & front() const { return mSlots[mFront]; }
+};
+
+}
+#endif
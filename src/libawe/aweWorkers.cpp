@@ -0,0 +1,110 @@
+//  aweWorkers.cpp :: Fork-join worker pool
+//  Copyright 2014 Keigen Shu
+
+#include "aweWorkers.h"
+#include "aweDefine.h"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+namespace awe {
+
+Aworkers::Aworkers(size_t threads, std::string const & name)
+    : mThreads ()
+    , mJob     (nullptr)
+    , mJobCount(0)
+    , mNext    (0)
+    , mBatch   (0)
+    , mJoined  (0)
+    , mBusy    (0)
+    , mQuit    (false)
+{
+    for(size_t i = 0; i < threads; i += 1)
+    {
+        mThreads.emplace_back([this, name] () {
+#if !( defined(_WIN32) || defined(_WIN64) )
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#endif
+            set_flush_denormals();
+            this->loop();
+        });
+    }
+}
+
+Aworkers::~Aworkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for(std::thread &thread : mThreads)
+        thread.join();
+}
+
+void Aworkers::work(Job const & job, size_t count)
+{
+    for(size_t i = mNext.fetch_add(1); i < count; i = mNext.fetch_add(1))
+        job(i);
+}
+
+void Aworkers::loop()
+{
+    unsigned long seen = 0;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    for(;;)
+    {
+        mWake.wait(lock, [this, &seen] { return mQuit || mBatch != seen; });
+        if (mQuit)
+            return;
+
+        seen = mBatch;
+
+        Job const & job   = *mJob;
+        size_t const count = mJobCount;
+
+        mJoined += 1;
+        mBusy   += 1;
+
+        lock.unlock();
+        work(job, count);
+        lock.lock();
+
+        mBusy -= 1;
+        mDone.notify_all();
+    }
+}
+
+void Aworkers::run(size_t count, Job const & job)
+{
+    if (mThreads.empty() || count < 2)
+    {
+        for(size_t i = 0; i < count; i += 1)
+            job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJob      = &job;
+        mJobCount = count;
+        mJoined   = 0;
+        mNext.store(0);
+        mBatch   += 1;
+    }
+    mWake.notify_all();
+
+    work(job, count);
+
+    // Every worker has to pick up this batch before we return; a late
+    // one would otherwise read the next batch's index with this job.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mJoined == mThreads.size() && mBusy == 0; });
+
+    mJob = nullptr;
+}
+
+}
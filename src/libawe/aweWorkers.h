@@ -0,0 +1,70 @@
+//  aweWorkers.h :: Fork-join worker pool
+//  Copyright 2014 Keigen Shu
+
+#ifndef AWE_WORKERS_H
+#define AWE_WORKERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace awe {
+
+/*! Fork-join pool for splitting one mixing pass across cores.
+ *
+ *  \ref run hands out job indices to the worker threads and to the
+ *  calling thread, then waits for all of them to finish. Jobs are
+ *  claimed dynamically, so a heavy job does not hold up the rest.
+ *  Jobs must not depend on each other; any ordering requirement has to
+ *  be handled by the caller after \ref run returns.
+ */
+class Aworkers
+{
+public:
+    using Job = std::function< void(size_t) >;
+
+private:
+    std::vector<std::thread>    mThreads;
+
+    std::mutex                  mMutex;
+    std::condition_variable     mWake;      //!< Signalled when a new batch starts
+    std::condition_variable     mDone;      //!< Signalled when a worker leaves a batch
+
+    Job const *                 mJob;       //!< Current batch
+    size_t                      mJobCount;  //!< Number of jobs in the current batch
+    std::atomic<size_t>         mNext;      //!< Next job index to claim
+
+    unsigned long               mBatch;     //!< Batch generation counter
+    size_t                      mJoined;    //!< Workers that picked up the current batch
+    size_t                      mBusy;      //!< Workers still running jobs of the current batch
+    bool                        mQuit;
+
+    void work(Job const & job, size_t count);
+    void loop();
+
+public:
+    /*! Starts the worker threads.
+     *  \param threads number of threads in addition to the caller.
+     *  \param name    thread name, for debuggers.
+     */
+    Aworkers(size_t threads, std::string const & name = "awe Worker");
+    ~Aworkers();
+
+    Aworkers(Aworkers const &) = delete;
+    Aworkers& operator=(Aworkers const &) = delete;
+
+    //! Number of worker threads, excluding the caller.
+    inline size_t size() const { return mThreads.size(); }
+
+    /*! Runs job(0) ... job(count - 1) and returns when all are done.
+     *  The calling thread takes part in the work.
+     */
+    void run(size_t count, Job const & job);
+};
+
+}
+#endif